@@ -22,6 +22,8 @@
 #include "messagepanel.h"
 #include "outputparser.h"
 #include "parameter.h"
+#include "glstate.h"
+#include "shadercost.h"
 
 #include <math.h>
 
@@ -352,7 +354,7 @@ public:
 		if( checkProgramError(0) ) {
 			succeed = false;
 		}
-		glDisable( GL_VERTEX_PROGRAM_ARB );
+		GLState::disable(GL_VERTEX_PROGRAM_ARB);
 		
 		emit infoMessage(tr("Compiling fragment program..."));
 		glGenProgramsARB( 1, &fragmentProgram );
@@ -361,7 +363,7 @@ public:
 		if( checkProgramError(1) ) {
 			succeed = false;
 		}
-		glDisable( GL_FRAGMENT_PROGRAM_ARB );
+		GLState::disable(GL_FRAGMENT_PROGRAM_ARB);
 		
 		if( succeed )
 		{
@@ -381,6 +383,48 @@ public:
 		return false;
 	}
 	
+	virtual ShaderCost analyzeCost(int input)
+	{
+		Q_ASSERT(input == 0 || input == 1);
+		
+		// The lines come from the source, the totals from the driver.
+		ShaderCost cost = ShaderCost::estimateAssembly(getInput(input));
+		
+		const GLuint program = (input == 0) ? m_vp : m_fp;
+		if( !isValid() ) {
+			return cost;
+		}
+		
+		this->makeCurrent();
+		
+		const GLenum target = (input == 0) ? GL_VERTEX_PROGRAM_ARB : GL_FRAGMENT_PROGRAM_ARB;
+		glBindProgramARB( target, program );
+		
+		GLint instructions = 0;
+		GLint temporaries = 0;
+		GLint underLimits = GL_TRUE;
+		glGetProgramivARB( target, GL_PROGRAM_NATIVE_INSTRUCTIONS_ARB, &instructions );
+		glGetProgramivARB( target, GL_PROGRAM_NATIVE_TEMPORARIES_ARB, &temporaries );
+		glGetProgramivARB( target, GL_PROGRAM_UNDER_NATIVE_LIMITS_ARB, &underLimits );
+		
+		// Texture instructions are only counted for fragment programs.
+		if( target == GL_FRAGMENT_PROGRAM_ARB ) {
+			GLint textureInstructions = 0;
+			glGetProgramivARB( target, GL_PROGRAM_NATIVE_TEX_INSTRUCTIONS_ARB, &textureInstructions );
+			cost.textureFetches = textureInstructions;
+		}
+		
+		cost.instructions = instructions;
+		cost.temporaries = temporaries;
+		cost.native = true;
+		
+		if( !underLimits ) {
+			emit errorMessage(tr("%1 exceeds the native limits and may run in software.").arg(getInputName(input)));
+		}
+		
+		return cost;
+	}
+	
 	
 	// Parameter info.
 	virtual int parameterCount() const
@@ -434,15 +478,15 @@ public:
 	// Rendering.
 	virtual void begin()
 	{
-		glEnable (GL_CULL_FACE);
-		glEnable (GL_DEPTH_TEST);
+		GLState::enable(GL_CULL_FACE);
+		GLState::enable(GL_DEPTH_TEST);
 		glDepthFunc(GL_LEQUAL);
 		
 		// Enable programs.
-		glEnable( GL_VERTEX_PROGRAM_ARB );
+		GLState::enable(GL_VERTEX_PROGRAM_ARB);
 		glBindProgramARB( GL_VERTEX_PROGRAM_ARB, m_vp );
 		
-		glEnable( GL_FRAGMENT_PROGRAM_ARB );
+		GLState::enable(GL_FRAGMENT_PROGRAM_ARB);
 		glBindProgramARB( GL_FRAGMENT_PROGRAM_ARB, m_fp );
 		
 		// Set uniforms.
@@ -460,8 +504,8 @@ public:
 	
 	virtual void end()
 	{
-		glDisable( GL_FRAGMENT_PROGRAM_ARB );
-		glDisable( GL_VERTEX_PROGRAM_ARB );
+		GLState::disable(GL_FRAGMENT_PROGRAM_ARB);
+		GLState::disable(GL_VERTEX_PROGRAM_ARB);
 	}
 
 private:
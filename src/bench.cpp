@@ -0,0 +1,335 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "bench.h"
+#include "effect.h"
+#include "scene.h"
+#include "qglview.h"
+#include "glutils.h"
+#include "transform.h"
+#include "glstate.h"
+#include "profiler.h"
+#include "texmanager.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QVector>
+#include <QtCore/QtAlgorithms>
+#include <QtGui/QImage>
+#include <QtOpenGL/QGLFramebufferObject>
+
+#include <stdio.h>
+
+namespace
+{
+	struct Options
+	{
+		Options() : sceneName("teapot"), size(512, 512), frameCount(100) {}
+
+		QString effectFile;
+		QString sceneName;
+		QSize size;
+		int frameCount;
+		QString outputFile;
+	};
+
+	static const char * s_usage =
+		"usage: qshaderedit --bench <effect> [--scene teapot|obj:<file>] [--size WxH] [--frames N] [--out img.png]\n";
+
+	static bool parseArguments(const QStringList & arguments, Options & options)
+	{
+		for (int i = 0; i < arguments.count(); i++)
+		{
+			const QString & arg = arguments.at(i);
+			const bool hasValue = i + 1 < arguments.count();
+
+			if (arg == "--bench" && hasValue) {
+				options.effectFile = arguments.at(++i);
+			}
+			else if (arg == "--scene" && hasValue) {
+				options.sceneName = arguments.at(++i);
+			}
+			else if (arg == "--size" && hasValue) {
+				QStringList size = arguments.at(++i).split('x');
+				if (size.count() != 2) {
+					return false;
+				}
+				options.size = QSize(size.at(0).toInt(), size.at(1).toInt());
+			}
+			else if (arg == "--frames" && hasValue) {
+				options.frameCount = arguments.at(++i).toInt();
+			}
+			else if (arg == "--out" && hasValue) {
+				options.outputFile = arguments.at(++i);
+			}
+			else if (i != 0) {
+				return false;
+			}
+		}
+
+		return !options.effectFile.isEmpty() && options.size.isValid() && !options.size.isEmpty() && options.frameCount > 0;
+	}
+
+	static Scene * createScene(const QString & name)
+	{
+		if (name.startsWith("obj:")) {
+			return SceneFactory::loadScene(name.mid(4));
+		}
+
+		foreach (const SceneFactory * factory, SceneFactory::factoryList()) {
+			if (factory->name().compare(name, Qt::CaseInsensitive) == 0) {
+				return factory->createScene();
+			}
+		}
+		return NULL;
+	}
+
+	// Same camera as the default SceneView transform.
+	static void setupCamera(const Scene * scene, const QSize & size)
+	{
+		glViewport(0, 0, size.width(), size.height());
+
+		const Matrix4 projection = Matrix4::perspective(30, float(size.width()) / float(size.height()), 0.3f, 50);
+		const Matrix4 view = Matrix4::lookAt(0, 0, 5, 0, 0, 4, 0, 1, 0);
+		Transform::load(view * scene->transform(), projection);
+	}
+
+	static QString jsonString(const QString & str)
+	{
+		QString result;
+		foreach (QChar c, str) {
+			if (c == '"' || c == '\\') {
+				result += '\\';
+				result += c;
+			}
+			else if (c == '\n') {
+				result += "\\n";
+			}
+			else if (c < QChar(' ')) {
+				result += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+			}
+			else {
+				result += c;
+			}
+		}
+		return '"' + result + '"';
+	}
+
+	// Nearest rank percentile of the sorted values.
+	static double percentile(const QVector<double> & sorted, double p)
+	{
+		int index = int(p * sorted.count() + 0.5) - 1;
+		return sorted.at(qBound(0, index, sorted.count() - 1));
+	}
+
+	static QString jsonTimes(QVector<double> times)
+	{
+		if (times.isEmpty()) {
+			return "null";
+		}
+
+		qSort(times);
+
+		double sum = 0;
+		foreach (double t, times) {
+			sum += t;
+		}
+
+		return QString("{ \"min\": %1, \"avg\": %2, \"p50\": %3, \"p90\": %4, \"p99\": %5, \"max\": %6 }")
+			.arg(times.first()).arg(sum / times.count())
+			.arg(percentile(times, 0.5)).arg(percentile(times, 0.9)).arg(percentile(times, 0.99))
+			.arg(times.last());
+	}
+
+	// Textures are decoded in the background and uploaded by the event loop.
+	static void waitForTextures()
+	{
+		while (TextureLoader::instance()->pendingCount() > 0) {
+			QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+		}
+	}
+
+} // namespace
+
+
+void BenchLog::message(QString msg)
+{
+	m_messages.append(msg);
+}
+
+void BenchLog::buildMessage(QString msg, int input, OutputParser * parser)
+{
+	Q_UNUSED(input);
+	Q_UNUSED(parser);
+	if (!msg.trimmed().isEmpty()) {
+		m_messages.append(msg);
+	}
+}
+
+
+int runBenchmark(const QStringList & arguments)
+{
+	Options options;
+	if (!parseArguments(arguments, options)) {
+		fputs(s_usage, stderr);
+		return 1;
+	}
+
+	// A hidden widget provides the context, rendering goes to a framebuffer object.
+	QGLFormat format;
+	format.setDepth(true);
+	QGLWidget glWidget(format);
+	glWidget.makeCurrent();
+
+	if (glewInit() != GLEW_OK) {
+		fputs("Error: glewInit failed.\n", stderr);
+		return 1;
+	}
+
+	if (!QGLFramebufferObject::hasOpenGLFramebufferObjects()) {
+		fputs("Error: framebuffer objects are not supported.\n", stderr);
+		return 1;
+	}
+
+	const EffectFactory * effectFactory = EffectFactory::factoryForExtension(QFileInfo(options.effectFile).suffix());
+	if (effectFactory == NULL || !effectFactory->isSupported()) {
+		fprintf(stderr, "Error: unsupported effect '%s'.\n", qPrintable(options.effectFile));
+		return 1;
+	}
+
+	QFile file(options.effectFile);
+	if (!file.open(QIODevice::ReadOnly)) {
+		fprintf(stderr, "Error: cannot open '%s'.\n", qPrintable(options.effectFile));
+		return 1;
+	}
+
+	Scene * scene = createScene(options.sceneName);
+	if (scene == NULL) {
+		fprintf(stderr, "Error: unknown scene '%s'.\n", qPrintable(options.sceneName));
+		return 1;
+	}
+
+	QGLFramebufferObject fbo(options.size, QGLFramebufferObject::Depth);
+	fbo.bind();
+
+	Effect * effect = effectFactory->createEffect(&glWidget);
+
+	BenchLog log;
+	QObject::connect(effect, SIGNAL(errorMessage(QString)), &log, SLOT(message(QString)));
+	QObject::connect(effect, SIGNAL(buildMessage(QString,int,OutputParser*)), &log, SLOT(buildMessage(QString,int,OutputParser*)));
+
+	effect->load(&file);
+	file.close();
+	waitForTextures();
+
+	const qint64 buildStart = microseconds();
+	effect->build(false);
+	const double buildTime = (microseconds() - buildStart) / 1000.0;
+
+	// The build can open the textures of new parameters.
+	waitForTextures();
+
+	const bool built = effect->isValid();
+
+	QVector<double> cpuTimes;
+	QVector<double> gpuTimes;
+	int savedStateCalls = 0;
+
+	if (built)
+	{
+		glClearColor(0.0, 0.0, 0.0, 0.0);
+		GLState::enable(GL_DEPTH_TEST);
+		GLState::polygonMode(GL_FILL);
+		setupCamera(scene, options.size);
+
+		const bool timerQuery = FrameProfiler::isGpuTimingSupported();
+		GLuint query = 0;
+		if (timerQuery) {
+			glGenQueries(1, &query);
+		}
+
+		GLState::resetSavedCalls();
+
+		for (int i = 0; i < options.frameCount; i++)
+		{
+			const qint64 frameStart = microseconds();
+			if (timerQuery) {
+				glBeginQuery(GL_TIME_ELAPSED_EXT, query);
+			}
+
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			SceneView::renderEffect(effect, scene);
+
+			if (timerQuery) {
+				glEndQuery(GL_TIME_ELAPSED_EXT);
+			}
+			glFinish();
+			cpuTimes.append((microseconds() - frameStart) / 1000.0);
+
+			if (timerQuery) {
+				GLuint64EXT elapsed = 0;
+				glGetQueryObjectui64vEXT(query, GL_QUERY_RESULT, &elapsed);
+				gpuTimes.append(elapsed / 1000000.0);
+			}
+		}
+
+		if (timerQuery) {
+			glDeleteQueries(1, &query);
+		}
+
+		savedStateCalls = GLState::savedCalls();
+	}
+
+	bool saved = false;
+	if (built && !options.outputFile.isEmpty()) {
+		saved = fbo.toImage().save(options.outputFile);
+	}
+
+	fbo.release();
+	delete effect;
+	delete scene;
+
+	// Report.
+	QStringList messages;
+	foreach (const QString & msg, log.messages()) {
+		messages.append(jsonString(msg));
+	}
+
+	QString json;
+	json += "{\n";
+	json += QString("  \"effect\": %1,\n").arg(jsonString(options.effectFile));
+	json += QString("  \"scene\": %1,\n").arg(jsonString(options.sceneName));
+	json += QString("  \"renderer\": %1,\n").arg(jsonString((const char *)glGetString(GL_RENDERER)));
+	json += QString("  \"width\": %1,\n  \"height\": %2,\n").arg(options.size.width()).arg(options.size.height());
+	json += QString("  \"built\": %1,\n").arg(built ? "true" : "false");
+	json += QString("  \"buildTime\": %1,\n").arg(buildTime);
+	json += QString("  \"messages\": [%1],\n").arg(messages.join(", "));
+	json += QString("  \"frames\": %1,\n").arg(cpuTimes.count());
+	json += QString("  \"cpuTime\": %1,\n").arg(jsonTimes(cpuTimes));
+	json += QString("  \"gpuTime\": %1,\n").arg(jsonTimes(gpuTimes));
+	json += QString("  \"savedStateCalls\": %1,\n").arg(cpuTimes.isEmpty() ? 0.0 : double(savedStateCalls) / cpuTimes.count());
+	json += QString("  \"image\": %1\n").arg(saved ? jsonString(options.outputFile) : QString("null"));
+	json += "}\n";
+
+	fputs(json.toUtf8().constData(), stdout);
+
+	return built ? 0 : 2;
+}
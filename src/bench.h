@@ -0,0 +1,50 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+
+class OutputParser;
+
+
+/// Collects the messages of the effect during a benchmark run.
+class BenchLog : public QObject
+{
+	Q_OBJECT
+public:
+	const QStringList & messages() const { return m_messages; }
+
+public slots:
+	void message(QString msg);
+	void buildMessage(QString msg, int input, OutputParser * parser);
+
+private:
+	QStringList m_messages;
+};
+
+
+/// Headless benchmark, run with:
+/// qshaderedit --bench <effect> [--scene teapot|obj:<file>] [--size WxH] [--frames N] [--out img.png]
+int runBenchmark(const QStringList & arguments);
+
+
+#endif // BENCH_H
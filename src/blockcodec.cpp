@@ -0,0 +1,574 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "blockcodec.h"
+
+#include <QtCore/QtGlobal>
+
+#include <string.h>
+
+
+namespace
+{
+	struct Format
+	{
+		GLenum format;
+		int blockSize;
+		bool srgb;
+	};
+	
+	static const Format s_formats[] = {
+		{ GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 8, false },
+		{ GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 8, false },
+		{ GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 16, false },
+		{ GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 16, false },
+		{ GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 8, true },
+		{ GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 8, true },
+		{ GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 16, true },
+		{ GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 16, true },
+		{ GL_COMPRESSED_RED_RGTC1, 8, false },
+		{ GL_COMPRESSED_SIGNED_RED_RGTC1, 8, false },
+		{ GL_COMPRESSED_RG_RGTC2, 16, false },
+		{ GL_COMPRESSED_SIGNED_RG_RGTC2, 16, false },
+#if defined(GL_ARB_texture_compression_bptc)
+		{ GL_COMPRESSED_RGBA_BPTC_UNORM_ARB, 16, false },
+		{ GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB, 16, true },
+		{ GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT_ARB, 16, false },
+		{ GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB, 16, false },
+#endif
+#if defined(GL_ARB_ES3_compatibility)
+		{ GL_COMPRESSED_RGB8_ETC2, 8, false },
+		{ GL_COMPRESSED_SRGB8_ETC2, 8, true },
+		{ GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, 8, false },
+		{ GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2, 8, true },
+		{ GL_COMPRESSED_RGBA8_ETC2_EAC, 16, false },
+		{ GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, 16, true },
+#endif
+	};
+	static const int s_formatCount = sizeof(s_formats) / sizeof(s_formats[0]);
+	
+	static const Format * findFormat(GLenum format)
+	{
+		for (int i = 0; i < s_formatCount; i++) {
+			if (s_formats[i].format == format) {
+				return &s_formats[i];
+			}
+		}
+		return NULL;
+	}
+	
+	static bool isSupported(GLenum format)
+	{
+		switch (format) {
+			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+				return GLEW_EXT_texture_compression_s3tc;
+			case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+				return GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB;
+			case GL_COMPRESSED_RED_RGTC1:
+			case GL_COMPRESSED_SIGNED_RED_RGTC1:
+			case GL_COMPRESSED_RG_RGTC2:
+			case GL_COMPRESSED_SIGNED_RG_RGTC2:
+				return GLEW_ARB_texture_compression_rgtc || GLEW_EXT_texture_compression_rgtc;
+#if defined(GL_ARB_texture_compression_bptc)
+			case GL_COMPRESSED_RGBA_BPTC_UNORM_ARB:
+			case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB:
+			case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT_ARB:
+			case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB:
+				return GLEW_ARB_texture_compression_bptc;
+#endif
+#if defined(GL_ARB_ES3_compatibility)
+			case GL_COMPRESSED_RGB8_ETC2:
+			case GL_COMPRESSED_SRGB8_ETC2:
+			case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+			case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+			case GL_COMPRESSED_RGBA8_ETC2_EAC:
+			case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+				return GLEW_ARB_ES3_compatibility;
+#endif
+		}
+		return false;
+	}
+	
+	
+	inline static uchar clamp255(int x)
+	{
+		return uchar(qBound(0, x, 255));
+	}
+	
+	inline static void writePixel(uchar * rgba, int width, int height, int bx, int by, int x, int y, int r, int g, int b, int a)
+	{
+		const int px = bx * 4 + x;
+		const int py = by * 4 + y;
+		if (px < width && py < height) {
+			uchar * p = rgba + (py * width + px) * 4;
+			p[0] = uchar(r);
+			p[1] = uchar(g);
+			p[2] = uchar(b);
+			p[3] = uchar(a);
+		}
+	}
+	
+	inline static uint readUInt16(const uchar * p)
+	{
+		return uint(p[0]) | (uint(p[1]) << 8);
+	}
+	
+	
+	// S3TC / RGTC.
+	
+	// Decode a BC1 color block to 16 RGBA colors in row major order.
+	static void decodeColorBlock(const uchar * block, bool fourColors, uchar colors[16][4])
+	{
+		const uint c0 = readUInt16(block);
+		const uint c1 = readUInt16(block + 2);
+		
+		uchar palette[4][4];
+		palette[0][0] = uchar(((c0 >> 11) & 0x1F) * 255 / 31);
+		palette[0][1] = uchar(((c0 >> 5) & 0x3F) * 255 / 63);
+		palette[0][2] = uchar((c0 & 0x1F) * 255 / 31);
+		palette[0][3] = 255;
+		palette[1][0] = uchar(((c1 >> 11) & 0x1F) * 255 / 31);
+		palette[1][1] = uchar(((c1 >> 5) & 0x3F) * 255 / 63);
+		palette[1][2] = uchar((c1 & 0x1F) * 255 / 31);
+		palette[1][3] = 255;
+		
+		for (int c = 0; c < 3; c++) {
+			if (fourColors || c0 > c1) {
+				palette[2][c] = uchar((2 * palette[0][c] + palette[1][c]) / 3);
+				palette[3][c] = uchar((palette[0][c] + 2 * palette[1][c]) / 3);
+			}
+			else {
+				palette[2][c] = uchar((palette[0][c] + palette[1][c]) / 2);
+				palette[3][c] = 0;
+			}
+		}
+		palette[2][3] = 255;
+		palette[3][3] = (fourColors || c0 > c1) ? 255 : 0;
+		
+		const uint indices = readUInt16(block + 4) | (readUInt16(block + 6) << 16);
+		for (int i = 0; i < 16; i++) {
+			memcpy(colors[i], palette[(indices >> (2 * i)) & 3], 4);
+		}
+	}
+	
+	// Decode a BC3 alpha or BC4 block to 16 values in row major order.
+	static void decodeAlphaBlock(const uchar * block, uchar values[16])
+	{
+		const int a0 = block[0];
+		const int a1 = block[1];
+		
+		int palette[8];
+		palette[0] = a0;
+		palette[1] = a1;
+		if (a0 > a1) {
+			for (int i = 2; i < 8; i++) {
+				palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+			}
+		}
+		else {
+			for (int i = 2; i < 6; i++) {
+				palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+		
+		quint64 indices = 0;
+		for (int i = 0; i < 6; i++) {
+			indices |= quint64(block[2 + i]) << (8 * i);
+		}
+		for (int i = 0; i < 16; i++) {
+			values[i] = uchar(palette[(indices >> (3 * i)) & 7]);
+		}
+	}
+	
+	static void decompressS3TC(GLenum format, const uchar * block, uchar colors[16][4])
+	{
+		switch (format) {
+			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+				decodeColorBlock(block, false, colors);
+				for (int i = 0; i < 16; i++) {
+					colors[i][3] = 255;
+				}
+				break;
+			case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+				decodeColorBlock(block, false, colors);
+				break;
+			case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+				decodeColorBlock(block + 8, true, colors);
+				for (int i = 0; i < 16; i++) {
+					colors[i][3] = uchar(((block[i / 2] >> (4 * (i & 1))) & 0xF) * 17);
+				}
+				break;
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: {
+				uchar alpha[16];
+				decodeAlphaBlock(block, alpha);
+				decodeColorBlock(block + 8, true, colors);
+				for (int i = 0; i < 16; i++) {
+					colors[i][3] = alpha[i];
+				}
+				break;
+			}
+			case GL_COMPRESSED_RED_RGTC1: {
+				uchar red[16];
+				decodeAlphaBlock(block, red);
+				for (int i = 0; i < 16; i++) {
+					colors[i][0] = red[i];
+					colors[i][1] = 0;
+					colors[i][2] = 0;
+					colors[i][3] = 255;
+				}
+				break;
+			}
+			case GL_COMPRESSED_RG_RGTC2: {
+				uchar red[16], green[16];
+				decodeAlphaBlock(block, red);
+				decodeAlphaBlock(block + 8, green);
+				for (int i = 0; i < 16; i++) {
+					colors[i][0] = red[i];
+					colors[i][1] = green[i];
+					colors[i][2] = 0;
+					colors[i][3] = 255;
+				}
+				break;
+			}
+		}
+	}
+	
+	
+	// ETC2 / EAC. Pixels are stored in column major order, with the most significant bits first.
+	
+#if defined(GL_ARB_ES3_compatibility)
+	
+	static const int s_etcModifiers[8][2] = {
+		{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+	};
+	
+	static const int s_etcDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+	
+	static const int s_eacModifiers[16][8] = {
+		{ -3, -6, -9, -15, 2, 5, 8, 14 },
+		{ -3, -7, -10, -13, 2, 6, 9, 12 },
+		{ -2, -5, -8, -13, 1, 4, 7, 12 },
+		{ -2, -4, -6, -13, 1, 3, 5, 12 },
+		{ -3, -6, -8, -12, 2, 5, 7, 11 },
+		{ -3, -7, -9, -11, 2, 6, 8, 10 },
+		{ -4, -7, -8, -11, 3, 6, 7, 10 },
+		{ -3, -5, -8, -11, 2, 4, 7, 10 },
+		{ -2, -6, -8, -10, 1, 5, 7, 9 },
+		{ -2, -5, -8, -10, 1, 4, 7, 9 },
+		{ -2, -4, -8, -10, 1, 3, 7, 9 },
+		{ -2, -5, -7, -10, 1, 4, 6, 9 },
+		{ -3, -4, -7, -10, 2, 3, 6, 9 },
+		{ -1, -2, -3, -10, 0, 1, 2, 9 },
+		{ -4, -6, -8, -9, 3, 5, 7, 8 },
+		{ -3, -5, -7, -9, 2, 4, 6, 8 }
+	};
+	
+	inline static int extend4(int x) { return (x << 4) | x; }
+	inline static int extend5(int x) { return (x << 3) | (x >> 2); }
+	inline static int extend6(int x) { return (x << 2) | (x >> 4); }
+	inline static int extend7(int x) { return (x << 1) | (x >> 6); }
+	
+	// Sign extend a 3 bit value.
+	inline static int delta3(int x) { return (x & 4) ? x - 8 : x; }
+	
+	// Decode an ETC2 RGB block. With punch-through alpha the differential bit marks opaque blocks.
+	static void decodeEtc2Block(const uchar * b, bool punchThrough, uchar colors[16][4])
+	{
+		const bool differential = (b[3] & 2) != 0;
+		const bool flip = (b[3] & 1) != 0;
+		const bool opaque = !punchThrough || differential;
+		
+		const uint msb = (uint(b[4]) << 8) | b[5];
+		const uint lsb = (uint(b[6]) << 8) | b[7];
+		
+		int base[2][3];
+		
+		if (punchThrough || differential) {
+			const int r = b[0] >> 3, g = b[1] >> 3, bl = b[2] >> 3;
+			const int r2 = r + delta3(b[0] & 7);
+			const int g2 = g + delta3(b[1] & 7);
+			const int b2 = bl + delta3(b[2] & 7);
+			
+			if (r2 < 0 || r2 > 31) {
+				// T mode.
+				int paint[4][3];
+				const int c1[3] = { extend4((((b[0] >> 3) & 3) << 2) | (b[0] & 3)), extend4(b[1] >> 4), extend4(b[1] & 0xF) };
+				const int c2[3] = { extend4(b[2] >> 4), extend4(b[2] & 0xF), extend4(b[3] >> 4) };
+				const int d = s_etcDistances[(((b[3] >> 2) & 3) << 1) | (b[3] & 1)];
+				for (int c = 0; c < 3; c++) {
+					paint[0][c] = c1[c];
+					paint[1][c] = clamp255(c2[c] + d);
+					paint[2][c] = c2[c];
+					paint[3][c] = clamp255(c2[c] - d);
+				}
+				for (int i = 0; i < 16; i++) {
+					const int index = (((msb >> i) & 1) << 1) | ((lsb >> i) & 1);
+					uchar * color = colors[(i & 3) * 4 + (i >> 2)];
+					if (!opaque && index == 2) {
+						color[0] = color[1] = color[2] = color[3] = 0;
+						continue;
+					}
+					color[0] = uchar(paint[index][0]);
+					color[1] = uchar(paint[index][1]);
+					color[2] = uchar(paint[index][2]);
+					color[3] = 255;
+				}
+				return;
+			}
+			
+			if (g2 < 0 || g2 > 31) {
+				// H mode.
+				const int r1 = (b[0] >> 3) & 0xF;
+				const int g1 = ((b[0] & 7) << 1) | ((b[1] >> 4) & 1);
+				const int b1 = (((b[1] >> 3) & 1) << 3) | ((b[1] & 3) << 1) | (b[2] >> 7);
+				const int r2h = (b[2] >> 3) & 0xF;
+				const int g2h = ((b[2] & 7) << 1) | (b[3] >> 7);
+				const int b2h = (b[3] >> 3) & 0xF;
+				
+				const int v1 = (r1 << 8) | (g1 << 4) | b1;
+				const int v2 = (r2h << 8) | (g2h << 4) | b2h;
+				const int d = s_etcDistances[(((b[3] >> 2) & 1) << 2) | ((b[3] & 1) << 1) | (v1 >= v2 ? 1 : 0)];
+				
+				const int c1[3] = { extend4(r1), extend4(g1), extend4(b1) };
+				const int c2[3] = { extend4(r2h), extend4(g2h), extend4(b2h) };
+				int paint[4][3];
+				for (int c = 0; c < 3; c++) {
+					paint[0][c] = clamp255(c1[c] + d);
+					paint[1][c] = clamp255(c1[c] - d);
+					paint[2][c] = clamp255(c2[c] + d);
+					paint[3][c] = clamp255(c2[c] - d);
+				}
+				for (int i = 0; i < 16; i++) {
+					const int index = (((msb >> i) & 1) << 1) | ((lsb >> i) & 1);
+					uchar * color = colors[(i & 3) * 4 + (i >> 2)];
+					if (!opaque && index == 2) {
+						color[0] = color[1] = color[2] = color[3] = 0;
+						continue;
+					}
+					color[0] = uchar(paint[index][0]);
+					color[1] = uchar(paint[index][1]);
+					color[2] = uchar(paint[index][2]);
+					color[3] = 255;
+				}
+				return;
+			}
+			
+			if (b2 < 0 || b2 > 31) {
+				// Planar mode.
+				const int ro = extend6((b[0] >> 1) & 0x3F);
+				const int go = extend7(((b[0] & 1) << 6) | ((b[1] >> 1) & 0x3F));
+				const int bo = extend6(((b[1] & 1) << 5) | (((b[2] >> 3) & 3) << 3) | ((b[2] & 3) << 1) | (b[3] >> 7));
+				const int rh = extend6((((b[3] >> 2) & 0x1F) << 1) | (b[3] & 1));
+				const int gh = extend7(b[4] >> 1);
+				const int bh = extend6(((b[4] & 1) << 5) | (b[5] >> 3));
+				const int rv = extend6(((b[5] & 7) << 3) | (b[6] >> 5));
+				const int gv = extend7(((b[6] & 0x1F) << 2) | (b[7] >> 6));
+				const int bv = extend6(b[7] & 0x3F);
+				
+				for (int y = 0; y < 4; y++) {
+					for (int x = 0; x < 4; x++) {
+						uchar * color = colors[y * 4 + x];
+						color[0] = clamp255((x * (rh - ro) + y * (rv - ro) + 4 * ro + 2) >> 2);
+						color[1] = clamp255((x * (gh - go) + y * (gv - go) + 4 * go + 2) >> 2);
+						color[2] = clamp255((x * (bh - bo) + y * (bv - bo) + 4 * bo + 2) >> 2);
+						color[3] = 255;
+					}
+				}
+				return;
+			}
+			
+			base[0][0] = extend5(r);
+			base[0][1] = extend5(g);
+			base[0][2] = extend5(bl);
+			base[1][0] = extend5(r2);
+			base[1][1] = extend5(g2);
+			base[1][2] = extend5(b2);
+		}
+		else {
+			base[0][0] = extend4(b[0] >> 4);
+			base[0][1] = extend4(b[1] >> 4);
+			base[0][2] = extend4(b[2] >> 4);
+			base[1][0] = extend4(b[0] & 0xF);
+			base[1][1] = extend4(b[1] & 0xF);
+			base[1][2] = extend4(b[2] & 0xF);
+		}
+		
+		const int table[2] = { (b[3] >> 5) & 7, (b[3] >> 2) & 7 };
+		
+		for (int i = 0; i < 16; i++) {
+			const int x = i >> 2;
+			const int y = i & 3;
+			const int sub = flip ? (y >= 2) : (x >= 2);
+			const int index = (((msb >> i) & 1) << 1) | ((lsb >> i) & 1);
+			
+			uchar * color = colors[y * 4 + x];
+			if (!opaque && index == 2) {
+				color[0] = color[1] = color[2] = color[3] = 0;
+				continue;
+			}
+			
+			int modifier = s_etcModifiers[table[sub]][index & 1];
+			if (index & 2) modifier = -modifier;
+			if (!opaque && index == 0) modifier = 0;
+			
+			color[0] = clamp255(base[sub][0] + modifier);
+			color[1] = clamp255(base[sub][1] + modifier);
+			color[2] = clamp255(base[sub][2] + modifier);
+			color[3] = 255;
+		}
+	}
+	
+	static void decodeEacBlock(const uchar * b, uchar colors[16][4])
+	{
+		const int base = b[0];
+		const int multiplier = b[1] >> 4;
+		const int * modifiers = s_eacModifiers[b[1] & 0xF];
+		
+		quint64 indices = 0;
+		for (int i = 2; i < 8; i++) {
+			indices = (indices << 8) | b[i];
+		}
+		
+		for (int i = 0; i < 16; i++) {
+			const int index = int(indices >> (45 - 3 * i)) & 7;
+			colors[(i & 3) * 4 + (i >> 2)][3] = clamp255(base + modifiers[index] * multiplier);
+		}
+	}
+	
+	static void decompressEtc2(GLenum format, const uchar * block, uchar colors[16][4])
+	{
+		switch (format) {
+			case GL_COMPRESSED_RGB8_ETC2:
+			case GL_COMPRESSED_SRGB8_ETC2:
+				decodeEtc2Block(block, false, colors);
+				break;
+			case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+			case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+				decodeEtc2Block(block, true, colors);
+				break;
+			case GL_COMPRESSED_RGBA8_ETC2_EAC:
+			case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+				decodeEtc2Block(block + 8, false, colors);
+				decodeEacBlock(block, colors);
+				break;
+		}
+	}
+	
+#endif // GL_ARB_ES3_compatibility
+	
+} // namespace
+
+
+int BlockCodec::blockSize(GLenum format)
+{
+	const Format * f = findFormat(format);
+	return f != NULL ? f->blockSize : 0;
+}
+
+qint64 BlockCodec::levelSize(GLenum format, int width, int height)
+{
+	return qint64((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+
+bool BlockCodec::isSRGB(GLenum format)
+{
+	const Format * f = findFormat(format);
+	return f != NULL && f->srgb;
+}
+
+QList<GLenum> BlockCodec::supportedFormats()
+{
+	QList<GLenum> list;
+	for (int i = 0; i < s_formatCount; i++) {
+		if (isSupported(s_formats[i].format)) {
+			list.append(s_formats[i].format);
+		}
+	}
+	return list;
+}
+
+bool BlockCodec::canDecompress(GLenum format)
+{
+	switch (format) {
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RED_RGTC1:
+		case GL_COMPRESSED_RG_RGTC2:
+			return true;
+#if defined(GL_ARB_ES3_compatibility)
+		case GL_COMPRESSED_RGB8_ETC2:
+		case GL_COMPRESSED_SRGB8_ETC2:
+		case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+		case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+		case GL_COMPRESSED_RGBA8_ETC2_EAC:
+		case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+			return true;
+#endif
+	}
+	return false;
+}
+
+void BlockCodec::decompress(GLenum format, const uchar * blocks, int width, int height, uchar * rgba)
+{
+	Q_ASSERT(canDecompress(format));
+	
+	const int size = blockSize(format);
+	const int blockWidth = (width + 3) / 4;
+	const int blockHeight = (height + 3) / 4;
+	
+	for (int by = 0; by < blockHeight; by++) {
+		for (int bx = 0; bx < blockWidth; bx++) {
+			const uchar * block = blocks + (by * blockWidth + bx) * size;
+			
+			uchar colors[16][4];
+#if defined(GL_ARB_ES3_compatibility)
+			if (format >= GL_COMPRESSED_RGB8_ETC2 && format <= GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC) {
+				decompressEtc2(format, block, colors);
+			}
+			else
+#endif
+			{
+				decompressS3TC(format, block, colors);
+			}
+			
+			for (int i = 0; i < 16; i++) {
+				writePixel(rgba, width, height, bx, by, i & 3, i >> 2, colors[i][0], colors[i][1], colors[i][2], colors[i][3]);
+			}
+		}
+	}
+}
@@ -0,0 +1,47 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef BLOCKCODEC_H
+#define BLOCKCODEC_H
+
+#include <GL/glew.h>
+
+#include <QtCore/QList>
+
+
+// Block compressed texture formats.
+namespace BlockCodec
+{
+	// Bytes of each 4x4 block, zero if the format is not known.
+	int blockSize(GLenum format);
+	qint64 levelSize(GLenum format, int width, int height);
+	
+	bool isSRGB(GLenum format);
+	
+	// Formats that the current context can sample.
+	QList<GLenum> supportedFormats();
+	
+	// Decompress a level to tightly packed RGBA8 pixels, for drivers that lack the format.
+	bool canDecompress(GLenum format);
+	void decompress(GLenum format, const uchar * blocks, int width, int height, uchar * rgba);
+};
+
+
+#endif // BLOCKCODEC_H
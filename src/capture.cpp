@@ -0,0 +1,522 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "capture.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QEvent>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QIODevice>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QQueue>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+#include <QtGui/QImage>
+#include <QtOpenGL/QGLWidget>
+
+#include <string.h>
+
+
+namespace
+{
+	class CaptureFailedEvent : public QEvent
+	{
+	public:
+		CaptureFailedEvent(const QString & fileName) : QEvent(QEvent::User), m_fileName(fileName)
+		{
+		}
+		const QString & fileName() const { return m_fileName; }
+	private:
+		QString m_fileName;
+	};
+
+	static void writeInt(QByteArray & data, qint32 value)
+	{
+		for (int i = 0; i < 4; i++) {
+			data += char((value >> (8 * i)) & 0xFF);
+		}
+	}
+
+	static void writeFloat(QByteArray & data, float value)
+	{
+		qint32 bits;
+		memcpy(&bits, &value, 4);
+		writeInt(data, bits);
+	}
+
+	static void writeAttribute(QByteArray & data, const char * name, const char * type, const QByteArray & value)
+	{
+		data += name;
+		data += '\0';
+		data += type;
+		data += '\0';
+		writeInt(data, value.size());
+		data += value;
+	}
+
+	// Uncompressed scanline OpenEXR with float RGBA channels. The rows are bottom up, like glReadPixels.
+	static bool writeExr(const QString & fileName, const QSize & size, const QVector<float> & pixels)
+	{
+		const int w = size.width();
+		const int h = size.height();
+
+		QByteArray header;
+		writeInt(header, 20000630);
+		writeInt(header, 2);
+
+		// Channels are stored in alphabetical order.
+		static const char channelNames[] = "ABGR";
+		QByteArray channels;
+		for (int c = 0; c < 4; c++) {
+			channels += channelNames[c];
+			channels += '\0';
+			writeInt(channels, 2);	// FLOAT
+			writeInt(channels, 0);	// pLinear and reserved
+			writeInt(channels, 1);
+			writeInt(channels, 1);
+		}
+		channels += '\0';
+		writeAttribute(header, "channels", "chlist", channels);
+
+		writeAttribute(header, "compression", "compression", QByteArray(1, '\0'));
+
+		QByteArray window;
+		writeInt(window, 0);
+		writeInt(window, 0);
+		writeInt(window, w - 1);
+		writeInt(window, h - 1);
+		writeAttribute(header, "dataWindow", "box2i", window);
+		writeAttribute(header, "displayWindow", "box2i", window);
+
+		writeAttribute(header, "lineOrder", "lineOrder", QByteArray(1, '\0'));
+
+		QByteArray one;
+		writeFloat(one, 1.0f);
+		writeAttribute(header, "pixelAspectRatio", "float", one);
+
+		QByteArray center;
+		writeFloat(center, 0.0f);
+		writeFloat(center, 0.0f);
+		writeAttribute(header, "screenWindowCenter", "v2f", center);
+		writeAttribute(header, "screenWindowWidth", "float", one);
+
+		header += '\0';
+
+		QFile file(fileName);
+		if (!file.open(QIODevice::WriteOnly)) {
+			return false;
+		}
+
+		// Offset table.
+		const qint64 lineSize = 8 + 4 * 4 * w;
+		QByteArray offsets;
+		for (int y = 0; y < h; y++) {
+			const qint64 offset = header.size() + 8 * h + y * lineSize;
+			writeInt(offsets, qint32(offset & 0xFFFFFFFF));
+			writeInt(offsets, qint32(offset >> 32));
+		}
+
+		if (file.write(header) != header.size() || file.write(offsets) != offsets.size()) {
+			return false;
+		}
+
+		// Scanlines, top to bottom.
+		static const int channelIndex[] = { 3, 2, 1, 0 };
+		QByteArray line;
+		for (int y = 0; y < h; y++) {
+			line.clear();
+			writeInt(line, y);
+			writeInt(line, 4 * 4 * w);
+
+			const float * row = pixels.constData() + 4 * w * (h - 1 - y);
+			for (int c = 0; c < 4; c++) {
+				for (int x = 0; x < w; x++) {
+					writeFloat(line, row[4 * x + channelIndex[c]]);
+				}
+			}
+
+			if (file.write(line) != line.size()) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+} // namespace
+
+
+// Pool of threads that encode the captured images in the background.
+class CaptureEncoder
+{
+public:
+	struct Job
+	{
+		QString fileName;
+		QImage image;
+		QSize size;
+		QVector<float> pixels;
+	};
+
+	CaptureEncoder(QObject * receiver, int threadCount) : m_receiver(receiver), m_busy(0), m_stop(false)
+	{
+		for (int i = 0; i < threadCount; i++) {
+			Worker * worker = new Worker(this);
+			worker->start(QThread::LowPriority);
+			m_workers.append(worker);
+		}
+	}
+
+	// Finish the queued jobs and exit.
+	~CaptureEncoder()
+	{
+		{
+			QMutexLocker locker(&m_mutex);
+			m_stop = true;
+			m_jobAdded.wakeAll();
+		}
+
+		foreach (Worker * worker, m_workers) {
+			worker->wait();
+		}
+		qDeleteAll(m_workers);
+	}
+
+	// Blocks while too many images wait, so that a long capture does not exhaust the memory.
+	void enqueue(const Job & job)
+	{
+		QMutexLocker locker(&m_mutex);
+		while (m_jobs.count() >= MaxJobs) {
+			m_jobTaken.wait(&m_mutex);
+		}
+		m_jobs.enqueue(job);
+		m_jobAdded.wakeOne();
+	}
+
+	// Wait until all the queued jobs are written.
+	void waitForDone()
+	{
+		QMutexLocker locker(&m_mutex);
+		while (!m_jobs.isEmpty() || m_busy > 0) {
+			m_jobDone.wait(&m_mutex);
+		}
+	}
+
+private:
+	enum { MaxJobs = 16 };
+
+	class Worker : public QThread
+	{
+	public:
+		Worker(CaptureEncoder * encoder) : m_encoder(encoder)
+		{
+		}
+		virtual void run()
+		{
+			m_encoder->process();
+		}
+	private:
+		CaptureEncoder * m_encoder;
+	};
+	friend class Worker;
+
+	void process()
+	{
+		forever {
+			Job job;
+			{
+				QMutexLocker locker(&m_mutex);
+				while (m_jobs.isEmpty() && !m_stop) {
+					m_jobAdded.wait(&m_mutex);
+				}
+				if (m_jobs.isEmpty()) {
+					return;
+				}
+				job = m_jobs.dequeue();
+				m_busy++;
+				m_jobTaken.wakeAll();
+			}
+
+			bool succeed;
+			if (job.pixels.isEmpty()) {
+				succeed = job.image.save(job.fileName);
+			}
+			else {
+				succeed = writeExr(job.fileName, job.size, job.pixels);
+			}
+
+			if (!succeed) {
+				QCoreApplication::postEvent(m_receiver, new CaptureFailedEvent(job.fileName));
+			}
+
+			QMutexLocker locker(&m_mutex);
+			m_busy--;
+			m_jobDone.wakeAll();
+		}
+	}
+
+	QObject * m_receiver;
+	QList<Worker *> m_workers;
+	QMutex m_mutex;
+	QWaitCondition m_jobAdded;
+	QWaitCondition m_jobTaken;
+	QWaitCondition m_jobDone;
+	QQueue<Job> m_jobs;
+	int m_busy;
+	bool m_stop;
+};
+
+
+FrameCapture::FrameCapture(QGLWidget * widget, int encoderCount /*= 1*/) : QObject(widget),
+	m_widget(widget),
+	m_ringIndex(0),
+	m_frame(0),
+	m_capturing(false),
+	m_captureIndex(0),
+	m_videoOutput(NULL)
+{
+	m_pollTimer = new QTimer(this);
+	m_pollTimer->setSingleShot(true);
+	m_pollTimer->setInterval(30);
+	connect(m_pollTimer, SIGNAL(timeout()), this, SLOT(onPollTimeout()));
+
+	m_encoder = new CaptureEncoder(this, qMax(encoderCount, 1));
+}
+
+// The widget context must be current.
+FrameCapture::~FrameCapture()
+{
+	collect(true);
+
+	for (int i = 0; i < RingSize; i++) {
+		if (m_ring[i].buffer != 0) {
+			glDeleteBuffers(1, &m_ring[i].buffer);
+		}
+	}
+
+	delete m_encoder;
+}
+
+//static
+bool FrameCapture::isReadbackAsync()
+{
+	return GLEW_ARB_pixel_buffer_object || GLEW_VERSION_2_1;
+}
+
+void FrameCapture::saveScreenshot(const QString & fileName)
+{
+	m_screenshotFileName = fileName;
+}
+
+void FrameCapture::startCapture(const QString & fileName)
+{
+	m_captureFileName = fileName;
+	m_captureIndex = 0;
+	m_capturing = true;
+}
+
+void FrameCapture::stopCapture()
+{
+	m_capturing = false;
+}
+
+bool FrameCapture::isCapturing() const
+{
+	return m_capturing;
+}
+
+void FrameCapture::setVideoOutput(QIODevice * device)
+{
+	m_videoOutput = device;
+}
+
+void FrameCapture::flush()
+{
+	collect(true);
+	m_encoder->waitForDone();
+}
+
+bool FrameCapture::wantsFrame() const
+{
+	return m_capturing || !m_screenshotFileName.isEmpty();
+}
+
+void FrameCapture::readFrame(const QSize & size)
+{
+	QString fileName = m_screenshotFileName;
+	if (fileName.isEmpty()) {
+		fileName = nextCaptureFileName();
+	}
+	m_screenshotFileName.clear();
+
+	const bool isFloat = m_videoOutput == NULL && QFileInfo(fileName).suffix().toLower() == "exr";
+	const GLenum format = isFloat ? GL_RGBA : GL_BGRA;
+	const GLenum type = isFloat ? GL_FLOAT : GL_UNSIGNED_INT_8_8_8_8_REV;
+	const int pixelSize = isFloat ? 4 * sizeof(float) : 4;
+
+	m_frame++;
+
+	// Map the transfers that had time to complete.
+	collect(false);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	if (!isReadbackAsync()) {
+		// Read synchronously.
+		QByteArray data(size.width() * size.height() * pixelSize, 0);
+		glReadPixels(0, 0, size.width(), size.height(), format, type, data.data());
+		encode(fileName, size, isFloat, data.constData());
+		return;
+	}
+
+	Transfer & transfer = m_ring[m_ringIndex];
+	m_ringIndex = (m_ringIndex + 1) % RingSize;
+
+	if (transfer.pending) {
+		// The ring is full, wait for the oldest transfer.
+		finish(transfer);
+	}
+
+	if (transfer.buffer == 0) {
+		glGenBuffers(1, &transfer.buffer);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, transfer.buffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER_ARB, size.width() * size.height() * pixelSize, NULL, GL_STREAM_READ);
+	glReadPixels(0, 0, size.width(), size.height(), format, type, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+	transfer.size = size;
+	transfer.fileName = fileName;
+	transfer.isFloat = isFloat;
+	transfer.frame = m_frame;
+	transfer.pending = true;
+
+	m_pollTimer->start();
+}
+
+void FrameCapture::customEvent(QEvent * event)
+{
+	if (event->type() == QEvent::User) {
+		// Do not report the same error for every frame.
+		stopCapture();
+		emit failed(static_cast<CaptureFailedEvent *>(event)->fileName());
+	}
+}
+
+void FrameCapture::onPollTimeout()
+{
+	m_widget->makeCurrent();
+	collect(true);
+}
+
+// Map the transfers that are at least two frames old, or all of them.
+void FrameCapture::collect(bool all)
+{
+	for (int i = 0; i < RingSize; i++) {
+		// Oldest first, so that the files are written in order.
+		Transfer & transfer = m_ring[(m_ringIndex + i) % RingSize];
+		if (transfer.pending && (all || m_frame - transfer.frame >= 2)) {
+			finish(transfer);
+		}
+	}
+}
+
+void FrameCapture::finish(Transfer & transfer)
+{
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, transfer.buffer);
+
+	const void * data = glMapBuffer(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY);
+	if (data != NULL) {
+		encode(transfer.fileName, transfer.size, transfer.isFloat, data);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER_ARB);
+	}
+	else {
+		emit failed(transfer.fileName);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+	transfer.pending = false;
+}
+
+// Copy the pixels and queue them for the encoder.
+void FrameCapture::encode(const QString & fileName, const QSize & size, bool isFloat, const void * data)
+{
+	if (m_videoOutput != NULL) {
+		writeVideoFrame(size, data);
+		return;
+	}
+	
+	CaptureEncoder::Job job;
+	job.fileName = fileName;
+	job.size = size;
+
+	if (isFloat) {
+		job.pixels.resize(4 * size.width() * size.height());
+		memcpy(job.pixels.data(), data, job.pixels.size() * sizeof(float));
+	}
+	else {
+		// The alpha channel of the back buffer is meaningless.
+		job.image = QImage(size, QImage::Format_RGB32);
+		const int lineSize = 4 * size.width();
+		for (int y = 0; y < size.height(); y++) {
+			memcpy(job.image.scanLine(size.height() - 1 - y), (const uchar *)data + y * lineSize, lineSize);
+		}
+	}
+
+	m_encoder->enqueue(job);
+}
+
+// Raw bottom up BGRA frames, in order.
+void FrameCapture::writeVideoFrame(const QSize & size, const void * data)
+{
+	const qint64 frameSize = 4 * size.width() * size.height();
+	if (m_videoOutput->write((const char *)data, frameSize) != frameSize) {
+		stopCapture();
+		emit failed(m_captureFileName);
+		return;
+	}
+
+	// Do not let the encoder fall more than a couple of frames behind.
+	while (m_videoOutput->bytesToWrite() > 2 * frameSize) {
+		if (!m_videoOutput->waitForBytesWritten(-1)) {
+			break;
+		}
+	}
+}
+
+QString FrameCapture::nextCaptureFileName()
+{
+	QFileInfo info(m_captureFileName);
+
+	QString suffix = info.suffix();
+	if (suffix.isEmpty()) {
+		suffix = "png";
+	}
+
+	const QString name = QString("%1_%2.%3").arg(info.completeBaseName()).arg(m_captureIndex++, 5, 10, QChar('0')).arg(suffix);
+	return info.dir().filePath(name);
+}
@@ -0,0 +1,121 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <GL/glew.h>
+
+#include <QtCore/QObject>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+
+class QGLWidget;
+class QIODevice;
+class QTimer;
+class CaptureEncoder;
+
+
+/// Saves the frames rendered by a widget. The back buffer is read into a
+/// ring of pixel buffer objects that are mapped a couple of frames later,
+/// and the images are encoded to PNG or EXR by a pool of worker threads.
+class FrameCapture : public QObject
+{
+	Q_OBJECT
+public:
+	FrameCapture(QGLWidget * widget, int encoderCount = 1);
+	~FrameCapture();
+
+	static bool isReadbackAsync();
+
+	// Save the next frame.
+	void saveScreenshot(const QString & fileName);
+
+	// Save every frame to numbered files named after fileName.
+	void startCapture(const QString & fileName);
+	void stopCapture();
+	bool isCapturing() const;
+
+	// Write raw frames to the device instead of image files.
+	void setVideoOutput(QIODevice * device);
+
+	// Wait until all the frames read so far are written.
+	void flush();
+
+	// True when the next frame should be read back.
+	bool wantsFrame() const;
+
+	// Start the readback of the back buffer, before it is swapped.
+	void readFrame(const QSize & size);
+
+signals:
+
+	void failed(const QString & fileName);
+
+protected:
+
+	virtual void customEvent(QEvent * event);
+
+private slots:
+
+	void onPollTimeout();
+
+private:
+	enum { RingSize = 3 };
+
+	// Readback in flight.
+	struct Transfer
+	{
+		Transfer() : buffer(0), isFloat(false), frame(0), pending(false) {}
+		GLuint buffer;
+		QSize size;
+		QString fileName;
+		bool isFloat;
+		int frame;
+		bool pending;
+	};
+
+	void collect(bool all);
+	void finish(Transfer & transfer);
+	void encode(const QString & fileName, const QSize & size, bool isFloat, const void * data);
+	void writeVideoFrame(const QSize & size, const void * data);
+	QString nextCaptureFileName();
+
+	QGLWidget * m_widget;
+
+	Transfer m_ring[RingSize];
+	int m_ringIndex;
+	int m_frame;
+
+	QString m_screenshotFileName;
+
+	bool m_capturing;
+	QString m_captureFileName;
+	int m_captureIndex;
+
+	// Maps the last transfers when no more frames are rendered.
+	QTimer * m_pollTimer;
+
+	CaptureEncoder * m_encoder;
+	QIODevice * m_videoOutput;
+};
+
+
+#endif // CAPTURE_H
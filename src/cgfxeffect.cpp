@@ -25,6 +25,7 @@
 #include "parameter.h"
 #include "glutils.h"
 #include "cgexplicit.h"
+#include "glstate.h"
 
 #include <QtCore/QDebug> //
 #include <QtCore/QCoreApplication>
@@ -433,6 +434,7 @@ private:
 
 	bool m_animated;
 	QTime m_time;
+	float m_fixedTime;
 
 	QVector<CgParameter *> m_parameterArray;
 
@@ -471,6 +473,7 @@ public:
 		m_pass(NULL),
 		m_effectText(s_effectText),
 		m_animated(false),
+		m_fixedTime(-1.0f),
 		m_thread(widget, this)
 	{
 		this->makeCurrent();
@@ -679,6 +682,11 @@ public:
 	{
 		return m_animated;
 	}
+	
+	virtual void setTime(float seconds)
+	{
+		m_fixedTime = seconds;
+	}
 
 	// Technique info.
 	virtual int getTechniqueNum() const
@@ -735,7 +743,7 @@ public:
 						// @@ ???
 					}
 					else if( std.m_type == CgSemantic::Type_Time ) {
-						qcgSetParameter1f(parameter, 0.001f * m_time.elapsed());
+						qcgSetParameter1f(parameter, m_fixedTime >= 0.0f ? m_fixedTime : 0.001f * m_time.elapsed());
 					}
 					else if( std.m_type == CgSemantic::Type_ViewportSize ) {
 						GLfloat v[4];
@@ -808,10 +816,14 @@ public:
 		Q_ASSERT(p <  getPassNum());
 		m_pass = m_passList.at(p);
 		qcgSetPassState(m_pass);
+		
+		// The pass state is set behind our back.
+		GLState::invalidate();
 	}
 	virtual void endPass()
 	{
 		qcgResetPassState(m_pass);
+		GLState::invalidate();
 		m_pass = NULL;
 	}
 	virtual void end()
@@ -0,0 +1,423 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "imageplugin.h"
+#include "blockcodec.h"
+
+#include <QtCore/QFile>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+namespace
+{
+	static const uchar s_ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+	static const uchar s_ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	
+	// Larger sizes are corrupt files, and their level sizes would overflow.
+	static const int s_maxDimension = 1 << 15;
+	
+	// Enough levels for the largest size.
+	static const int s_maxLevelCount = 16;
+	
+	inline static bool isValidSize(uint width, uint height)
+	{
+		return width > 0 && height > 0 && width <= uint(s_maxDimension) && height <= uint(s_maxDimension);
+	}
+	
+	inline static uint readUInt32(const uchar * p)
+	{
+		return uint(p[0]) | (uint(p[1]) << 8) | (uint(p[2]) << 16) | (uint(p[3]) << 24);
+	}
+	
+	inline static quint64 readUInt64(const uchar * p)
+	{
+		return quint64(readUInt32(p)) | (quint64(readUInt32(p + 4)) << 32);
+	}
+	
+	// Format of the pixels in the containers.
+	struct PixelFormat
+	{
+		uint code;
+		GLenum compressedFormat;
+		GLenum format;
+		GLint internalFormat;
+	};
+	
+	// DXGI formats of the DX10 header.
+	static const PixelFormat s_dxgiFormats[] = {
+		{ 28, 0, GL_RGBA, GL_RGBA8 },
+		{ 29, 0, GL_RGBA, GL_SRGB8_ALPHA8 },
+		{ 87, 0, GL_BGRA, GL_RGBA8 },
+		{ 91, 0, GL_BGRA, GL_SRGB8_ALPHA8 },
+		{ 71, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0 },
+		{ 72, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 0, 0 },
+		{ 74, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0 },
+		{ 75, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 0, 0 },
+		{ 77, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0 },
+		{ 78, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 0, 0 },
+		{ 80, GL_COMPRESSED_RED_RGTC1, 0, 0 },
+		{ 81, GL_COMPRESSED_SIGNED_RED_RGTC1, 0, 0 },
+		{ 83, GL_COMPRESSED_RG_RGTC2, 0, 0 },
+		{ 84, GL_COMPRESSED_SIGNED_RG_RGTC2, 0, 0 },
+#if defined(GL_ARB_texture_compression_bptc)
+		{ 95, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB, 0, 0 },
+		{ 96, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT_ARB, 0, 0 },
+		{ 98, GL_COMPRESSED_RGBA_BPTC_UNORM_ARB, 0, 0 },
+		{ 99, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB, 0, 0 },
+#endif
+	};
+	
+	// Vulkan formats of KTX2 files.
+	static const PixelFormat s_vulkanFormats[] = {
+		{ 23, 0, GL_RGB, GL_RGB8 },
+		{ 29, 0, GL_RGB, GL_SRGB8 },
+		{ 37, 0, GL_RGBA, GL_RGBA8 },
+		{ 43, 0, GL_RGBA, GL_SRGB8_ALPHA8 },
+		{ 44, 0, GL_BGRA, GL_RGBA8 },
+		{ 50, 0, GL_BGRA, GL_SRGB8_ALPHA8 },
+		{ 131, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 0, 0 },
+		{ 132, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 0, 0 },
+		{ 133, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0 },
+		{ 134, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 0, 0 },
+		{ 135, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0 },
+		{ 136, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 0, 0 },
+		{ 137, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0 },
+		{ 138, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 0, 0 },
+		{ 139, GL_COMPRESSED_RED_RGTC1, 0, 0 },
+		{ 140, GL_COMPRESSED_SIGNED_RED_RGTC1, 0, 0 },
+		{ 141, GL_COMPRESSED_RG_RGTC2, 0, 0 },
+		{ 142, GL_COMPRESSED_SIGNED_RG_RGTC2, 0, 0 },
+#if defined(GL_ARB_texture_compression_bptc)
+		{ 143, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB, 0, 0 },
+		{ 144, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT_ARB, 0, 0 },
+		{ 145, GL_COMPRESSED_RGBA_BPTC_UNORM_ARB, 0, 0 },
+		{ 146, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB, 0, 0 },
+#endif
+#if defined(GL_ARB_ES3_compatibility)
+		{ 147, GL_COMPRESSED_RGB8_ETC2, 0, 0 },
+		{ 148, GL_COMPRESSED_SRGB8_ETC2, 0, 0 },
+		{ 149, GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, 0, 0 },
+		{ 150, GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2, 0, 0 },
+		{ 151, GL_COMPRESSED_RGBA8_ETC2_EAC, 0, 0 },
+		{ 152, GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, 0, 0 },
+#endif
+	};
+	
+	template <int N>
+	static const PixelFormat * findFormat(const PixelFormat (&formats)[N], uint code)
+	{
+		for (int i = 0; i < N; i++) {
+			if (formats[i].code == code) {
+				return &formats[i];
+			}
+		}
+		return NULL;
+	}
+	
+	static void setFormat(ImageData & data, const PixelFormat & format)
+	{
+		data.compressedFormat = format.compressedFormat;
+		if (format.compressedFormat == 0) {
+			data.format = format.format;
+			data.type = GL_UNSIGNED_BYTE;
+			data.internalFormat = format.internalFormat;
+		}
+	}
+	
+	// Add a level stored at the given offset, returns false if it is out of the file.
+	static bool addLevel(ImageData & data, const uchar * mem, qint64 size, qint64 offset, int width, int height)
+	{
+		const qint64 levelSize = data.levelSize(width, height);
+		if (offset < 0 || levelSize <= 0 || offset + levelSize > size) {
+			return false;
+		}
+		
+		if (data.pixels == NULL) {
+			data.width = width;
+			data.height = height;
+			data.pixels = mem + offset;
+		}
+		else {
+			ImageData::Level level = { width, height, mem + offset };
+			data.mipmaps.append(level);
+		}
+		return true;
+	}
+	
+	
+	static bool parseDds(const uchar * mem, qint64 size, ImageData & data)
+	{
+		enum {
+			DDSD_MIPMAPCOUNT = 0x20000,
+			DDPF_ALPHAPIXELS = 0x1,
+			DDPF_FOURCC = 0x4,
+			DDPF_RGB = 0x40,
+			DDPF_LUMINANCE = 0x20000,
+			DDSCAPS2_CUBEMAP = 0x200,
+			DDSCAPS2_VOLUME = 0x200000
+		};
+		
+		if (size < 128) {
+			return false;
+		}
+		
+		const uchar * header = mem + 4;
+		const uint flags = readUInt32(header + 4);
+		const uint height = readUInt32(header + 8);
+		const uint width = readUInt32(header + 12);
+		const int mipmapCount = (flags & DDSD_MIPMAPCOUNT) ? qBound(1u, readUInt32(header + 24), uint(s_maxLevelCount)) : 1;
+		const uint caps2 = readUInt32(header + 108);
+		
+		// Only 2D textures.
+		if (!isValidSize(width, height) || (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))) {
+			return false;
+		}
+		
+		const uchar * pf = header + 72;
+		const uint pfFlags = readUInt32(pf + 4);
+		const uint bitCount = readUInt32(pf + 12);
+		const uint redMask = readUInt32(pf + 16);
+		
+		qint64 offset = 128;
+		
+		if (pfFlags & DDPF_FOURCC) {
+			const QByteArray fourCC((const char *)pf + 8, 4);
+			if (fourCC == "DXT1") data.compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+			else if (fourCC == "DXT2" || fourCC == "DXT3") data.compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+			else if (fourCC == "DXT4" || fourCC == "DXT5") data.compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			else if (fourCC == "ATI1" || fourCC == "BC4U") data.compressedFormat = GL_COMPRESSED_RED_RGTC1;
+			else if (fourCC == "ATI2" || fourCC == "BC5U") data.compressedFormat = GL_COMPRESSED_RG_RGTC2;
+			else if (fourCC == "DX10") {
+				if (size < 148) {
+					return false;
+				}
+				const uint dimension = readUInt32(mem + 132);
+				const uint arraySize = readUInt32(mem + 140);
+				const PixelFormat * format = findFormat(s_dxgiFormats, readUInt32(mem + 128));
+				if (format == NULL || dimension != 3 || arraySize > 1) {
+					return false;
+				}
+				setFormat(data, *format);
+				offset = 148;
+			}
+			else {
+				return false;
+			}
+		}
+		else if (pfFlags & DDPF_RGB) {
+			if (bitCount == 32 && redMask == 0x00FF0000) data.format = GL_BGRA;
+			else if (bitCount == 32 && redMask == 0x000000FF) data.format = GL_RGBA;
+			else if (bitCount == 24 && redMask == 0x00FF0000) data.format = GL_BGR;
+			else if (bitCount == 24 && redMask == 0x000000FF) data.format = GL_RGB;
+			else return false;
+			
+			// Ignore the padding of the formats without alpha.
+			if (bitCount == 32 && !(pfFlags & DDPF_ALPHAPIXELS)) {
+				data.internalFormat = GL_RGB8;
+			}
+		}
+		else if (pfFlags & DDPF_LUMINANCE) {
+			if (bitCount == 8) data.format = GL_LUMINANCE;
+			else if (bitCount == 16 && (pfFlags & DDPF_ALPHAPIXELS)) data.format = GL_LUMINANCE_ALPHA;
+			else return false;
+		}
+		else {
+			return false;
+		}
+		
+		// Rows are tightly packed.
+		data.alignment = 1;
+		
+		int w = width, h = height;
+		for (int i = 0; i < mipmapCount; i++) {
+			if (!addLevel(data, mem, size, offset, w, h)) {
+				// Keep the complete levels of truncated files.
+				return data.pixels != NULL;
+			}
+			offset += data.levelSize(w, h);
+			w = qMax(1, w / 2);
+			h = qMax(1, h / 2);
+		}
+		return true;
+	}
+	
+	static bool parseKtx(const uchar * mem, qint64 size, ImageData & data)
+	{
+		if (size < 64 || readUInt32(mem + 12) != 0x04030201) {
+			// Files written on big endian machines are not supported.
+			return false;
+		}
+		
+		const uint glType = readUInt32(mem + 16);
+		const uint glFormat = readUInt32(mem + 24);
+		const uint glInternalFormat = readUInt32(mem + 28);
+		const uint width = readUInt32(mem + 36);
+		const uint height = readUInt32(mem + 40);
+		const uint depth = readUInt32(mem + 44);
+		const uint arrayElements = readUInt32(mem + 48);
+		const uint faces = readUInt32(mem + 52);
+		const int mipmapCount = qBound(1u, readUInt32(mem + 56), uint(s_maxLevelCount));
+		const uint keyValueBytes = readUInt32(mem + 60);
+		
+		if (!isValidSize(width, height) || depth != 0 || arrayElements != 0 || faces != 1) {
+			return false;
+		}
+		
+		if (glType == 0) {
+			if (BlockCodec::blockSize(glInternalFormat) == 0) {
+				return false;
+			}
+			data.compressedFormat = glInternalFormat;
+		}
+		else {
+			if (glType != GL_UNSIGNED_BYTE && glType != GL_UNSIGNED_SHORT) {
+				return false;
+			}
+			if (glFormat != GL_LUMINANCE && glFormat != GL_LUMINANCE_ALPHA && glFormat != GL_RGB && glFormat != GL_BGR &&
+				glFormat != GL_RGBA && glFormat != GL_BGRA) {
+				return false;
+			}
+			data.format = glFormat;
+			data.type = glType;
+			data.internalFormat = glInternalFormat;
+		}
+		
+		// Rows are padded to 4 bytes.
+		data.alignment = 4;
+		
+		qint64 offset = 64 + qint64(keyValueBytes);
+		int w = width, h = height;
+		for (int i = 0; i < mipmapCount; i++) {
+			if (offset + 4 > size) {
+				return data.pixels != NULL;
+			}
+			const uint imageSize = readUInt32(mem + offset);
+			offset += 4;
+			
+			if (qint64(imageSize) < data.levelSize(w, h) || !addLevel(data, mem, size, offset, w, h)) {
+				return data.pixels != NULL;
+			}
+			offset += (qint64(imageSize) + 3) & ~qint64(3);
+			w = qMax(1, w / 2);
+			h = qMax(1, h / 2);
+		}
+		return true;
+	}
+	
+	static bool parseKtx2(const uchar * mem, qint64 size, ImageData & data)
+	{
+		if (size < 80) {
+			return false;
+		}
+		
+		const uint vkFormat = readUInt32(mem + 12);
+		const uint width = readUInt32(mem + 20);
+		const uint height = readUInt32(mem + 24);
+		const uint depth = readUInt32(mem + 28);
+		const uint layers = readUInt32(mem + 32);
+		const uint faces = readUInt32(mem + 36);
+		const int levelCount = qBound(1u, readUInt32(mem + 40), uint(s_maxLevelCount));
+		const uint supercompression = readUInt32(mem + 44);
+		
+		// Supercompressed files need a transcoder.
+		if (!isValidSize(width, height) || depth != 0 || layers != 0 || faces != 1 || supercompression != 0) {
+			return false;
+		}
+		
+		const PixelFormat * format = findFormat(s_vulkanFormats, vkFormat);
+		if (format == NULL || size < 80 + 24 * levelCount) {
+			return false;
+		}
+		setFormat(data, *format);
+		
+		// Rows are tightly packed.
+		data.alignment = 1;
+		
+		int w = width, h = height;
+		for (int i = 0; i < levelCount; i++) {
+			const qint64 offset = qint64(readUInt64(mem + 80 + 24 * i));
+			if (!addLevel(data, mem, size, offset, w, h)) {
+				return data.pixels != NULL;
+			}
+			w = qMax(1, w / 2);
+			h = qMax(1, h / 2);
+		}
+		return true;
+	}
+	
+} // namespace
+
+
+// Plugin for DDS and KTX containers. Compressed levels and stored mipmaps are uploaded as they are.
+class CompressedImagePlugin : public ImagePlugin
+{
+	virtual int priority() const
+	{
+		return 2;
+	}
+	
+	virtual QList<QByteArray> supportedFormats() const
+	{
+		return QList<QByteArray>() << "dds" << "ktx" << "ktx2";
+	}
+	
+	virtual bool canLoad(const QString & fileName) const
+	{
+		return fileName.endsWith(".dds", Qt::CaseInsensitive) || fileName.endsWith(".ktx", Qt::CaseInsensitive) ||
+			fileName.endsWith(".ktx2", Qt::CaseInsensitive);
+	}
+	
+	virtual ImageData decode(const QString & fileName) const
+	{
+		QFile file(fileName);
+		if (!file.open(QIODevice::ReadOnly) || file.size() < 16) {
+			return ImageData();
+		}
+		
+		// The levels point into the file contents.
+		const qint64 size = file.size();
+		ImageData data;
+		data.buffer = QSharedPointer<uchar>((uchar *)malloc(size), free);
+		uchar * mem = data.buffer.data();
+		if (mem == NULL || file.read((char *)mem, size) != size) {
+			return ImageData();
+		}
+		
+		bool succeed = false;
+		if (memcmp(mem, "DDS ", 4) == 0) {
+			succeed = parseDds(mem, size, data);
+		}
+		else if (memcmp(mem, s_ktxIdentifier, 12) == 0) {
+			succeed = parseKtx(mem, size, data);
+		}
+		else if (memcmp(mem, s_ktx2Identifier, 12) == 0) {
+			succeed = parseKtx2(mem, size, data);
+		}
+		
+		if (!succeed || data.width <= 0 || data.height <= 0) {
+			return ImageData();
+		}
+		return data;
+	}
+};
+
+REGISTER_IMAGE_PLUGIN(CompressedImagePlugin);
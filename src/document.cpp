@@ -20,6 +20,7 @@
 #include "document.h"
 #include "effect.h"
 #include "newdialog.h"
+#include "tokenizer.h"
 
 #include <QtCore/QFile>
 #include <QtCore/QTimer>
@@ -175,7 +176,7 @@ bool Document::loadFile(const QString & fileName)
 		m_effect = m_effectFactory->createEffect(m_glWidget);
 		Q_ASSERT(m_effect != NULL);
 		
-		connect(m_effect, SIGNAL(built(bool)), this, SIGNAL(effectBuilt(bool)));
+		connect(m_effect, SIGNAL(built(bool)), this, SLOT(onEffectBuilt(bool)));
 		
 		m_effect->load(m_file);
 		
@@ -388,14 +389,37 @@ bool Document::close()
 }
 
 
-void Document::build(bool threaded /*= true*/)
+/// Build the effect. Returns false if the build was skipped, because only
+/// whitespace or comments changed since the last successful build.
+bool Document::build(bool threaded /*= true*/)
 {
 	Q_ASSERT(m_effect != NULL);
 	
 	emit synchronizeEditors();
+	
+	QByteArray hash;
+	for (int i = 0; i < m_effect->getInputNum(); i++)
+	{
+		hash += tokenHash(m_effect->getInput(i));
+	}
+	
+	if (hash == m_builtHash && !m_effect->isBuilding())
+	{
+		return false;
+	}
+	m_buildHash = hash;
+	
 	emit effectBuilding();
 	
 	m_effect->build(threaded);
+	return true;
+}
+
+void Document::onEffectBuilt(bool succeed)
+{
+	m_builtHash = succeed ? m_buildHash : QByteArray();
+	
+	emit effectBuilt(succeed);
 }
 
 
@@ -426,7 +450,7 @@ void Document::newEffect(const EffectFactory * effectFactory)
 	m_effect = m_effectFactory->createEffect(m_glWidget);
 	Q_ASSERT(m_effect != NULL);
 
-	connect(m_effect, SIGNAL(built(bool)), this, SIGNAL(effectBuilt(bool)));
+	connect(m_effect, SIGNAL(built(bool)), this, SLOT(onEffectBuilt(bool)));
 	
 	m_modified = false;
 	
@@ -463,6 +487,9 @@ void Document::closeEffect()
 	delete m_effect;
 	m_effect = NULL;
 	
+	m_buildHash.clear();
+	m_builtHash.clear();
+	
 	delete m_file;
 	m_file = NULL;
 }
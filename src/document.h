@@ -21,6 +21,7 @@
 #define DOCUMENT_H
 
 #include <QtCore/QString>
+#include <QtCore/QByteArray>
 #include <QtCore/QFileSystemWatcher>
 
 class Effect;
@@ -65,10 +66,14 @@ public slots:
 	void saveAs();
 	bool close();
 	
-	void build(bool threaded = true);
+	bool build(bool threaded = true);
 	
 	void onParameterChanged();
 	
+protected slots:
+	
+	void onEffectBuilt(bool succeed);
+	
 protected:
 	
 	void newEffect(const EffectFactory * effectFactory);
@@ -102,6 +107,10 @@ private:
 	
 	bool m_modified;
 	
+	// Token hash of the inputs being built, and of the last successful build.
+	QByteArray m_buildHash;
+	QByteArray m_builtHash;
+	
 	QFileSystemWatcher m_watch;	
 	
 	// @@ Move to settings.
@@ -25,6 +25,8 @@
 #include "effect.h"
 
 #include <QtCore/QDebug>
+#include <QtGui/QAbstractTextDocumentLayout>
+#include <QtGui/QScrollBar>
 #include <QtGui/QTabBar>
 #include <QtGui/QTextEdit>
 #include <QtGui/QTextCursor>
@@ -35,9 +37,114 @@
 #include <QtGui/QPainter>
 
 
-SourceEdit::SourceEdit(QWidget * parent): QTextEdit(parent), m_line(0), m_lineRect(lineRect())
+// Margin left of the text with the cost of each line.
+class CostGutter : public QWidget
 {
+public:
+    CostGutter(SourceEdit * edit) : QWidget(edit), m_edit(edit)
+    {
+    }
+
+protected:
+    void paintEvent(QPaintEvent * event)
+    {
+        m_edit->paintGutter(event);
+    }
+
+private:
+    SourceEdit * m_edit;
+};
+
+
+SourceEdit::SourceEdit(QWidget * parent): QTextEdit(parent), m_line(0), m_lineRect(lineRect()), m_maxLineCost(0)
+{
+    m_gutter = new CostGutter(this);
+    m_gutter->hide();
+
     connect(this, SIGNAL(cursorPositionChanged()), this, SLOT(cursorChanged()));
+    connect(this, SIGNAL(textChanged()), this, SLOT(onTextChanged()));
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(updateGutter()));
+}
+
+void SourceEdit::setLineCosts(const QVector<int> & costs)
+{
+    m_lineCosts = costs;
+    m_costText = costs.isEmpty() ? QString() : toPlainText();
+
+    m_maxLineCost = 0;
+    foreach (int cost, m_lineCosts) {
+        m_maxLineCost = qMax(m_maxLineCost, cost);
+    }
+
+    setViewportMargins(gutterWidth(), 0, 0, 0);
+    updateGutterGeometry();
+    m_gutter->setVisible(!m_lineCosts.isEmpty());
+    m_gutter->update();
+}
+
+int SourceEdit::gutterWidth() const
+{
+    if (m_lineCosts.isEmpty())
+        return 0;
+
+    const int digits = QString::number(m_maxLineCost).length();
+    return 6 + fontMetrics().width(QLatin1Char('9')) * qMax(digits, 2);
+}
+
+void SourceEdit::updateGutterGeometry()
+{
+    const QRect rect = contentsRect();
+    m_gutter->setGeometry(rect.left(), rect.top(), gutterWidth(), rect.height());
+}
+
+void SourceEdit::updateGutter()
+{
+    if (!m_lineCosts.isEmpty())
+        m_gutter->update();
+}
+
+// The costs would mark the wrong lines once the text is edited, the next analysis shows them again.
+void SourceEdit::onTextChanged()
+{
+    if (!m_lineCosts.isEmpty() && toPlainText() != m_costText)
+        setLineCosts(QVector<int>());
+}
+
+// Lines are shaded from yellow to red with their share of the highest cost.
+void SourceEdit::paintGutter(QPaintEvent * event)
+{
+    QPainter p(m_gutter);
+    p.fillRect(event->rect(), palette().color(QPalette::Window));
+
+    if (m_maxLineCost == 0)
+        return;
+
+    const QAbstractTextDocumentLayout * layout = document()->documentLayout();
+    const int offset = verticalScrollBar()->value();
+    const int width = m_gutter->width();
+
+    int line = 0;
+    for (QTextBlock block = document()->begin(); block.isValid() && line < m_lineCosts.count(); block = block.next(), line++)
+    {
+        const QRect rect = layout->blockBoundingRect(block).translated(0, -offset).toRect();
+        if (rect.top() > event->rect().bottom())
+            break;
+        if (rect.bottom() < event->rect().top() || m_lineCosts.at(line) == 0)
+            continue;
+
+        const int cost = m_lineCosts.at(line);
+        const qreal heat = qreal(cost) / m_maxLineCost;
+        p.fillRect(QRect(0, rect.top(), width, rect.height()), QColor::fromHsvF(0.16 * (1 - heat), 0.2 + 0.6 * heat, 1.0));
+
+        p.setPen(palette().color(QPalette::Text));
+        p.drawText(QRect(0, rect.top(), width - 3, rect.height()), Qt::AlignRight | Qt::AlignVCenter, QString::number(cost));
+    }
+}
+
+void SourceEdit::resizeEvent(QResizeEvent * event)
+{
+    QTextEdit::resizeEvent(event);
+    updateGutterGeometry();
 }
 
 void SourceEdit::keyPressEvent(QKeyEvent * event)
@@ -226,6 +333,23 @@ void Editor::setModified(bool b)
     }
 }
 
+void Editor::setLineCosts(int input, const QVector<int> & costs)
+{
+    SourceEdit * edit = qobject_cast<SourceEdit *>(this->widget(input));
+    if (edit != NULL) {
+        edit->setLineCosts(costs);
+    }
+}
+
+void Editor::clearLineCosts()
+{
+    const int num = this->count();
+    for (int i = 0; i < num; i++)
+    {
+        setLineCosts(i, QVector<int>());
+    }
+}
+
 // slots.
 void Editor::undo()
 {
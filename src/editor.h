@@ -24,8 +24,10 @@
 #include <QtGui/QTabWidget>
 #include <QtGui/QTextDocument>
 #include <QtGui/QTextEdit>
+#include <QtCore/QVector>
 
 class QTextEdit;
+class CostGutter;
 
 class Effect;
 
@@ -54,6 +56,10 @@ public:
 	bool isModified() const;
 	void setModified(bool b);
 	
+	// Show the cost of each line of the given input in the gutter.
+	void setLineCosts(int input, const QVector<int> & costs);
+	void clearLineCosts();
+	
 public slots:
 	void undo();
 	void redo();
@@ -109,18 +115,33 @@ Q_OBJECT
 public:
 	SourceEdit(QWidget * parent = 0);
 
+	// Cost of each line, the gutter is hidden when empty.
+	void setLineCosts(const QVector<int> & costs);
+	void paintGutter(QPaintEvent * event);
+
 protected:
 	void keyPressEvent(QKeyEvent * event);
 	void paintEvent(QPaintEvent * event);
+	void resizeEvent(QResizeEvent * event);
+	
+	int gutterWidth() const;
+	void updateGutterGeometry();
 
 	QRect lineRect();
 	
 protected slots:
 	void cursorChanged();
+	void updateGutter();
+	void onTextChanged();
 
 private:
 	int m_line;
 	QRect m_lineRect;
+	
+	CostGutter * m_gutter;
+	QVector<int> m_lineCosts;
+	int m_maxLineCost;
+	QString m_costText;		// Text the costs were estimated for.
 };
 
 #endif // EDITOR_H
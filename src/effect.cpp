@@ -20,6 +20,7 @@
 #include <QtOpenGL/QGLWidget>
 
 #include "effect.h"
+#include "shadercost.h"
 
 namespace {
 	static QList<const EffectFactory *> * s_factoryList = NULL;
@@ -75,6 +76,11 @@ void EffectFactory::removeFactory(const EffectFactory * factory)
 }
 
 
+ShaderCost Effect::analyzeCost(int input)
+{
+	return ShaderCost::estimate(getInput(input));
+}
+
 void Effect::makeCurrent()
 {
 	m_widget->makeCurrent();
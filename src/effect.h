@@ -37,6 +37,7 @@ class EffectFactory;
 class Parameter;
 class OutputParser;
 class QGLWidget;
+struct ShaderCost;
 
 class Effect : public QObject
 {
@@ -77,6 +78,9 @@ public:
 	virtual void build(bool threaded) = 0;
 	virtual bool isBuilding() const = 0; 
 	
+	// Background builds keep the current program usable until the new one is ready.
+	virtual bool buildsInBackground() const { return false; }
+	
 	// Parameter info.
 	virtual int parameterCount() const = 0;
 	virtual const Parameter * parameterAt(int idx) const = 0;
@@ -86,6 +90,18 @@ public:
 	virtual bool isValid() const = 0;
 	virtual bool isAnimated() const = 0;
 	
+	// Override the time of animated effects, in seconds. A negative time follows the clock.
+	virtual void setTime(float seconds) { Q_UNUSED(seconds); }
+	virtual float time() const { return 0.0f; }
+	
+	// Specialized effects render with the frozen parameters baked into the program as constants.
+	virtual bool canSpecialize() const { return false; }
+	virtual bool isSpecialized() const { return false; }
+	virtual void setSpecialized(bool b) { Q_UNUSED(b); }
+	
+	// Static cost of an input, estimated from the source unless the driver reports it.
+	virtual ShaderCost analyzeCost(int input);
+	
 	// Technique info.
 	virtual int getTechniqueNum() const = 0;
 	virtual QString getTechniqueName(int t) const = 0;
@@ -107,6 +123,7 @@ signals:
 	void buildMessage(QString msg, int input, OutputParser * parser);
 	
 	void built(bool succeed);
+	void specialized(bool succeed);
 	
 private:
 	EffectFactory const * const m_factory;
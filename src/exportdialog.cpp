@@ -0,0 +1,93 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "exportdialog.h"
+
+#include <QtGui/QFileDialog>
+#include <QtGui/QMessageBox>
+
+
+ExportDialog::ExportDialog(QWidget *parent/*=0*/) : QDialog(parent)
+{
+	ui.setupUi(this);
+	
+	connect(ui.buttonBox, SIGNAL(accepted()), this, SLOT(accept()));
+	connect(ui.browseButton, SIGNAL(clicked()), this, SLOT(browse()));
+	connect(ui.videoCheckBox, SIGNAL(toggled(bool)), this, SLOT(updateVideoControls()));
+	
+	updateVideoControls();
+}
+
+SequenceExporter::Options ExportDialog::options() const
+{
+	SequenceExporter::Options options;
+	options.fileName = ui.fileEdit->text();
+	options.size = QSize(ui.widthSpinBox->value(), ui.heightSpinBox->value());
+	options.frameRate = ui.frameRateSpinBox->value();
+	options.frameCount = ui.frameCountSpinBox->value();
+	options.startTime = ui.startTimeSpinBox->value();
+	options.video = ui.videoCheckBox->isChecked();
+	options.ffmpeg = ui.ffmpegEdit->text();
+	return options;
+}
+
+void ExportDialog::setOptions(const SequenceExporter::Options & options)
+{
+	ui.fileEdit->setText(options.fileName);
+	ui.widthSpinBox->setValue(options.size.width());
+	ui.heightSpinBox->setValue(options.size.height());
+	ui.frameRateSpinBox->setValue(options.frameRate);
+	ui.frameCountSpinBox->setValue(options.frameCount);
+	ui.startTimeSpinBox->setValue(options.startTime);
+	ui.videoCheckBox->setChecked(options.video);
+	ui.ffmpegEdit->setText(options.ffmpeg);
+}
+
+void ExportDialog::accept()
+{
+	if( ui.fileEdit->text().isEmpty() ) {
+		QMessageBox::warning(this, windowTitle(), tr("Choose the file to export to."));
+		ui.fileEdit->setFocus();
+		return;
+	}
+	QDialog::accept();
+}
+
+void ExportDialog::browse()
+{
+	QString filter;
+	if( ui.videoCheckBox->isChecked() ) {
+		filter = tr("Videos (*.mp4 *.mkv *.avi *.mov)");
+	}
+	else {
+		filter = tr("Images (*.png *.exr)");
+	}
+	
+	const QString fileName = QFileDialog::getSaveFileName(this, windowTitle(), ui.fileEdit->text(), filter);
+	if( !fileName.isEmpty() ) {
+		ui.fileEdit->setText(fileName);
+	}
+}
+
+void ExportDialog::updateVideoControls()
+{
+	ui.ffmpegLabel->setEnabled(ui.videoCheckBox->isChecked());
+	ui.ffmpegEdit->setEnabled(ui.videoCheckBox->isChecked());
+}
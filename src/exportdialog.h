@@ -0,0 +1,51 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef EXPORTDIALOG_H
+#define EXPORTDIALOG_H
+
+#include <QtGui/QDialog>
+
+#include "sequenceexport.h"
+#include "ui_exportdialog.h"
+
+
+class ExportDialog : public QDialog
+{
+	Q_OBJECT
+	public:
+		ExportDialog(QWidget *parent = 0);
+		
+		SequenceExporter::Options options() const;
+		void setOptions(const SequenceExporter::Options & options);
+		
+	public slots:
+		virtual void accept();
+		
+	private slots:
+		void browse();
+		void updateVideoControls();
+		
+	private:
+		Ui::ExportDialog ui;
+};
+
+
+#endif // EXPORTDIALOG_H
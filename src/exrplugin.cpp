@@ -0,0 +1,474 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "imageplugin.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QVector>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+namespace
+{
+	enum PixelType { PIXEL_UINT = 0, PIXEL_HALF = 1, PIXEL_FLOAT = 2 };
+	
+	enum Compression { NO_COMPRESSION = 0, RLE_COMPRESSION = 1, ZIPS_COMPRESSION = 2, ZIP_COMPRESSION = 3 };
+	
+	// Limits of the untrusted header values, so that the sizes derived from them fit in an int.
+	static const int s_maxChannelCount = 1024;
+	static const qint64 s_maxBlockSize = 0x10000000;
+	
+	inline static uint readUInt32(const uchar * p)
+	{
+		return uint(p[0]) | (uint(p[1]) << 8) | (uint(p[2]) << 16) | (uint(p[3]) << 24);
+	}
+	
+	inline static float readFloat(const uchar * p)
+	{
+		const uint bits = readUInt32(p);
+		float f;
+		memcpy(&f, &bits, 4);
+		return f;
+	}
+	
+	static bool readUInt32(QFile & file, uint * value)
+	{
+		uchar bytes[4];
+		if (file.read((char *)bytes, 4) != 4) {
+			return false;
+		}
+		*value = readUInt32(bytes);
+		return true;
+	}
+	
+	static bool readString(QFile & file, QByteArray * str)
+	{
+		str->clear();
+		char c;
+		while (file.getChar(&c)) {
+			if (c == '\0') {
+				return true;
+			}
+			if (str->size() >= 255) {
+				return false;
+			}
+			*str += c;
+		}
+		return false;
+	}
+	
+	struct Channel
+	{
+		int type;
+		int slot;		// Channel of the image, or -1 when it is not loaded.
+	};
+	
+	// Header attributes used by the reader.
+	struct Header
+	{
+		Header() : compression(-1), xMin(0), yMin(0), xMax(-1), yMax(-1), tiled(false), tileWidth(0), tileHeight(0) {}
+		
+		QList<QByteArray> channelNames;
+		QList<int> channelTypes;
+		int compression;
+		int xMin, yMin, xMax, yMax;
+		bool tiled;
+		int tileWidth, tileHeight;
+	};
+	
+	static bool readHeader(QFile & file, Header * header)
+	{
+		forever {
+			QByteArray name, type;
+			if (!readString(file, &name)) {
+				return false;
+			}
+			if (name.isEmpty()) {
+				return true;
+			}
+			
+			uint size;
+			if (!readString(file, &type) || !readUInt32(file, &size) || size > 0x100000) {
+				return false;
+			}
+			const QByteArray value = file.read(size);
+			if (uint(value.size()) != size) {
+				return false;
+			}
+			const uchar * v = (const uchar *)value.constData();
+			
+			if (name == "channels" && type == "chlist") {
+				// Name, pixel type, linear flag and reserved bytes, sampling.
+				int i = 0;
+				while (i < value.size() && v[i] != 0) {
+					const int end = value.indexOf('\0', i);
+					if (end < 0 || end + 17 > value.size()) {
+						return false;
+					}
+					const uchar * p = v + end + 1;
+					if (readUInt32(p + 8) != 1 || readUInt32(p + 12) != 1) {
+						// Subsampled channels are not supported.
+						return false;
+					}
+					header->channelNames.append(value.mid(i, end - i));
+					header->channelTypes.append(readUInt32(p));
+					i = end + 17;
+				}
+			}
+			else if (name == "compression" && size == 1) {
+				header->compression = v[0];
+			}
+			else if (name == "dataWindow" && size == 16) {
+				header->xMin = readUInt32(v);
+				header->yMin = readUInt32(v + 4);
+				header->xMax = readUInt32(v + 8);
+				header->yMax = readUInt32(v + 12);
+			}
+			else if (name == "tiles" && size == 9) {
+				header->tileWidth = readUInt32(v);
+				header->tileHeight = readUInt32(v + 4);
+			}
+		}
+	}
+	
+	// Undo the predictor and the byte interleaving of the RLE and ZIP compressions.
+	static void reconstruct(QByteArray & data)
+	{
+		uchar * t = (uchar *)data.data();
+		const int size = data.size();
+		
+		for (int i = 1; i < size; i++) {
+			t[i] = uchar(t[i - 1] + t[i] - 128);
+		}
+		
+		QByteArray out(size, 0);
+		const uchar * t1 = t;
+		const uchar * t2 = t + (size + 1) / 2;
+		for (int i = 0; i < size; i++) {
+			out[i] = char((i & 1) ? t2[i / 2] : t1[i / 2]);
+		}
+		data = out;
+	}
+	
+	static bool decompressRle(const QByteArray & in, int size, QByteArray * out)
+	{
+		out->resize(size);
+		const uchar * src = (const uchar *)in.constData();
+		const uchar * end = src + in.size();
+		uchar * dst = (uchar *)out->data();
+		int n = 0;
+		
+		while (src < end) {
+			const int count = (signed char)*src++;
+			if (count < 0) {
+				if (n - count > size || src - count > end) {
+					return false;
+				}
+				memcpy(dst + n, src, -count);
+				src += -count;
+				n += -count;
+			}
+			else {
+				if (n + count + 1 > size || src >= end) {
+					return false;
+				}
+				memset(dst + n, *src++, count + 1);
+				n += count + 1;
+			}
+		}
+		return n == size;
+	}
+	
+	static bool decompressZip(const QByteArray & in, int size, QByteArray * out)
+	{
+		// qUncompress expects the size in front of the zlib stream.
+		QByteArray stream;
+		stream.reserve(in.size() + 4);
+		stream += char((size >> 24) & 0xFF);
+		stream += char((size >> 16) & 0xFF);
+		stream += char((size >> 8) & 0xFF);
+		stream += char(size & 0xFF);
+		stream += in;
+		
+		*out = qUncompress(stream);
+		return out->size() == size;
+	}
+	
+} // namespace
+
+
+// Plugin for scanline and tiled OpenEXR images. Half channels are uploaded as they are, files
+// with float or integer channels are decoded to float. Blocks are read one at a time.
+class ExrImagePlugin : public ImagePlugin
+{
+	virtual int priority() const
+	{
+		return 2;
+	}
+	
+	virtual QList<QByteArray> supportedFormats() const
+	{
+		return QList<QByteArray>() << "exr";
+	}
+	
+	virtual bool canLoad(const QString & fileName) const
+	{
+		QFile file(fileName);
+		uint magic;
+		return file.open(QIODevice::ReadOnly) && readUInt32(file, &magic) && magic == 20000630;
+	}
+	
+	virtual ImageData decode(const QString & fileName) const
+	{
+		QFile file(fileName);
+		if (!file.open(QIODevice::ReadOnly)) {
+			return ImageData();
+		}
+		
+		uint magic, version;
+		if (!readUInt32(file, &magic) || !readUInt32(file, &version) || magic != 20000630 || (version & 0xFF) != 2) {
+			return ImageData();
+		}
+		
+		// Deep and multipart files are not supported.
+		if (version & (0x800 | 0x1000)) {
+			return ImageData();
+		}
+		
+		Header header;
+		header.tiled = (version & 0x200) != 0;
+		if (!readHeader(file, &header)) {
+			return ImageData();
+		}
+		
+		int linesPerBlock;
+		switch (header.compression) {
+			case NO_COMPRESSION:
+			case RLE_COMPRESSION:
+			case ZIPS_COMPRESSION:
+				linesPerBlock = 1;
+				break;
+			case ZIP_COMPRESSION:
+				linesPerBlock = 16;
+				break;
+			default:
+				// PIZ, PXR24, B44 and DWA are not supported.
+				return ImageData();
+		}
+		
+		const qint64 width = qint64(header.xMax) - header.xMin + 1;
+		const qint64 height = qint64(header.yMax) - header.yMin + 1;
+		if (width <= 0 || height <= 0 || width * height > 0x4000000) {
+			return ImageData();
+		}
+		const int w = int(width);
+		const int h = int(height);
+		if (header.tiled && (header.tileWidth <= 0 || header.tileHeight <= 0)) {
+			return ImageData();
+		}
+		if (header.channelNames.count() > s_maxChannelCount) {
+			return ImageData();
+		}
+		
+		// Pick the color channels of the default layer.
+		const int R = header.channelNames.indexOf("R");
+		const int G = header.channelNames.indexOf("G");
+		const int B = header.channelNames.indexOf("B");
+		const int A = header.channelNames.indexOf("A");
+		const int Y = header.channelNames.indexOf("Y");
+		
+		ImageData data;
+		QVector<Channel> channels(header.channelNames.count());
+		for (int i = 0; i < channels.count(); i++) {
+			channels[i].type = header.channelTypes.at(i);
+			channels[i].slot = -1;
+		}
+		
+		if (R >= 0 || G >= 0 || B >= 0) {
+			data.format = (A >= 0) ? GL_RGBA : GL_RGB;
+			if (R >= 0) channels[R].slot = 0;
+			if (G >= 0) channels[G].slot = 1;
+			if (B >= 0) channels[B].slot = 2;
+			if (A >= 0) channels[A].slot = 3;
+		}
+		else if (Y >= 0) {
+			data.format = (A >= 0) ? GL_LUMINANCE_ALPHA : GL_LUMINANCE;
+			channels[Y].slot = 0;
+			if (A >= 0) channels[A].slot = 1;
+		}
+		else {
+			return ImageData();
+		}
+		
+		// Keep half channels as they are, the textures are half floats anyway.
+		bool allHalf = true;
+		foreach (const Channel & channel, channels) {
+			if (channel.type < PIXEL_UINT || channel.type > PIXEL_FLOAT) {
+				return ImageData();
+			}
+			if (channel.slot >= 0 && channel.type != PIXEL_HALF) {
+				allHalf = false;
+			}
+		}
+		
+		data.width = w;
+		data.height = h;
+		data.type = allHalf ? GL_HALF_FLOAT_ARB : GL_FLOAT;
+		data.alignment = 4;
+		
+		// Missing channels are zero.
+		const int outSize = data.bytesPerLine() * h;
+		data.buffer = QSharedPointer<uchar>((uchar *)calloc(outSize, 1), free);
+		if (data.buffer.isNull()) {
+			return ImageData();
+		}
+		data.pixels = data.buffer.data();
+		
+		const int outChannels = data.channelCount();
+		const int outChannelSize = data.channelSize();
+		
+		// Block layout. Tiled files store the first level before the mipmaps, so only it is read.
+		// Tiles larger than the data window hold a single block.
+		const int blockWidth = header.tiled ? qMin(header.tileWidth, w) : w;
+		const int blockHeight = header.tiled ? qMin(header.tileHeight, h) : linesPerBlock;
+		const int blocksX = (w + blockWidth - 1) / blockWidth;
+		const int blocksY = (h + blockHeight - 1) / blockHeight;
+		
+		// The offset table has to fit in the file.
+		if (qint64(blocksX) * blocksY * 8 > file.size() - file.pos()) {
+			return ImageData();
+		}
+		
+		QVector<quint64> offsets(blocksX * blocksY);
+		for (int i = 0; i < offsets.count(); i++) {
+			uint lo, hi;
+			if (!readUInt32(file, &lo) || !readUInt32(file, &hi)) {
+				return ImageData();
+			}
+			offsets[i] = quint64(lo) | (quint64(hi) << 32);
+		}
+		
+		QByteArray block, pixels;
+		for (int i = 0; i < offsets.count(); i++) {
+			const int bx = i % blocksX;
+			const int by = i / blocksX;
+			
+			uint coords[4] = { 0, 0, 0, 0 };
+			uint packedSize;
+			if (!file.seek(offsets[i]) || !readUInt32(file, &coords[0])) {
+				return ImageData();
+			}
+			if (header.tiled && (!readUInt32(file, &coords[1]) || !readUInt32(file, &coords[2]) || !readUInt32(file, &coords[3]))) {
+				return ImageData();
+			}
+			if (!readUInt32(file, &packedSize) || packedSize > 0x10000000) {
+				return ImageData();
+			}
+			
+			// Rectangle of the block in the image.
+			int x0, y0;
+			if (header.tiled) {
+				if (coords[2] != 0 || coords[3] != 0 || int(coords[0]) != bx || int(coords[1]) != by) {
+					return ImageData();
+				}
+				x0 = bx * blockWidth;
+				y0 = by * blockHeight;
+			}
+			else {
+				x0 = 0;
+				y0 = int(coords[0]) - header.yMin;
+				if (y0 < 0 || y0 >= h || y0 % blockHeight != 0) {
+					return ImageData();
+				}
+			}
+			const int bw = qMin(blockWidth, w - x0);
+			const int bh = qMin(blockHeight, h - y0);
+			
+			qint64 lineSize = 0;
+			foreach (const Channel & channel, channels) {
+				lineSize += qint64(bw) * (channel.type == PIXEL_HALF ? 2 : 4);
+			}
+			if (lineSize * bh > s_maxBlockSize) {
+				return ImageData();
+			}
+			const int size = int(lineSize * bh);
+			
+			block = file.read(packedSize);
+			if (uint(block.size()) != packedSize) {
+				return ImageData();
+			}
+			
+			// Blocks that do not compress are stored as they are.
+			if (packedSize == uint(size) || header.compression == NO_COMPRESSION) {
+				pixels = block;
+			}
+			else if (header.compression == RLE_COMPRESSION) {
+				if (!decompressRle(block, size, &pixels)) {
+					return ImageData();
+				}
+				reconstruct(pixels);
+			}
+			else {
+				if (!decompressZip(block, size, &pixels)) {
+					return ImageData();
+				}
+				reconstruct(pixels);
+			}
+			if (pixels.size() != size) {
+				return ImageData();
+			}
+			
+			// Each line stores the channels one after the other.
+			const uchar * src = (const uchar *)pixels.constData();
+			for (int y = 0; y < bh; y++) {
+				uchar * row = data.buffer.data() + (y0 + y) * data.bytesPerLine() + x0 * outChannels * outChannelSize;
+				
+				foreach (const Channel & channel, channels) {
+					const int inSize = (channel.type == PIXEL_HALF) ? 2 : 4;
+					if (channel.slot >= 0) {
+						for (int x = 0; x < bw; x++) {
+							const uchar * in = src + x * inSize;
+							uchar * out = row + (x * outChannels + channel.slot) * outChannelSize;
+							
+							if (allHalf) {
+								const ushort value = ushort(in[0] | (in[1] << 8));
+								memcpy(out, &value, 2);
+								continue;
+							}
+							
+							float value;
+							if (channel.type == PIXEL_HALF) value = halfToFloat(ushort(in[0] | (in[1] << 8)));
+							else if (channel.type == PIXEL_FLOAT) value = readFloat(in);
+							else value = float(readUInt32(in));
+							memcpy(out, &value, 4);
+						}
+					}
+					src += bw * inSize;
+				}
+			}
+		}
+		
+		return data;
+	}
+};
+
+REGISTER_IMAGE_PLUGIN(ExrImagePlugin);
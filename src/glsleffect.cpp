@@ -24,12 +24,24 @@
 #include "texmanager.h"
 #include "parameter.h"
 #include "glutils.h"
+#include "programcache.h"
+#include "glstate.h"
+#include "mesh.h"
+#include "tokenizer.h"
+#include "transform.h"
 
 #include <QtCore/QFile>
 #include <QtCore/QByteArray>
 #include <QtCore/QTime>
 #include <QtCore/QVariant>
 #include <QtCore/QDir>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QEvent>
+#include <QtCore/QMap>
+#include <QtCore/QRegExp>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
 
 #include <QtGui/QImage>
 
@@ -64,6 +76,32 @@ namespace {
 		"	gl_FragColor = ambient + diffuse + specular;\n"
 		"}\n";
 
+	// Generic vertex attributes supplied by the scene meshes.
+	static const struct {
+		GLuint index;
+		const char * name;
+	} s_attributes[] = {
+		{ Mesh::PositionAttribute, "position" },
+		{ Mesh::NormalAttribute, "normal" },
+		{ Mesh::TexCoordAttribute, "texcoord" },
+		{ Mesh::TangentAttribute, "tangent" },
+		{ Mesh::BitangentAttribute, "bitangent" }
+	};
+	static const int s_attributeCount = sizeof(s_attributes) / sizeof(s_attributes[0]);
+
+	// The attribute bindings are part of the linked program.
+	static QByteArray attributeBindings()
+	{
+		QByteArray bindings;
+		for(int i = 0; i < s_attributeCount; i++) {
+			bindings += s_attributes[i].name;
+			bindings += '=';
+			bindings += QByteArray::number(s_attributes[i].index);
+			bindings += ';';
+		}
+		return bindings;
+	}
+
 	// GLSL shader file tags.
 	static const char * s_vertexShaderTag = "[VertexShader]\n";
 	static const char * s_fragmentShaderTag = "[FragmentShader]\n";
@@ -236,6 +274,108 @@ namespace {
 		return 0;
 	}
 	
+	static bool isPrecisionQualifier(const QByteArray & text)
+	{
+		return text == "lowp" || text == "mediump" || text == "highp";
+	}
+	
+	// Replace the declarations of the given uniforms by constants with the same name, and add
+	// their names to the replaced set. Comments and preprocessor directives are left alone.
+	// The declarations are rewritten in place, so that the line numbers do not change.
+	static QByteArray specializeSource(const QByteArray & source, const QMap<QString, QString> & constants, QSet<QString> * replaced)
+	{
+		const QList<Token> tokens = tokenize(source);
+		const int count = tokens.count();
+		QByteArray text = source;
+		
+		// Rewrite from the end, so that the offsets of the earlier declarations stay valid.
+		for(int i = count - 1; i >= 0; i--) {
+			if( tokens[i].directive || tokens[i].text != "uniform" ) {
+				continue;
+			}
+			
+			// Layout qualifiers do not apply to constants.
+			if( i > 0 && tokens[i - 1].text == ")" ) {
+				continue;
+			}
+			
+			int t = i + 1;
+			QString type;
+			while( t < count && isPrecisionQualifier(tokens[t].text) ) {
+				type += QString::fromLatin1(tokens[t++].text) + " ";
+			}
+			if( t >= count ) {
+				continue;
+			}
+			type += QString::fromLatin1(tokens[t++].text);
+			
+			// Uniform blocks are not specialized.
+			if( t >= count || tokens[t].text == "{" ) {
+				continue;
+			}
+			
+			// Declarators are separated by commas outside of constructors and array sizes.
+			QList<QList<QByteArray> > declarators;
+			QList<QByteArray> declarator;
+			int depth = 0;
+			int end = t;
+			for( ; end < count; end++ ) {
+				const QByteArray & token = tokens[end].text;
+				if( depth == 0 && (token == "," || token == ";") ) {
+					declarators << declarator;
+					declarator.clear();
+					if( token == ";" ) {
+						break;
+					}
+					continue;
+				}
+				if( token == "(" || token == "[" ) depth++;
+				else if( token == ")" || token == "]" ) depth--;
+				declarator << token;
+			}
+			if( end >= count ) {
+				continue;
+			}
+			
+			QStringList uniforms;
+			QStringList consts;
+			foreach(const QList<QByteArray> & parts, declarators) {
+				// Arrays and initialized uniforms keep their declaration.
+				const QString name = parts.count() == 1 ? QString::fromLatin1(parts.first()) : QString();
+				if( !name.isEmpty() && constants.contains(name) ) {
+					consts << "const " + type + " " + name + " = " + constants.value(name) + ";";
+					replaced->insert(name);
+				}
+				else {
+					QByteArray declaration;
+					foreach(const QByteArray & part, parts) {
+						if( !declaration.isEmpty() ) declaration += " ";
+						declaration += part;
+					}
+					uniforms << QString::fromLatin1(declaration);
+				}
+			}
+			
+			if( consts.isEmpty() ) {
+				continue;
+			}
+			
+			const int start = tokens[i].offset;
+			const int length = tokens[end].offset + 1 - start;
+			
+			QString replacement;
+			if( !uniforms.isEmpty() ) {
+				replacement = "uniform " + type + " " + uniforms.join(", ") + "; ";
+			}
+			replacement += consts.join(" ");
+			replacement += QString(text.mid(start, length).count('\n'), '\n');
+			
+			text.replace(start, length, replacement.toLatin1());
+		}
+		
+		return text;
+	}
+	
 	/// GLSL Parameter
 	class GLSLParameter : public Parameter
 	{
@@ -244,11 +384,32 @@ namespace {
 		GLint m_location;
 		int m_texUnit; // only valid if isTexture() returns true
 		
+		// Uniform block layout, only valid if blockIndex() != -1
+		int m_blockIndex;
+		GLint m_offset;
+		GLint m_matrixStride;
+		bool m_rowMajor;
+		
+		// Packed uniform value, kept in sync with the variant value.
+		union ValueBlock {
+			GLfloat f[16];
+			GLint i[16];
+		};
+		ValueBlock m_block;
+		bool m_dirty;
+		
+		// Frozen state of the parameter in the specialized program, and whether its value changed since.
+		bool m_specializedFrozen;
+		bool m_valueChanged;
+		
 	public:
 		GLSLParameter(const QString& name, GLenum type, GLint location):
-			m_type(type), m_location(location), m_texUnit(0)
+			m_type(type), m_location(location), m_texUnit(0),
+			m_blockIndex(-1), m_offset(0), m_matrixStride(0), m_rowMajor(false), m_dirty(true),
+			m_specializedFrozen(false), m_valueChanged(true)
 		{
 			setName(name);
+			memset(&m_block, 0, sizeof(m_block));
 			
 			if( name.contains("color", Qt::CaseInsensitive) ) {
 				if (m_type == GL_FLOAT_VEC3_ARB || m_type == GL_FLOAT_VEC4_ARB) {
@@ -260,12 +421,61 @@ namespace {
 		virtual int rows() const { return getRowNum(m_type); }
 		virtual int columns() const { return getColumnNum(m_type); }
 		
+		virtual void setValue(const QVariant & value)
+		{
+			Parameter::setValue(value);
+			updateValueBlock();
+		}
+		
+		virtual void setComponentValue(int idx, const QVariant & value)
+		{
+			Parameter::setComponentValue(idx, value);
+			updateValueBlock();
+		}
+		
 		GLenum glType() const { return m_type; }
 		GLint location() const { return m_location; }
 		
 		void setLocation(GLint location)
 		{
 			m_location = location;
+			m_dirty = true;
+		}
+		
+		// Only plain uniforms can be replaced by constants.
+		virtual bool canFreeze() const
+		{
+			const GLenum base = baseType();
+			return (base == GL_FLOAT || base == GL_INT || base == GL_BOOL_ARB) && m_blockIndex == -1 && !name().contains('[');
+		}
+		
+		// GLSL expression of the current value.
+		QString literal() const
+		{
+			const GLenum base = baseType();
+			const int count = valueCount();
+			
+			QStringList values;
+			for(int i = 0; i < count; i++) {
+				if( base == GL_FLOAT ) {
+					QString str = QString::number(m_block.f[i], 'g', 9);
+					if( !str.contains('.') && !str.contains('e') ) {
+						str += ".0";
+					}
+					values << str;
+				}
+				else if( base == GL_BOOL_ARB ) {
+					values << (m_block.i[i] ? "true" : "false");
+				}
+				else {
+					values << QString::number(m_block.i[i]);
+				}
+			}
+			
+			if( count == 1 ) {
+				return values.first();
+			}
+			return getTypeName(m_type) + "(" + values.join(", ") + ")";
 		}
 		
 		bool isTexture() const
@@ -282,11 +492,157 @@ namespace {
 		void setTextureUnit(int unit)
 		{
 			m_texUnit = unit;
+			m_block.i[0] = unit;
+			m_dirty = true;
 		}
 		
 		GLenum baseType() const {
 			return getBaseType(m_type);		
 		}
+		
+		// Number of scalars in the value block.
+		int valueCount() const
+		{
+			return qMax(1, getRowNum(m_type)) * qMax(1, getColumnNum(m_type));
+		}
+		
+		const GLfloat * floatData() const { return m_block.f; }
+		const GLint * intData() const { return m_block.i; }
+		
+		bool isDirty() const { return m_dirty; }
+		void setDirty(bool dirty) { m_dirty = dirty; }
+		
+		// Replaced by a constant in the specialized program.
+		bool isConstant() const { return isFrozen() && canFreeze(); }
+		
+		// The specialized program is out of date when the parameter was frozen or thawed, or its frozen value changed.
+		bool specializationChanged() const { return isConstant() != m_specializedFrozen || (m_specializedFrozen && m_valueChanged); }
+		void setSpecialized() { m_specializedFrozen = isConstant(); m_valueChanged = false; }
+		
+		int blockIndex() const { return m_blockIndex; }
+		
+		void setBlockLayout(int blockIndex, const QString & blockName, GLint offset, GLint matrixStride, bool rowMajor)
+		{
+			m_blockIndex = blockIndex;
+			m_offset = offset;
+			m_matrixStride = matrixStride;
+			m_rowMajor = rowMajor;
+			setGroup(blockName);
+		}
+		
+		// Write the value block into the uniform block storage, using the layout reported by the driver.
+		void pack(char * buffer) const
+		{
+			Q_ASSERT(m_blockIndex != -1);
+			
+			const int rowCount = qMax(1, getRowNum(m_type));
+			const int columnCount = qMax(1, getColumnNum(m_type));
+			
+			for(int c = 0; c < columnCount; c++) {
+				for(int r = 0; r < rowCount; r++) {
+					int offset;
+					if( m_rowMajor ) offset = m_offset + r * m_matrixStride + c * sizeof(GLfloat);
+					else offset = m_offset + c * m_matrixStride + r * sizeof(GLfloat);
+					
+					memcpy(buffer + offset, &m_block.i[c * rowCount + r], sizeof(GLint));
+				}
+			}
+		}
+		
+		// Upload the value block to the current program if it changed.
+		void upload()
+		{
+			upload(m_location);
+		}
+		
+		void upload(GLint location)
+		{
+			if( !m_dirty ) {
+				return;
+			}
+			m_dirty = false;
+			
+			switch( m_type ) {
+				case GL_FLOAT:
+					glUniform1fvARB(location, 1, m_block.f);
+					break;
+				case GL_FLOAT_VEC2_ARB:
+					glUniform2fvARB(location, 1, m_block.f);
+					break;
+				case GL_FLOAT_VEC3_ARB:
+					glUniform3fvARB(location, 1, m_block.f);
+					break;
+				case GL_FLOAT_VEC4_ARB:
+					glUniform4fvARB(location, 1, m_block.f);
+					break;
+				case GL_INT:
+				case GL_BOOL_ARB:
+				case GL_SAMPLER_1D_ARB:
+				case GL_SAMPLER_2D_ARB:
+				case GL_SAMPLER_3D_ARB:
+				case GL_SAMPLER_CUBE_ARB:
+				case GL_SAMPLER_2D_RECT_ARB:
+					glUniform1ivARB(location, 1, m_block.i);
+					break;
+				case GL_INT_VEC2_ARB:
+				case GL_BOOL_VEC2_ARB:
+					glUniform2ivARB(location, 1, m_block.i);
+					break;
+				case GL_INT_VEC3_ARB:
+				case GL_BOOL_VEC3_ARB:
+					glUniform3ivARB(location, 1, m_block.i);
+					break;
+				case GL_INT_VEC4_ARB:
+				case GL_BOOL_VEC4_ARB:
+					glUniform4ivARB(location, 1, m_block.i);
+					break;
+				case GL_FLOAT_MAT2_ARB:
+					glUniformMatrix2fvARB(location, 1, GL_FALSE, m_block.f);
+					break;
+				case GL_FLOAT_MAT3_ARB:
+					glUniformMatrix3fvARB(location, 1, GL_FALSE, m_block.f);
+					break;
+				case GL_FLOAT_MAT4_ARB:
+					glUniformMatrix4fvARB(location, 1, GL_FALSE, m_block.f);
+					break;
+			}
+		}
+		
+	private:
+		
+		// Convert the variant value to its packed representation.
+		void updateValueBlock()
+		{
+			if( isTexture() ) {
+				return;
+			}
+			
+			ValueBlock block;
+			memset(&block, 0, sizeof(block));
+			
+			const GLenum base = baseType();
+			const int count = valueCount();
+			const QVariant v = value();
+			
+			if( v.type() == QVariant::List ) {
+				const QVariantList list = v.toList();
+				const int n = qMin(count, list.count());
+				for(int i = 0; i < n; i++) {
+					if( base == GL_FLOAT ) block.f[i] = float(list.at(i).toDouble());
+					else block.i[i] = (base == GL_BOOL_ARB) ? list.at(i).toBool() : list.at(i).toInt();
+				}
+			}
+			else if( v.isValid() ) {
+				if( base == GL_FLOAT ) block.f[0] = float(v.toDouble());
+				else block.i[0] = (base == GL_BOOL_ARB) ? v.toBool() : v.toInt();
+			}
+			
+			if( memcmp(&block, &m_block, sizeof(GLint) * count) != 0 ) {
+				memcpy(&m_block, &block, sizeof(GLint) * count);
+				m_dirty = true;
+				m_valueChanged = true;
+			}
+		}
 	};
 
 }
@@ -304,13 +660,111 @@ private:
 	QByteArray m_vertexShaderText;
 	QByteArray m_fragmentShaderText;
 
+	// Hash of the source compiled into each shader object.
+	QByteArray m_vertexShaderHash;
+	QByteArray m_fragmentShaderHash;
+
 	QTime m_time;
-	GLint m_timeUniform;
+	float m_fixedTime;
+
+	// Time and matrix uniforms for shaders that do not use the fixed function state.
+	struct StandardUniforms
+	{
+		GLint time;
+		GLint modelView;
+		GLint projection;
+		GLint modelViewProjection;
+		GLint normalMatrix;
+		
+		StandardUniforms()
+		{
+			clear();
+		}
+		
+		void clear()
+		{
+			time = modelView = projection = modelViewProjection = normalMatrix = -1;
+		}
+		
+		// Returns false if the name is not a standard uniform.
+		bool set(const QString & name, GLint location)
+		{
+			if( name.toLower() == "time" ) time = location;
+			else if( name == "modelViewMatrix" ) modelView = location;
+			else if( name == "projectionMatrix" ) projection = location;
+			else if( name == "modelViewProjectionMatrix" ) modelViewProjection = location;
+			else if( name == "normalMatrix" ) normalMatrix = location;
+			else return false;
+			return true;
+		}
+	};
+	StandardUniforms m_uniforms;
+
+	// Sources of the current program.
+	QByteArray m_programVertexText;
+	QByteArray m_programFragmentText;
+
+	// Program with the frozen parameters replaced by constants. The generic
+	// program is kept, so that unfreezing a parameter does not require a build.
+	bool m_specialized;
+	bool m_specializationDirty;
+	GLhandleARB m_specializedProgram;
+	QString m_specializationKey;
+	QVector<GLint> m_specializedLocations;
+	StandardUniforms m_specializedUniforms;
 
 	QVector<GLSLParameter*> m_parameterArray;
+	
+	// Named uniform block, backed by a buffer object.
+	struct UniformBlock
+	{
+		QString name;
+		GLuint binding;
+		GLuint buffer;
+		QByteArray data;
+		bool dirty;
+	};
+	QVector<UniformBlock> m_blockArray;
 
 	OutputParser* m_outputParser;
 
+	// Sources of the build in progress and the objects it produced. Specialized
+	// programs are built the same way, but only produce a program.
+	struct Build
+	{
+		bool specialization;
+		QString specializationKey;
+		QByteArray vertexShaderText;
+		QByteArray fragmentShaderText;
+		QByteArray vertexShaderHash;
+		QByteArray fragmentShaderHash;
+		GLhandleARB vertexShader;
+		GLhandleARB fragmentShader;
+		GLhandleARB program;
+		QByteArray vertexLog;
+		QByteArray fragmentLog;
+		QByteArray linkLog;
+		bool linked;
+	};
+	Build m_build;
+	bool m_building;
+	bool m_buildPending;
+
+	// Posted by the builder thread when the build is done.
+	class BuildEvent : public QEvent
+	{
+	public:
+		BuildEvent(bool succeed) : QEvent(QEvent::User), m_succeed(succeed)
+		{
+		}
+		bool succeed() const { return m_succeed; }
+	private:
+		bool m_succeed;
+	};
+
+	// Posted to build the specialized program outside of rendering, when builds do not run in the builder thread.
+	static const QEvent::Type SpecializeEvent = QEvent::Type(QEvent::User + 1);
+
 	// Builder thread.
 	class BuilderThread : public GLThread
 	{
@@ -325,7 +779,7 @@ private:
 			this->makeCurrent();
 			bool succeed = m_effect->threadedBuild();
 			this->doneCurrent();
-			emit m_effect->built(succeed);
+			QCoreApplication::postEvent(m_effect, new BuildEvent(succeed));
 		}
 	};
 	friend class BuilderThread;
@@ -340,8 +794,13 @@ public:
 		m_program(0),
 		m_vertexShaderText(s_vertexShaderText),
 		m_fragmentShaderText(s_fragmentShaderText),
-		m_timeUniform(-1),
+		m_fixedTime(-1.0f),
+		m_specialized(false),
+		m_specializationDirty(true),
+		m_specializedProgram(0),
 		m_outputParser(0),
+		m_building(false),
+		m_buildPending(false),
 		m_thread(widget, this)
 	{
 		this->makeCurrent();
@@ -358,8 +817,13 @@ public:
 	// Dtor.
 	virtual ~GLSLEffect()
 	{
+		m_thread.wait();
+		
 		this->makeCurrent();
 		
+		if( m_building ) {
+			discardBuild();
+		}
 		deleteProgram();
 		ReportGLErrors();
 		delete m_outputParser;
@@ -501,57 +965,70 @@ public:
 		}
 	}
 
+	// Compile and link the sources of m_build. May run in the builder thread,
+	// so it must not modify the current program.
 	bool threadedBuild()
 	{
-		GLhandleARB vertexShader;
-		GLhandleARB fragmentShader;
-		GLhandleARB program;
+		m_build.vertexShader = 0;
+		m_build.fragmentShader = 0;
+		m_build.program = 0;
+		m_build.vertexLog.clear();
+		m_build.fragmentLog.clear();
+		m_build.linkLog.clear();
+		m_build.linked = false;
 		
+		if( m_build.specialization ) {
+			m_build.program = buildSpecializedProgram(m_build.vertexShaderText, m_build.fragmentShaderText);
+			return m_build.program != 0;
+		}
 		
-		vertexShader = glCreateShaderObjectARB(GL_VERTEX_SHADER_ARB);
-		
-		emit infoMessage(tr("Compiling vertex shader..."));
-		const char * vertexStrings[] = { m_vertexShaderText.data() };
-		glShaderSourceARB(vertexShader, 1, vertexStrings, NULL);
-		glCompileShaderARB(vertexShader);
+		GLhandleARB program;
 		
-		// Get error log.
-		QByteArray infoLog;
-		GLint charsWritten, infoLogLength;
-		glGetObjectParameterivARB(vertexShader, GL_OBJECT_INFO_LOG_LENGTH_ARB, &infoLogLength);
-		infoLog.resize(infoLogLength);
-		glGetInfoLogARB(vertexShader, infoLogLength, &charsWritten, infoLog.data());
-		emit buildMessage(infoLog, 0, m_outputParser);
+		// Try to restore the linked program from the binary cache.
+		QByteArray cacheKey;
+		if( ProgramCache::isSupported() ) {
+			cacheKey = ProgramCache::key(QList<QByteArray>() << m_build.vertexShaderText << m_build.fragmentShaderText << attributeBindings());
+			
+			program = glCreateProgramObjectARB();
+			if( ProgramCache::load(cacheKey, (GLuint)(size_t)program) ) {
+				m_build.program = program;
+				m_build.vertexShaderHash.clear();
+				m_build.fragmentShaderHash.clear();
+				emit infoMessage(tr("Program loaded from cache."));
+				return true;
+			}
+			glDeleteObjectARB(program);
+		}
 		
-		fragmentShader = glCreateShaderObjectARB(GL_FRAGMENT_SHADER_ARB);
+		// Only recompile the stages whose source changed.
+		m_build.vertexShaderHash = QCryptographicHash::hash(m_build.vertexShaderText, QCryptographicHash::Md5);
+		m_build.fragmentShaderHash = QCryptographicHash::hash(m_build.fragmentShaderText, QCryptographicHash::Md5);
 		
-		emit infoMessage(tr("Compiling fragment shader..."));
-		const char * fragmentStrings[] = { m_fragmentShaderText.data() };
-		glShaderSourceARB(fragmentShader, 1, fragmentStrings, NULL);
-		glCompileShaderARB(fragmentShader);
+		GLhandleARB vertexShader = m_vertexShader;
+		if( vertexShader == 0 || m_build.vertexShaderHash != m_vertexShaderHash ) {
+			emit infoMessage(tr("Compiling vertex shader..."));
+			vertexShader = compileShader(GL_VERTEX_SHADER_ARB, m_build.vertexShaderText);
+		}
+		m_build.vertexLog = infoLog(vertexShader);
 		
-		// Get error log.
-		infoLog.clear();
-		glGetObjectParameterivARB(fragmentShader, GL_OBJECT_INFO_LOG_LENGTH_ARB, &infoLogLength);
-		infoLog.resize(infoLogLength);
-		glGetInfoLogARB(fragmentShader, infoLogLength, &charsWritten, infoLog.data());
-		emit buildMessage(infoLog, 1, m_outputParser);
+		GLhandleARB fragmentShader = m_fragmentShader;
+		if( fragmentShader == 0 || m_build.fragmentShaderHash != m_fragmentShaderHash ) {
+			emit infoMessage(tr("Compiling fragment shader..."));
+			fragmentShader = compileShader(GL_FRAGMENT_SHADER_ARB, m_build.fragmentShaderText);
+		}
+		m_build.fragmentLog = infoLog(fragmentShader);
 		
 		// Check compilation.
 		GLint vertexCompileSucceed = GL_FALSE;
 		glGetObjectParameterivARB(vertexShader, GL_OBJECT_COMPILE_STATUS_ARB, &vertexCompileSucceed);
-		if( vertexCompileSucceed == GL_FALSE )
-		{
-			glDeleteObjectARB(vertexShader);
-			return false;
-		}
 		
 		GLint fragmentCompileSucceed = GL_FALSE;
 		glGetObjectParameterivARB(fragmentShader, GL_OBJECT_COMPILE_STATUS_ARB, &fragmentCompileSucceed);
-		if( fragmentCompileSucceed == GL_FALSE )
+		
+		if( vertexCompileSucceed == GL_FALSE || fragmentCompileSucceed == GL_FALSE )
 		{
-			glDeleteObjectARB(vertexShader);
-			glDeleteObjectARB(fragmentShader);
+			releaseShader(vertexShader);
+			releaseShader(fragmentShader);
 			return false;
 		}
 		
@@ -561,14 +1038,18 @@ public:
 		emit infoMessage(tr("Linking..."));
 		glAttachObjectARB(program, vertexShader);
 		glAttachObjectARB(program, fragmentShader);
+		for(int i = 0; i < s_attributeCount; i++) {
+			glBindAttribLocationARB(program, s_attributes[i].index, s_attributes[i].name);
+		}
+#if defined(GL_ARB_get_program_binary)
+		if( !cacheKey.isEmpty() ) {
+			glProgramParameteri((GLuint)(size_t)program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+#endif
 		glLinkProgramARB(program);
 		
-		// Get error log.
-		infoLog.clear();
-		glGetObjectParameterivARB(program, GL_OBJECT_INFO_LOG_LENGTH_ARB, &infoLogLength);
-		infoLog.resize(infoLogLength);
-		glGetInfoLogARB(program, infoLogLength, &charsWritten, infoLog.data());
-		emit buildMessage(infoLog, -1, m_outputParser);
+		m_build.linkLog = infoLog(program);
+		m_build.linked = true;
 		
 		// Test linker result.
 		GLint linkSucceed = GL_FALSE;
@@ -577,47 +1058,42 @@ public:
 		{
 			glDetachObjectARB(program, vertexShader);
 			glDetachObjectARB(program, fragmentShader);
-			glDeleteObjectARB(vertexShader);
-			glDeleteObjectARB(fragmentShader);
 			glDeleteObjectARB(program);
+			releaseShader(vertexShader);
+			releaseShader(fragmentShader);
 			return false;
 		}
 		
-		// Delete previous effect.
-		deleteProgram();
-		
-		Q_ASSERT( m_vertexShader == 0 && vertexShader != 0 );
-		Q_ASSERT( m_fragmentShader == 0 && fragmentShader != 0 );
-		Q_ASSERT( m_program == 0 && program != 0 );
-		
-		m_vertexShader = vertexShader;
-		m_fragmentShader = fragmentShader;
-		m_program = program;
+		if( !cacheKey.isEmpty() ) {
+			ProgramCache::store(cacheKey, (GLuint)(size_t)program);
+		}
 		
-		initParameters();
+		m_build.vertexShader = vertexShader;
+		m_build.fragmentShader = fragmentShader;
+		m_build.program = program;
 		
 		return true;
 	}
 	
 	virtual void build(bool threaded)
 	{
-#if defined(Q_OS_LINUX)
-		threaded = false;
-#endif
-
-		if (threaded) {
-			m_thread.start();
-		}
-		else {
-			this->makeCurrent();
-			bool succeed = threadedBuild();
-			emit built(succeed);
+		if( m_building ) {
+			// Supersede the build in progress, the latest sources are built when it finishes.
+			m_buildPending = true;
+			return;
 		}
+		
+		startBuild(threaded);
 	}
 	
 	virtual bool isBuilding() const 
 	{
-		return m_thread.isRunning();
+		return m_building;
+	}
+	
+	virtual bool buildsInBackground() const
+	{
+		return true;
 	}
 
 	// Parameter info.
@@ -645,7 +1121,37 @@ public:
 
 	virtual bool isAnimated() const
 	{
-		return m_timeUniform != -1;
+		return m_uniforms.time != -1;
+	}
+	
+	virtual void setTime(float seconds)
+	{
+		m_fixedTime = seconds;
+	}
+	
+	virtual float time() const
+	{
+		return m_fixedTime >= 0.0f ? m_fixedTime : 0.001f * m_time.elapsed();
+	}
+	
+	virtual bool canSpecialize() const
+	{
+		return true;
+	}
+	
+	virtual bool isSpecialized() const
+	{
+		return m_specialized;
+	}
+	
+	virtual void setSpecialized(bool b)
+	{
+		m_specialized = b;
+		if( !b ) {
+			this->makeCurrent();
+			deleteSpecializedProgram();
+		}
+		m_specializationDirty = true;
 	}
 
 
@@ -676,11 +1182,15 @@ public:
 	{
 		Q_ASSERT(m_program != 0);
 
-		glEnable(GL_CULL_FACE);
-		glEnable(GL_DEPTH_TEST);
+		GLState::enable(GL_CULL_FACE);
+		GLState::enable(GL_DEPTH_TEST);
 		glDepthFunc(GL_LEQUAL);
 
-		glUseProgramObjectARB(m_program);
+		if( m_specialized ) {
+			updateSpecialization();
+		}
+
+		GLState::useProgram(currentProgram());
 
 		// Set uniforms.
 		setParameters();
@@ -694,7 +1204,7 @@ public:
 	virtual void beginMaterialGroup()
 	{
 		// needs to be called every time the material changes on ATI hardware
-		glUseProgramObjectARB(m_program);
+		GLState::useProgram(currentProgram());
 	}
 
 	virtual void endPass()
@@ -703,45 +1213,506 @@ public:
 
 	virtual void end()
 	{
-		glUseProgramObjectARB(0); // ???
+		GLState::useProgram(0); // ???
 	}
 
 private:
 
-	void deleteProgram()
+	static bool canBuildInBackground()
 	{
-		if( m_program != 0 ) {
-			if( m_vertexShader != 0 ) {
-				glDetachObjectARB(m_program, m_vertexShader);
-			}
-			if( m_fragmentShader != 0 ) {
-				glDetachObjectARB(m_program, m_fragmentShader);
-			}
-			glDeleteObjectARB(m_program);
-			m_program = 0;
+#if defined(Q_OS_LINUX)
+		// Sharing contexts between threads requires a thread safe Xlib.
+#if QT_VERSION >= 0x040800
+		return QCoreApplication::testAttribute(Qt::AA_X11InitThreads);
+#else
+		return false;
+#endif
+#else
+		return true;
+#endif
+	}
+	
+	void startBuild(bool threaded)
+	{
+		threaded = threaded && canBuildInBackground();
+		
+		m_building = true;
+		m_buildPending = false;
+		
+		// The builder thread posts its result before returning, so it may still be running.
+		// Starting a running QThread does nothing, and the build would never finish.
+		m_thread.wait();
+		
+		// Build a snapshot of the sources, the editors may change them meanwhile.
+		m_build.specialization = false;
+		m_build.vertexShaderText = m_vertexShaderText;
+		m_build.fragmentShaderText = m_fragmentShaderText;
+		
+		if (threaded) {
+			m_thread.start();
 		}
-		if( m_vertexShader != 0 ) {
-			glDeleteObjectARB(m_vertexShader);
-			m_vertexShader = 0;
+		else {
+			this->makeCurrent();
+			bool succeed = threadedBuild();
+			finishBuild(succeed);
 		}
-		if( m_fragmentShader != 0 ) {
-			glDeleteObjectARB(m_fragmentShader);
-			m_fragmentShader = 0;
+	}
+	
+	// Build the specialized program while the generic one keeps rendering.
+	void startSpecialization(const QByteArray & vertexText, const QByteArray & fragmentText)
+	{
+		m_building = true;
+		m_buildPending = false;
+		
+		// Same as startBuild(), the thread may still be returning from the last build.
+		m_thread.wait();
+		
+		m_build.specialization = true;
+		m_build.vertexShaderText = vertexText;
+		m_build.fragmentShaderText = fragmentText;
+		m_build.vertexShader = 0;
+		m_build.fragmentShader = 0;
+		m_build.program = 0;
+		
+		if( canBuildInBackground() ) {
+			m_thread.start();
+		}
+		else {
+			// Requested while rendering, build when control returns to the event loop.
+			QCoreApplication::postEvent(this, new QEvent(SpecializeEvent));
 		}
 	}
-
-	void initParameters()
+	
+	// Swap in the result of the build, unless newer sources arrived meanwhile.
+	void finishBuild(bool succeed)
 	{
-		m_timeUniform = -1;
+		this->makeCurrent();
 		
-		if( m_program == 0 ) {
+		m_building = false;
+		
+		if( m_buildPending ) {
+			if( succeed ) {
+				discardBuild();
+			}
+			startBuild(true);
 			return;
 		}
-
-		GLint count = 0;
-		glGetObjectParameterivARB(m_program, GL_OBJECT_ACTIVE_UNIFORMS_ARB, &count);
-
-		QVector<GLSLParameter*> newParameterArray;
+		
+		if( m_build.specialization ) {
+			finishSpecialization(succeed);
+			return;
+		}
+		
+		emit buildMessage(m_build.vertexLog, 0, m_outputParser);
+		emit buildMessage(m_build.fragmentLog, 1, m_outputParser);
+		if( m_build.linked ) {
+			emit buildMessage(m_build.linkLog, -1, m_outputParser);
+		}
+		
+		if( succeed ) {
+			// Delete previous effect, but keep the shader objects we reused.
+			deleteProgram(m_build.vertexShader, m_build.fragmentShader);
+			
+			Q_ASSERT( m_program == 0 && m_build.program != 0 );
+			
+			m_vertexShader = m_build.vertexShader;
+			m_fragmentShader = m_build.fragmentShader;
+			m_vertexShaderHash = m_build.vertexShaderHash;
+			m_fragmentShaderHash = m_build.fragmentShaderHash;
+			m_program = m_build.program;
+			m_programVertexText = m_build.vertexShaderText;
+			m_programFragmentText = m_build.fragmentShaderText;
+			
+			initParameters();
+		}
+		
+		emit built(succeed);
+	}
+	
+	// Delete the objects of a successful build that is not going to be used.
+	void discardBuild()
+	{
+		if( m_build.program != 0 ) {
+			if( m_build.vertexShader != 0 ) {
+				glDetachObjectARB(m_build.program, m_build.vertexShader);
+			}
+			if( m_build.fragmentShader != 0 ) {
+				glDetachObjectARB(m_build.program, m_build.fragmentShader);
+			}
+			glDeleteObjectARB(m_build.program);
+			m_build.program = 0;
+		}
+		if( m_build.vertexShader != 0 ) {
+			releaseShader(m_build.vertexShader);
+			m_build.vertexShader = 0;
+		}
+		if( m_build.fragmentShader != 0 ) {
+			releaseShader(m_build.fragmentShader);
+			m_build.fragmentShader = 0;
+		}
+	}
+	
+	virtual void customEvent(QEvent * event)
+	{
+		if( event->type() == QEvent::User ) {
+			finishBuild(static_cast<BuildEvent *>(event)->succeed());
+		}
+		else if( event->type() == SpecializeEvent ) {
+			this->makeCurrent();
+			bool succeed = threadedBuild();
+			finishBuild(succeed);
+		}
+	}
+	
+	// Delete the program and its shaders, except the ones that are going to be reused.
+	void deleteProgram(GLhandleARB keepVertexShader = 0, GLhandleARB keepFragmentShader = 0)
+	{
+		deleteSpecializedProgram();
+		deleteUniformBlocks();
+		
+		if( m_program != 0 ) {
+			if( m_vertexShader != 0 ) {
+				glDetachObjectARB(m_program, m_vertexShader);
+			}
+			if( m_fragmentShader != 0 ) {
+				glDetachObjectARB(m_program, m_fragmentShader);
+			}
+			GLState::deleteProgram(m_program);
+			m_program = 0;
+		}
+		if( m_vertexShader != 0 ) {
+			if( m_vertexShader != keepVertexShader ) {
+				glDeleteObjectARB(m_vertexShader);
+			}
+			m_vertexShader = 0;
+			m_vertexShaderHash.clear();
+		}
+		if( m_fragmentShader != 0 ) {
+			if( m_fragmentShader != keepFragmentShader ) {
+				glDeleteObjectARB(m_fragmentShader);
+			}
+			m_fragmentShader = 0;
+			m_fragmentShaderHash.clear();
+		}
+	}
+	
+	GLhandleARB currentProgram() const
+	{
+		return m_specializedProgram != 0 ? m_specializedProgram : m_program;
+	}
+	
+	void deleteSpecializedProgram()
+	{
+		if( m_specializedProgram != 0 ) {
+			GLState::deleteProgram(m_specializedProgram);
+			m_specializedProgram = 0;
+			
+			// The uniforms of the generic program have to be set again.
+			foreach(GLSLParameter * p, m_parameterArray) {
+				p->setDirty(true);
+			}
+		}
+		m_specializationKey.clear();
+		m_specializedLocations.clear();
+		m_specializedUniforms.clear();
+		m_specializationDirty = true;
+	}
+	
+	bool frozenValuesChanged() const
+	{
+		foreach(const GLSLParameter * p, m_parameterArray) {
+			if( p->specializationChanged() ) {
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	// Start a build of the specialized program when the set of frozen parameters or their values change.
+	void updateSpecialization()
+	{
+		// Wait for the build in progress, the next frame checks again.
+		if( m_building || (!m_specializationDirty && !frozenValuesChanged()) ) {
+			return;
+		}
+		
+		QMap<QString, QString> constants;
+		QString key;
+		foreach(GLSLParameter * p, m_parameterArray) {
+			if( p->isConstant() ) {
+				const QString literal = p->literal();
+				constants.insert(p->name(), literal);
+				key += p->name() + "=" + literal + ";";
+			}
+			p->setSpecialized();
+		}
+		
+		if( key == m_specializationKey ) {
+			m_specializationDirty = false;
+			return;
+		}
+		
+		// Render with the generic program until the new one is built.
+		deleteSpecializedProgram();
+		
+		if( constants.isEmpty() || m_program == 0 ) {
+			m_specializationKey = key;
+			m_specializationDirty = false;
+			return;
+		}
+		
+		// Frozen parameters that were not replaced would silently keep their uniform value.
+		QSet<QString> replaced;
+		const QByteArray vertexText = specializeSource(m_programVertexText, constants, &replaced);
+		const QByteArray fragmentText = specializeSource(m_programFragmentText, constants, &replaced);
+		if( replaced.count() != constants.count() ) {
+			const QStringList missing = (constants.keys().toSet() - replaced).toList();
+			emit errorMessage(tr("Could not specialize %1, rendering with the generic program.").arg(missing.join(", ")));
+			m_specializationKey = key;
+			m_specializationDirty = false;
+			return;
+		}
+		
+		m_build.specializationKey = key;
+		startSpecialization(vertexText, fragmentText);
+	}
+	
+	// Swap in the specialized program, unless the frozen parameters changed meanwhile.
+	void finishSpecialization(bool succeed)
+	{
+		if( !m_specialized || frozenValuesChanged() ) {
+			if( succeed ) {
+				discardBuild();
+			}
+			emit specialized(false);
+			return;
+		}
+		
+		// Failed specializations are not retried until the frozen parameters change.
+		m_specializationKey = m_build.specializationKey;
+		m_specializationDirty = false;
+		
+		if( !succeed ) {
+			emit errorMessage(tr("Specialization failed, rendering with the generic program."));
+			emit specialized(false);
+			return;
+		}
+		
+		const GLhandleARB program = m_build.program;
+		m_build.program = 0;
+		
+		const GLuint programId = (GLuint)(size_t)program;
+		
+		// Use the buffers of the generic program for the uniform blocks.
+		foreach(const UniformBlock & block, m_blockArray) {
+			if( block.buffer == 0 ) {
+				continue;
+			}
+			const GLuint index = glGetUniformBlockIndex(programId, block.name.toLatin1().constData());
+			if( index != GL_INVALID_INDEX ) {
+				glUniformBlockBinding(programId, index, block.binding);
+			}
+		}
+		
+		GLint count = 0;
+		glGetObjectParameterivARB(program, GL_OBJECT_ACTIVE_UNIFORMS_ARB, &count);
+		for(int i = 0; i < count; i++) {
+			char str[1024];
+			GLsizei length;
+			GLint size;
+			GLenum type;
+			glGetActiveUniformARB(program, i, 1024, &length, &size, &type, str);
+			m_specializedUniforms.set(str, glGetUniformLocationARB(program, str));
+		}
+		
+		int constantCount = 0;
+		m_specializedLocations.resize(m_parameterArray.count());
+		for(int i = 0; i < m_parameterArray.count(); i++) {
+			const GLSLParameter * p = m_parameterArray.at(i);
+			if( p->isConstant() ) {
+				constantCount++;
+			}
+			if( p->isConstant() || p->blockIndex() != -1 ) {
+				m_specializedLocations[i] = -1;
+			}
+			else {
+				m_specializedLocations[i] = glGetUniformLocationARB(program, p->name().toLatin1().constData());
+			}
+		}
+		
+		m_specializedProgram = program;
+		
+		foreach(GLSLParameter * p, m_parameterArray) {
+			p->setDirty(true);
+		}
+		
+		emit infoMessage(tr("Specialized program built with %1 constant parameters.").arg(constantCount));
+		emit specialized(true);
+	}
+	
+	// Compile and link the specialized sources. Returns 0 and reports the logs on failure.
+	GLhandleARB buildSpecializedProgram(const QByteArray & vertexText, const QByteArray & fragmentText)
+	{
+		GLhandleARB program = glCreateProgramObjectARB();
+		
+		QByteArray cacheKey;
+		if( ProgramCache::isSupported() ) {
+			cacheKey = ProgramCache::key(QList<QByteArray>() << vertexText << fragmentText << attributeBindings());
+			if( ProgramCache::load(cacheKey, (GLuint)(size_t)program) ) {
+				return program;
+			}
+		}
+		
+		GLhandleARB vertexShader = compileShader(GL_VERTEX_SHADER_ARB, vertexText);
+		GLhandleARB fragmentShader = compileShader(GL_FRAGMENT_SHADER_ARB, fragmentText);
+		
+		GLint vertexCompileSucceed = GL_FALSE;
+		glGetObjectParameterivARB(vertexShader, GL_OBJECT_COMPILE_STATUS_ARB, &vertexCompileSucceed);
+		
+		GLint fragmentCompileSucceed = GL_FALSE;
+		glGetObjectParameterivARB(fragmentShader, GL_OBJECT_COMPILE_STATUS_ARB, &fragmentCompileSucceed);
+		
+		GLint linkSucceed = GL_FALSE;
+		if( vertexCompileSucceed != GL_FALSE && fragmentCompileSucceed != GL_FALSE ) {
+			glAttachObjectARB(program, vertexShader);
+			glAttachObjectARB(program, fragmentShader);
+			for(int i = 0; i < s_attributeCount; i++) {
+				glBindAttribLocationARB(program, s_attributes[i].index, s_attributes[i].name);
+			}
+#if defined(GL_ARB_get_program_binary)
+			if( !cacheKey.isEmpty() ) {
+				glProgramParameteri((GLuint)(size_t)program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			}
+#endif
+			glLinkProgramARB(program);
+			glGetObjectParameterivARB(program, GL_OBJECT_LINK_STATUS_ARB, &linkSucceed);
+			
+			if( linkSucceed == GL_FALSE ) {
+				emit buildMessage(infoLog(program), -1, m_outputParser);
+			}
+			
+			glDetachObjectARB(program, vertexShader);
+			glDetachObjectARB(program, fragmentShader);
+		}
+		else {
+			// The declarations keep their lines, so the errors point to the right place.
+			emit buildMessage(infoLog(vertexShader), 0, m_outputParser);
+			emit buildMessage(infoLog(fragmentShader), 1, m_outputParser);
+		}
+		
+		glDeleteObjectARB(vertexShader);
+		glDeleteObjectARB(fragmentShader);
+		
+		if( linkSucceed == GL_FALSE ) {
+			glDeleteObjectARB(program);
+			return 0;
+		}
+		
+		if( !cacheKey.isEmpty() ) {
+			ProgramCache::store(cacheKey, (GLuint)(size_t)program);
+		}
+		
+		return program;
+	}
+	
+	GLhandleARB compileShader(GLenum type, const QByteArray & text)
+	{
+		GLhandleARB shader = glCreateShaderObjectARB(type);
+		const char * strings[] = { text.data() };
+		glShaderSourceARB(shader, 1, strings, NULL);
+		glCompileShaderARB(shader);
+		return shader;
+	}
+	
+	// Delete a shader object, unless it belongs to the current program.
+	void releaseShader(GLhandleARB shader)
+	{
+		if( shader != m_vertexShader && shader != m_fragmentShader ) {
+			glDeleteObjectARB(shader);
+		}
+	}
+	
+	QByteArray infoLog(GLhandleARB object)
+	{
+		QByteArray log;
+		GLint charsWritten, infoLogLength = 0;
+		glGetObjectParameterivARB(object, GL_OBJECT_INFO_LOG_LENGTH_ARB, &infoLogLength);
+		log.resize(infoLogLength);
+		glGetInfoLogARB(object, infoLogLength, &charsWritten, log.data());
+		return log;
+	}
+
+	void deleteUniformBlocks()
+	{
+		foreach(const UniformBlock & block, m_blockArray) {
+			if( block.buffer != 0 ) {
+				glDeleteBuffers(1, &block.buffer);
+			}
+		}
+		m_blockArray.clear();
+	}
+	
+	void initUniformBlocks()
+	{
+		deleteUniformBlocks();
+		
+		if( !GLEW_ARB_uniform_buffer_object ) {
+			return;
+		}
+		
+		const GLuint program = (GLuint)(size_t)m_program;
+		
+		GLint blockCount = 0;
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+		
+		GLint maxBindings = 0;
+		glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &maxBindings);
+		
+		for(int i = 0; i < blockCount; i++) {
+			char str[1024];
+			GLsizei length;
+			glGetActiveUniformBlockName(program, i, 1024, &length, str);
+			
+			GLint size = 0;
+			glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+			
+			UniformBlock block;
+			block.name = str;
+			block.binding = i;
+			block.buffer = 0;
+			block.data.fill(0, size);
+			block.dirty = true;
+			
+			if( i < maxBindings ) {
+				glGenBuffers(1, &block.buffer);
+				glBindBuffer(GL_UNIFORM_BUFFER, block.buffer);
+				glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+				glUniformBlockBinding(program, i, block.binding);
+			}
+			else {
+				emit errorMessage(tr("Uniform buffer binding limit hit, ignoring block '%1'").arg(block.name));
+			}
+			
+			m_blockArray.append(block);
+		}
+		
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	void initParameters()
+	{
+		m_uniforms.clear();
+		
+		if( m_program == 0 ) {
+			return;
+		}
+		
+		initUniformBlocks();
+
+		GLint count = 0;
+		glGetObjectParameterivARB(m_program, GL_OBJECT_ACTIVE_UNIFORMS_ARB, &count);
+
+		QVector<GLSLParameter*> newParameterArray;
 
 		for(int i = 0; i < count; i++) {
 			char str[1024];
@@ -756,31 +1727,65 @@ private:
 			if( name.startsWith("gl_") ) {
 				continue;
 			}
+			
+			// Get the block layout of uniforms in named blocks.
+			GLint blockIndex = -1;
+			GLint offset = 0, arrayStride = 0, matrixStride = 0, rowMajor = 0;
+			if( !m_blockArray.isEmpty() ) {
+				const GLuint program = (GLuint)(size_t)m_program;
+				const GLuint index = i;
+				glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+				if( blockIndex != -1 ) {
+					glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &offset);
+					glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &arrayStride);
+					glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &matrixStride);
+					glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_IS_ROW_MAJOR, &rowMajor);
+				}
+			}
+
+			int location = (blockIndex == -1) ? glGetUniformLocationARB(m_program, str) : -1;
 
 			// Get standard uniforms.
-			if( name.toLower() == "time" ) {
-				m_timeUniform = glGetUniformLocationARB(m_program, str);
+			if( blockIndex == -1 && m_uniforms.set(name, location) ) {
 				continue;
 			}
-
-			int location = glGetUniformLocationARB(m_program, str);
 			
 			// Add parameter
 			if( size == 1 ) {
 				GLSLParameter * param = new GLSLParameter(name, type, location);
+				if( blockIndex != -1 ) {
+					param->setBlockLayout(blockIndex, m_blockArray.at(blockIndex).name, offset, matrixStride, rowMajor != 0);
+				}
 				param->setValue(getParameterValue(param));
 				newParameterArray.push_back(param);
 			}
 			else {
 				// parameter array.
 				for(int i = 0; i < size; i++) {
-					GLSLParameter * param = new GLSLParameter(name + "[" + QString::number(i) + "]", type, location+i);
+					GLSLParameter * param;
+					if( blockIndex != -1 ) {
+						param = new GLSLParameter(name + "[" + QString::number(i) + "]", type, -1);
+						param->setBlockLayout(blockIndex, m_blockArray.at(blockIndex).name, offset + i * arrayStride, matrixStride, rowMajor != 0);
+					}
+					else {
+						param = new GLSLParameter(name + "[" + QString::number(i) + "]", type, location+i);
+					}
 					param->setValue(getParameterValue(param));
 					newParameterArray.push_back(param);
 				}
 			}
 		}
 
+		// Keep the parameters frozen across builds.
+		foreach(GLSLParameter * param, newParameterArray) {
+			foreach(const GLSLParameter * p, m_parameterArray) {
+				if( p->name() == param->name() ) {
+					param->setFrozen(p->isFrozen());
+					break;
+				}
+			}
+		}
+
 		qDeleteAll(m_parameterArray);
 		m_parameterArray = newParameterArray;
 
@@ -809,158 +1814,62 @@ private:
 
 	void setParameters()
 	{
-		// Set user parameters
-		foreach(GLSLParameter * p, m_parameterArray) {
-			setParameter(p);
-		}
-
-		// Set standard parameters.
-		if( m_timeUniform != -1 ) {
-			glUniform1fARB(m_timeUniform, 0.001f * m_time.elapsed());
-		}
-	}
-
-	void setParameter(const GLSLParameter * param)
-	{
-		switch( param->glType() ) {
-			case GL_FLOAT:
-				glUniform1fARB(param->location(), float(param->value().toDouble()));
-				break;
-			case GL_FLOAT_VEC2_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 2);
-				glUniform2fARB(param->location(), list.at(0).toDouble(), list.at(1).toDouble());
-				break;
-			}
-			case GL_FLOAT_VEC3_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 3);	
-				glUniform3fARB(param->location(), list.at(0).toDouble(), list.at(1).toDouble(), list.at(2).toDouble());
-				break;
-			}
-			case GL_FLOAT_VEC4_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 4);
-				glUniform4fARB(param->location(), list.at(0).toDouble(), list.at(1).toDouble(), list.at(2).toDouble(), list.at(3).toDouble());
-				break;
-			}
-			case GL_INT:
-				glUniform1iARB(param->location(), param->value().toInt());
-				break;
-			case GL_INT_VEC2_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 2);
-				glUniform2iARB(param->location(), list.at(0).toInt(), list.at(1).toInt());
-				break;
-			}
-			case GL_INT_VEC3_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 3);
-				glUniform3iARB(param->location(), list.at(0).toInt(), list.at(1).toInt(), list.at(2).toInt());
-				break;
-			}
-			case GL_INT_VEC4_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 4);
-				glUniform4iARB(param->location(), list.at(0).toInt(), list.at(1).toInt(), list.at(2).toInt(), list.at(3).toInt());
-				break;
-			}
-			case GL_BOOL_ARB:
-				glUniform1iARB(param->location(), param->value().toBool());
-				break;
-			case GL_BOOL_VEC2_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 2);
-				glUniform2iARB(param->location(), list.at(0).toBool(), list.at(1).toBool());
-				break;
-			}
-			case GL_BOOL_VEC3_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 3);
-				glUniform3iARB(param->location(), list.at(0).toBool(), list.at(1).toBool(), list.at(2).toBool());
-				break;
-			}
-			case GL_BOOL_VEC4_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 4);
-				glUniform4iARB(param->location(), list.at(0).toBool(), list.at(1).toBool(), list.at(2).toBool(), list.at(3).toBool());
-				break;
-			}
-			case GL_FLOAT_MAT2_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 4);
-				
-				float values[4];
-				for(int i = 0; i < 2*2; i++) {
-					values[i] = (float)list.at(0).toDouble();
+		const bool specialized = m_specializedProgram != 0;
+		
+		// Set user parameters. Only upload the values that changed.
+		for(int i = 0; i < m_parameterArray.count(); i++) {
+			GLSLParameter * p = m_parameterArray.at(i);
+			if( p->blockIndex() != -1 ) {
+				if( p->isDirty() ) {
+					UniformBlock & block = m_blockArray[p->blockIndex()];
+					p->pack(block.data.data());
+					p->setDirty(false);
+					block.dirty = true;
 				}
-				
-				glUniformMatrix2fv(param->location(), 1, false, values);
-				break;
+				continue;
 			}
-			case GL_FLOAT_MAT3_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 9);
-				
-				float values[9];
-				for(int i = 0; i < 3*3; i++) {
-					values[i] = (float)list.at(0).toDouble();
-				}
-				
-				glUniformMatrix3fv(param->location(), 1, false, values);
-				break;
+			
+			p->upload(specialized ? m_specializedLocations.at(i) : p->location());
+			
+			if( p->isTexture() ) {
+				GLTexture tex = p->value().value<GLTexture>();
+				GLState::bindTexture(p->textureUnit(), tex.target(), tex.object());
 			}
-			case GL_FLOAT_MAT4_ARB:
-			{
-				Q_ASSERT(param->value().canConvert(QVariant::List));
-				QVariantList list = param->value().toList();
-				Q_ASSERT(list.count() == 16);
-				
-				float values[16];
-				for(int i = 0; i < 4*4; i++) {
-					values[i] = (float)list.at(0).toDouble();
-				}
-				
-				glUniformMatrix4fv(param->location(), 1, false, values);
-				break;
+		}
+
+		// Upload modified uniform blocks with a single call per block.
+		for(int i = 0; i < m_blockArray.count(); i++) {
+			UniformBlock & block = m_blockArray[i];
+			if( block.buffer == 0 ) {
+				continue;
 			}
-			case GL_SAMPLER_1D_ARB:
-			case GL_SAMPLER_2D_ARB:
-			case GL_SAMPLER_3D_ARB:
-			case GL_SAMPLER_CUBE_ARB:
-			case GL_SAMPLER_2D_RECT_ARB: {
-				GLTexture tex = param->value().value<GLTexture>();
-				glUniform1iARB(param->location(), param->textureUnit());
-				glActiveTextureARB(GL_TEXTURE0_ARB + param->textureUnit());
-				glBindTexture(tex.target(), tex.object());
-				break;
+			
+			glBindBufferBase(GL_UNIFORM_BUFFER, block.binding, block.buffer);
+			if( block.dirty ) {
+				glBufferSubData(GL_UNIFORM_BUFFER, 0, block.data.size(), block.data.constData());
+				block.dirty = false;
 			}
-			case GL_SAMPLER_1D_SHADOW_ARB:
-			case GL_SAMPLER_2D_SHADOW_ARB:
-			case GL_SAMPLER_2D_RECT_SHADOW_ARB:
-				break;
+		}
+
+		// Set standard parameters.
+		const StandardUniforms & uniforms = specialized ? m_specializedUniforms : m_uniforms;
+		if( uniforms.time != -1 ) {
+			glUniform1fARB(uniforms.time, m_fixedTime >= 0.0f ? m_fixedTime : 0.001f * m_time.elapsed());
+		}
+		if( uniforms.modelView != -1 ) {
+			glUniformMatrix4fvARB(uniforms.modelView, 1, GL_FALSE, Transform::modelView().data());
+		}
+		if( uniforms.projection != -1 ) {
+			glUniformMatrix4fvARB(uniforms.projection, 1, GL_FALSE, Transform::projection().data());
+		}
+		if( uniforms.modelViewProjection != -1 ) {
+			const Matrix4 modelViewProjection = Transform::projection() * Transform::modelView();
+			glUniformMatrix4fvARB(uniforms.modelViewProjection, 1, GL_FALSE, modelViewProjection.data());
+		}
+		if( uniforms.normalMatrix != -1 ) {
+			GLfloat normalMatrix[9];
+			Transform::modelView().normalMatrix(normalMatrix);
+			glUniformMatrix3fvARB(uniforms.normalMatrix, 1, GL_FALSE, normalMatrix);
 		}
 	}
 
@@ -973,6 +1882,11 @@ private:
 			}
 		}					
 		
+		// Uniforms in named blocks have no location, start with zeros.
+		if( param->blockIndex() != -1 ) {
+			return getZeroValue(param);
+		}
+		
 		// Get default value of the corresponding type.
 		switch( param->glType() ) {
 			case GL_FLOAT:
@@ -1110,6 +2024,34 @@ private:
 		return QVariant();
 	}
 
+	static QVariant getZeroValue(const GLSLParameter * param)
+	{
+		QVariant zero;
+		switch( param->baseType() ) {
+			case GL_FLOAT:
+				zero = 0.0;
+				break;
+			case GL_INT:
+				zero = 0;
+				break;
+			case GL_BOOL_ARB:
+				zero = false;
+				break;
+			default:
+				return QVariant();
+		}
+		
+		if( param->rows() == 0 ) {
+			return zero;
+		}
+		
+		QVariantList list;
+		for(int i = 0; i < param->valueCount(); i++) {
+			list.append(zero);
+		}
+		return list;
+	}
+
 	static QString getParameterAssignment(const GLSLParameter * param, const QDir & dir)
 	{
 		QString typeName = getTypeName(param->glType());
@@ -1163,7 +2105,7 @@ private:
 			return;
 		}
 
-		static QRegExp paramRegExp("^\\s*(\\w+)\\s+(\\w+)\\s*=(.*);\\s*$");
+		static QRegExp paramRegExp("^\\s*(\\w+)\\s+([\\w\\.\\[\\]]+)\\s*=(.*);\\s*$");
 
 		if( !paramRegExp.exactMatch(line) ) {
 			// @@ Display warning.
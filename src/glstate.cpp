@@ -0,0 +1,212 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "glstate.h"
+
+#include <QtCore/QHash>
+#include <QtOpenGL/QGLContext>
+
+
+namespace
+{
+	struct State
+	{
+		State() : programKnown(false), program(0), activeTexture(-1), polygonMode(0) {}
+		
+		bool programKnown;
+		GLhandleARB program;
+		
+		// -1 when unknown.
+		int activeTexture;
+		
+		// Texture bound to each unit and target, missing entries are unknown.
+		QHash<quint32, GLuint> textures;
+		
+		QHash<GLenum, bool> enables;
+		
+		// 0 when unknown.
+		GLenum polygonMode;
+	};
+	
+	static State s_state;
+	static const QGLContext * s_context = NULL;
+	static int s_savedCalls = 0;
+	
+	static State & state()
+	{
+		const QGLContext * context = QGLContext::currentContext();
+		if( context != s_context ) {
+			// The state belongs to each context.
+			s_state = State();
+			s_context = context;
+		}
+		return s_state;
+	}
+	
+	static quint32 textureKey(int unit, GLenum target)
+	{
+		return (quint32(unit) << 16) | (target & 0xFFFF);
+	}
+	
+	static bool hasMultiTexture()
+	{
+		return GLEW_ARB_multitexture || GLEW_VERSION_1_3;
+	}
+	
+	static void setEnabled(GLenum cap, bool enabled)
+	{
+		State & s = state();
+		
+		QHash<GLenum, bool>::const_iterator it = s.enables.constFind(cap);
+		if( it != s.enables.constEnd() && it.value() == enabled ) {
+			s_savedCalls++;
+			return;
+		}
+		
+		if( enabled ) {
+			glEnable(cap);
+		}
+		else {
+			glDisable(cap);
+		}
+		s.enables.insert(cap, enabled);
+	}
+	
+} // namespace
+
+
+void GLState::useProgram(GLhandleARB program)
+{
+	State & s = state();
+	if( s.programKnown && s.program == program ) {
+		s_savedCalls++;
+		return;
+	}
+	
+	glUseProgramObjectARB(program);
+	s.program = program;
+	s.programKnown = true;
+}
+
+void GLState::deleteProgram(GLhandleARB program)
+{
+	// The handle may be reused by the next program.
+	State & s = state();
+	if( s.program == program ) {
+		s.programKnown = false;
+	}
+	
+	glDeleteObjectARB(program);
+}
+
+void GLState::activeTexture(int unit)
+{
+	State & s = state();
+	if( s.activeTexture == unit ) {
+		s_savedCalls++;
+		return;
+	}
+	
+	if( hasMultiTexture() ) {
+		glActiveTextureARB(GL_TEXTURE0_ARB + unit);
+	}
+	s.activeTexture = unit;
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture)
+{
+	State & s = state();
+	if( s.activeTexture == -1 ) {
+		// The unit is unknown, so are the bindings it changes.
+		glBindTexture(target, texture);
+		s.textures.clear();
+		return;
+	}
+	
+	bindTexture(s.activeTexture, target, texture);
+}
+
+void GLState::bindTexture(int unit, GLenum target, GLuint texture)
+{
+	State & s = state();
+	const quint32 key = textureKey(unit, target);
+	
+	QHash<quint32, GLuint>::const_iterator it = s.textures.constFind(key);
+	if( it != s.textures.constEnd() && it.value() == texture ) {
+		s_savedCalls++;
+		return;
+	}
+	
+	activeTexture(unit);
+	glBindTexture(target, texture);
+	s.textures.insert(key, texture);
+}
+
+void GLState::deleteTexture(GLuint texture)
+{
+	// Deleting a texture binds 0 to the units that used it.
+	State & s = state();
+	QMutableHashIterator<quint32, GLuint> it(s.textures);
+	while( it.hasNext() ) {
+		if( it.next().value() == texture ) {
+			it.setValue(0);
+		}
+	}
+	
+	glDeleteTextures(1, &texture);
+}
+
+void GLState::enable(GLenum cap)
+{
+	setEnabled(cap, true);
+}
+
+void GLState::disable(GLenum cap)
+{
+	setEnabled(cap, false);
+}
+
+void GLState::polygonMode(GLenum mode)
+{
+	State & s = state();
+	if( s.polygonMode == mode ) {
+		s_savedCalls++;
+		return;
+	}
+	
+	glPolygonMode(GL_FRONT_AND_BACK, mode);
+	s.polygonMode = mode;
+}
+
+void GLState::invalidate()
+{
+	s_state = State();
+	s_context = QGLContext::currentContext();
+}
+
+int GLState::savedCalls()
+{
+	return s_savedCalls;
+}
+
+void GLState::resetSavedCalls()
+{
+	s_savedCalls = 0;
+}
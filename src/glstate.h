@@ -0,0 +1,55 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <GL/glew.h>
+
+
+// Shadow of the GL state that changes on every frame. Calls that would
+// not change the state are dropped. Only used from the GUI thread; the
+// shadow is reset when a different context becomes current.
+namespace GLState
+{
+	void useProgram(GLhandleARB program);
+	void deleteProgram(GLhandleARB program);
+	
+	void activeTexture(int unit);
+	void bindTexture(GLenum target, GLuint texture);
+	void bindTexture(int unit, GLenum target, GLuint texture);
+	void deleteTexture(GLuint texture);
+	
+	void enable(GLenum cap);
+	void disable(GLenum cap);
+	
+	// Mode of front and back faces.
+	void polygonMode(GLenum mode);
+	
+	// Forget the shadow after code that changes the state directly.
+	void invalidate();
+	
+	// Number of redundant calls dropped.
+	int savedCalls();
+	void resetSavedCalls();
+};
+
+
+#endif // GLSTATE_H
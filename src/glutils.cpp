@@ -22,6 +22,12 @@
 
 #include "glutils.h"
 
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
 //#include <QtGui/QX11Info>
 
 //extern "C"
@@ -82,6 +88,21 @@ public:
 };
 */
 
+qint64 microseconds()
+{
+#if defined(Q_OS_WIN)
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return qint64(counter.QuadPart * 1000000.0 / frequency.QuadPart);
+#else
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return qint64(tv.tv_sec) * 1000000 + tv.tv_usec;
+#endif
+}
+
+
 void GLThread::makeCurrent()
 {
 	//XLock lock;
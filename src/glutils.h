@@ -33,6 +33,9 @@
 /// Report OpenGL errors.
 void ReportGLErrors();
 
+/// Wall clock time in microseconds, for profiling.
+qint64 microseconds();
+
 
 class GLWidget : public QGLWidget
 {
@@ -75,18 +78,6 @@ public:
 inline float toDegrees(float radians) { return radians * (180.0f / M_PI); }
 inline float toRadians(float degrees) { return degrees * (M_PI / 180.0f); }
 
-inline void perspective(float fov, float aspect, float zNear, float zFar)
-{
-	if (aspect < 1) {
-		// fov applies to the smaller dimension.
-		float real_fov = toDegrees(2 * atan(tan(toRadians(fov/2))/aspect));
-		gluPerspective(real_fov, aspect, zNear, zFar);
-	}
-	else {
-		gluPerspective(fov, aspect, zNear, zFar);
-	}
-}
-
 
 
 
@@ -0,0 +1,250 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "imageplugin.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QVector>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+namespace
+{
+	// Buffered reader for the run length encoded scanlines.
+	class ScanlineReader
+	{
+	public:
+		ScanlineReader(QFile & file) : m_file(file), m_buffer(64 * 1024, 0), m_pos(0), m_end(0)
+		{
+		}
+		
+		// Returns -1 at the end of the file.
+		inline int getByte()
+		{
+			if (m_pos == m_end && !fill()) {
+				return -1;
+			}
+			return uchar(m_buffer.at(m_pos++));
+		}
+		
+		bool read(uchar * dst, int count)
+		{
+			for (int i = 0; i < count; i++) {
+				const int c = getByte();
+				if (c < 0) {
+					return false;
+				}
+				dst[i] = uchar(c);
+			}
+			return true;
+		}
+		
+	private:
+		bool fill()
+		{
+			m_end = m_file.read(m_buffer.data(), m_buffer.size());
+			m_pos = 0;
+			return m_end > 0;
+		}
+		
+		QFile & m_file;
+		QByteArray m_buffer;
+		qint64 m_pos;
+		qint64 m_end;
+	};
+	
+	// Read one scanline of RGBE pixels, in any of the Radiance encodings.
+	static bool readScanline(ScanlineReader & reader, uchar * rgbe, int width)
+	{
+		if (!reader.read(rgbe, 4)) {
+			return false;
+		}
+		
+		// New run length encoding, each component is stored separately.
+		if (width >= 8 && width < 0x8000 && rgbe[0] == 2 && rgbe[1] == 2 && !(rgbe[2] & 0x80)) {
+			if (((rgbe[2] << 8) | rgbe[3]) != width) {
+				return false;
+			}
+			
+			for (int c = 0; c < 4; c++) {
+				int x = 0;
+				while (x < width) {
+					int count = reader.getByte();
+					if (count <= 0) {
+						return false;
+					}
+					if (count > 128) {
+						count -= 128;
+						const int value = reader.getByte();
+						if (value < 0 || x + count > width) {
+							return false;
+						}
+						for (int i = 0; i < count; i++) {
+							rgbe[4 * (x + i) + c] = uchar(value);
+						}
+					}
+					else {
+						if (x + count > width) {
+							return false;
+						}
+						for (int i = 0; i < count; i++) {
+							const int value = reader.getByte();
+							if (value < 0) {
+								return false;
+							}
+							rgbe[4 * (x + i) + c] = uchar(value);
+						}
+					}
+					x += count;
+				}
+			}
+			return true;
+		}
+		
+		// Flat pixels, with the old runs that repeat the previous pixel.
+		int x = 1;
+		int shift = 0;
+		while (x < width) {
+			uchar * pixel = rgbe + 4 * x;
+			if (!reader.read(pixel, 4)) {
+				return false;
+			}
+			if (pixel[0] == 1 && pixel[1] == 1 && pixel[2] == 1) {
+				// Consecutive runs extend the count by a byte, three bytes are enough for any scanline.
+				const qint64 count = qint64(pixel[3]) << shift;
+				if (count <= 0 || x + count > width) {
+					return false;
+				}
+				for (int i = 0; i < count; i++) {
+					memcpy(rgbe + 4 * (x + i), rgbe + 4 * (x - 1), 4);
+				}
+				x += int(count);
+				shift = qMin(shift + 8, 16);
+			}
+			else {
+				x++;
+				shift = 0;
+			}
+		}
+		return true;
+	}
+	
+} // namespace
+
+
+// Plugin for Radiance RGBE images. Decodes to float RGB, so the texture keeps the whole range.
+class RadianceImagePlugin : public ImagePlugin
+{
+	virtual int priority() const
+	{
+		return 2;
+	}
+	
+	virtual QList<QByteArray> supportedFormats() const
+	{
+		return QList<QByteArray>() << "hdr";
+	}
+	
+	virtual bool canLoad(const QString & fileName) const
+	{
+		QFile file(fileName);
+		if (!file.open(QIODevice::ReadOnly)) {
+			return false;
+		}
+		const QByteArray magic = file.readLine(16).trimmed();
+		return magic == "#?RADIANCE" || magic == "#?RGBE";
+	}
+	
+	virtual ImageData decode(const QString & fileName) const
+	{
+		QFile file(fileName);
+		if (!file.open(QIODevice::ReadOnly)) {
+			return ImageData();
+		}
+		
+		// The header ends with an empty line.
+		const QByteArray magic = file.readLine(16).trimmed();
+		if (magic != "#?RADIANCE" && magic != "#?RGBE") {
+			return ImageData();
+		}
+		
+		forever {
+			const QByteArray line = file.readLine(1024).trimmed();
+			if (line.isEmpty()) {
+				break;
+			}
+			if (line.startsWith("FORMAT=") && line != "FORMAT=32-bit_rle_rgbe") {
+				return ImageData();
+			}
+			if (file.atEnd()) {
+				return ImageData();
+			}
+		}
+		
+		// Only the standard orientations, with the rows along X.
+		const QList<QByteArray> resolution = file.readLine(64).simplified().split(' ');
+		if (resolution.count() != 4 || (resolution[0] != "-Y" && resolution[0] != "+Y") || resolution[2] != "+X") {
+			return ImageData();
+		}
+		const bool bottomUp = (resolution[0] == "+Y");
+		const int h = resolution[1].toInt();
+		const int w = resolution[3].toInt();
+		if (w <= 0 || h <= 0 || qint64(w) * h > 0x4000000) {
+			return ImageData();
+		}
+		
+		ImageData data;
+		data.width = w;
+		data.height = h;
+		data.format = GL_RGB;
+		data.type = GL_FLOAT;
+		data.alignment = 4;
+		data.buffer = QSharedPointer<uchar>((uchar *)malloc(data.bytesPerLine() * h), free);
+		if (data.buffer.isNull()) {
+			return ImageData();
+		}
+		data.pixels = data.buffer.data();
+		
+		// Rows are stored top down, like the other plugins.
+		ScanlineReader reader(file);
+		QVector<uchar> rgbe(4 * w);
+		for (int y = 0; y < h; y++) {
+			if (!readScanline(reader, rgbe.data(), w)) {
+				return ImageData();
+			}
+			
+			float * row = (float *)(data.buffer.data() + (bottomUp ? h - 1 - y : y) * data.bytesPerLine());
+			for (int x = 0; x < w; x++) {
+				const uchar * p = rgbe.constData() + 4 * x;
+				const float scale = p[3] ? ldexpf(1.0f, int(p[3]) - (128 + 8)) : 0.0f;
+				row[3 * x + 0] = p[0] * scale;
+				row[3 * x + 1] = p[1] * scale;
+				row[3 * x + 2] = p[2] * scale;
+			}
+		}
+		
+		return data;
+	}
+};
+
+REGISTER_IMAGE_PLUGIN(RadianceImagePlugin);
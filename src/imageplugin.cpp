@@ -18,70 +18,410 @@
 */
 
 #include "imageplugin.h"
+#include "blockcodec.h"
+#include "glstate.h"
 
+#include <QtCore/QFile>
 #include <QtCore/QList>
 //#include <QtGui/QImage>
 #include <QtGui/QImageReader>
 
+#include <stdlib.h>
+#include <string.h>
+
 namespace
 {
 	
 	static QList<const ImagePlugin *> * s_pluginList = NULL;
 	
+	// Size of the previews shown in the user interface.
+	static const int s_previewSize = 256;
 	
-	// Taken from Qt, but do not mirror.
-	static QImage convertToBGRA(const QImage &image)
+	// Half floats are stored as their bits.
+	struct Half
 	{
-		QImage img = image;
-		if (image.format() != QImage::Format_ARGB32) {
-			img = image.convertToFormat(QImage::Format_ARGB32);
-		}
+		ushort bits;
+	};
+	
+	static ushort floatToHalf(float f)
+	{
+		uint bits;
+		memcpy(&bits, &f, 4);
 		
-		if (QSysInfo::ByteOrder == QSysInfo::BigEndian) {
-			// mirror + swizzle
-			QImage res = img.copy();
-			for (int i=0; i < img.height(); i++) {
-				uint *p = (uint*) img.scanLine(i);
-			//	uint *q = (uint*) res.scanLine(img.height() - i - 1);
-				uint *q = (uint*) res.scanLine(i);
-				uint *end = p + img.width();
-				while (p < end) {
-					*q = ((*p << 24) & 0xff000000)
-						 | ((*p >> 24) & 0x000000ff)
-						 | ((*p << 8) & 0x00ff0000)
-						 | ((*p >> 8) & 0x0000ff00);
-					p++;
-					q++;
+		const uint sign = (bits >> 16) & 0x8000;
+		const int exponent = int((bits >> 23) & 0xFF) - 127 + 15;
+		uint mantissa = bits & 0x7FFFFF;
+		
+		if (((bits >> 23) & 0xFF) == 0xFF) {
+			// Infinity or NaN.
+			return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+		}
+		if (exponent >= 0x1F) {
+			return sign | 0x7C00;
+		}
+		if (exponent <= 0) {
+			// Denormal or zero.
+			if (exponent < -10) {
+				return sign;
+			}
+			mantissa |= 0x800000;
+			const int shift = 14 - exponent;
+			return sign | ((mantissa + (1 << (shift - 1))) >> shift);
+		}
+		// Rounding can carry into the exponent.
+		return sign | ((exponent << 10) + ((mantissa + 0x1000) >> 13));
+	}
+	
+	inline static uchar average(uchar a, uchar b, uchar c, uchar d)
+	{
+		return uchar((uint(a) + b + c + d + 2) / 4);
+	}
+	
+	inline static ushort average(ushort a, ushort b, ushort c, ushort d)
+	{
+		return ushort((uint(a) + b + c + d + 2) / 4);
+	}
+	
+	inline static float average(float a, float b, float c, float d)
+	{
+		return (a + b + c + d) * 0.25f;
+	}
+	
+	inline static Half average(Half a, Half b, Half c, Half d)
+	{
+		Half h;
+		h.bits = floatToHalf(average(halfToFloat(a.bits), halfToFloat(b.bits), halfToFloat(c.bits), halfToFloat(d.bits)));
+		return h;
+	}
+	
+	// Box filter a level to half its size.
+	template <typename T>
+	static void halveLevel(const uchar * src, int srcPitch, int srcWidth, int srcHeight, uchar * dst, int dstWidth, int dstHeight, int channels)
+	{
+		for (int y = 0; y < dstHeight; y++) {
+			const T * row0 = (const T *)(src + qMin(2 * y, srcHeight - 1) * srcPitch);
+			const T * row1 = (const T *)(src + qMin(2 * y + 1, srcHeight - 1) * srcPitch);
+			T * out = (T *)(dst + y * dstWidth * channels * sizeof(T));
+			
+			for (int x = 0; x < dstWidth; x++) {
+				const int x0 = qMin(2 * x, srcWidth - 1) * channels;
+				const int x1 = qMin(2 * x + 1, srcWidth - 1) * channels;
+				for (int c = 0; c < channels; c++) {
+					out[x * channels + c] = average(row0[x0 + c], row0[x1 + c], row1[x0 + c], row1[x1 + c]);
 				}
 			}
-			return res;
+		}
+	}
+	
+	static ImageData halve(const ImageData & src)
+	{
+		ImageData dst;
+		dst.width = qMax(1, src.width / 2);
+		dst.height = qMax(1, src.height / 2);
+		dst.format = src.format;
+		dst.type = src.type;
+		dst.alignment = 1;
+		dst.internalFormat = src.internalFormat;
+		
+		const int channels = src.channelCount();
+		dst.buffer = QSharedPointer<uchar>((uchar *)malloc(size_t(dst.bytesPerLine()) * dst.height), free);
+		dst.pixels = dst.buffer.data();
+		
+		if (src.type == GL_FLOAT) {
+			halveLevel<float>(src.pixels, src.bytesPerLine(), src.width, src.height, dst.buffer.data(), dst.width, dst.height, channels);
+		}
+		else if (src.type == GL_HALF_FLOAT_ARB) {
+			halveLevel<Half>(src.pixels, src.bytesPerLine(), src.width, src.height, dst.buffer.data(), dst.width, dst.height, channels);
+		}
+		else if (src.channelSize() == 2) {
+			halveLevel<ushort>(src.pixels, src.bytesPerLine(), src.width, src.height, dst.buffer.data(), dst.width, dst.height, channels);
 		}
 		else {
-			return img;
-		//	return img.mirrored();
+			halveLevel<uchar>(src.pixels, src.bytesPerLine(), src.width, src.height, dst.buffer.data(), dst.width, dst.height, channels);
+		}
+		
+		return dst;
+	}
+	
+	// Expand half floats for the drivers and the GLU paths that can not read them. The mipmaps are generated again.
+	static ImageData toFloat(const ImageData & src)
+	{
+		ImageData dst;
+		dst.width = src.width;
+		dst.height = src.height;
+		dst.format = src.format;
+		dst.type = GL_FLOAT;
+		dst.alignment = 4;
+		dst.internalFormat = src.internalFormat;
+		
+		const int count = src.width * src.channelCount();
+		dst.buffer = QSharedPointer<uchar>((uchar *)malloc(size_t(dst.bytesPerLine()) * dst.height), free);
+		dst.pixels = dst.buffer.data();
+		
+		for (int y = 0; y < src.height; y++) {
+			const ushort * in = (const ushort *)(src.pixels + y * src.bytesPerLine());
+			float * out = (float *)(dst.buffer.data() + y * dst.bytesPerLine());
+			for (int i = 0; i < count; i++) {
+				out[i] = halfToFloat(in[i]);
+			}
+		}
+		
+		return dst;
+	}
+	
+	// Map linear values to the display with a gamma of 2.2, clipping the highlights.
+	inline static int toByte(float value, bool alpha)
+	{
+		value = qBound(0.0f, value, 1.0f);
+		if (!alpha) {
+			value = powf(value, 1.0f / 2.2f);
+		}
+		return int(value * 255.0f + 0.5f);
+	}
+	
+	// Decompress the first level for drivers that lack the format. The mipmaps are generated again.
+	static ImageData decompress(const ImageData & src)
+	{
+		ImageData dst;
+		if (!BlockCodec::canDecompress(src.compressedFormat)) {
+			return dst;
+		}
+		
+		dst.width = src.width;
+		dst.height = src.height;
+		dst.format = GL_RGBA;
+		dst.type = GL_UNSIGNED_BYTE;
+		dst.alignment = 1;
+		if (BlockCodec::isSRGB(src.compressedFormat)) {
+			dst.internalFormat = GL_SRGB8_ALPHA8;
+		}
+		
+		dst.buffer = QSharedPointer<uchar>((uchar *)malloc(size_t(dst.width) * dst.height * 4), free);
+		dst.pixels = dst.buffer.data();
+		BlockCodec::decompress(src.compressedFormat, src.pixels, src.width, src.height, dst.buffer.data());
+		
+		return dst;
+	}
+	
+	// Next smaller level, taken from the stored mipmaps when there are any.
+	static ImageData nextLevel(const ImageData & data)
+	{
+		if (!data.mipmaps.isEmpty()) {
+			ImageData level = data;
+			level.width = data.mipmaps.first().width;
+			level.height = data.mipmaps.first().height;
+			level.pixels = data.mipmaps.first().pixels;
+			level.mipmaps.remove(0);
+			return level;
+		}
+		if (data.compressedFormat != 0) {
+			const ImageData level = decompress(data);
+			return level.isNull() ? level : halve(level);
+		}
+		return halve(data);
+	}
+	
+	// Convert a small level to an image for the user interface.
+	static QImage toImage(const ImageData & data)
+	{
+		QImage image(data.width, data.height, QImage::Format_ARGB32);
+		
+		const int channels = data.channelCount();
+		const int size = data.channelSize();
+		
+		for (int y = 0; y < data.height; y++) {
+			const uchar * src = data.pixels + y * data.bytesPerLine();
+			QRgb * dst = (QRgb *)image.scanLine(y);
+			
+			for (int x = 0; x < data.width; x++) {
+				if (data.type == GL_UNSIGNED_INT_8_8_8_8_REV) {
+					dst[x] = ((const uint *)src)[x];
+					continue;
+				}
+				
+				// Keep the most significant byte of each channel.
+				int v[4];
+				for (int c = 0; c < channels; c++) {
+					const uchar * p = src + (x * channels + c) * size;
+					const bool alpha = (c == 3) || (c == 1 && data.format == GL_LUMINANCE_ALPHA);
+					if (data.type == GL_FLOAT) {
+						v[c] = toByte(*(const float *)p, alpha);
+					}
+					else if (data.type == GL_HALF_FLOAT_ARB) {
+						v[c] = toByte(halfToFloat(*(const ushort *)p), alpha);
+					}
+					else {
+						v[c] = (size == 2) ? (*(const ushort *)p >> 8) : *p;
+					}
+				}
+				
+				switch (data.format) {
+					case GL_LUMINANCE:
+						dst[x] = qRgb(v[0], v[0], v[0]);
+						break;
+					case GL_LUMINANCE_ALPHA:
+						dst[x] = qRgba(v[0], v[0], v[0], v[1]);
+						break;
+					case GL_RGB:
+						dst[x] = qRgb(v[0], v[1], v[2]);
+						break;
+					case GL_BGR:
+						dst[x] = qRgb(v[2], v[1], v[0]);
+						break;
+					case GL_RGBA:
+						dst[x] = qRgba(v[0], v[1], v[2], v[3]);
+						break;
+					case GL_BGRA:
+						dst[x] = qRgba(v[2], v[1], v[0], v[3]);
+						break;
+				}
+			}
 		}
+		
+		return image;
 	}
 	
-	inline static uint nextPowerOfTwo( uint x ) 
+	static GLint internalFormat(GLenum format, GLenum type)
 	{
-		uint p = 1;
-		while( x > p ) {
-			p += p;
+		// Without float textures the driver clamps the values to 8 bits.
+		if ((type == GL_FLOAT || type == GL_HALF_FLOAT_ARB) && GLEW_ARB_texture_float) {
+			const bool half = (type == GL_HALF_FLOAT_ARB);
+			switch (format) {
+				case GL_LUMINANCE:
+					return half ? GL_LUMINANCE16F_ARB : GL_LUMINANCE32F_ARB;
+				case GL_LUMINANCE_ALPHA:
+					return half ? GL_LUMINANCE_ALPHA16F_ARB : GL_LUMINANCE_ALPHA32F_ARB;
+				case GL_RGB:
+				case GL_BGR:
+					return half ? GL_RGB16F_ARB : GL_RGB32F_ARB;
+			}
+			return half ? GL_RGBA16F_ARB : GL_RGBA32F_ARB;
+		}
+		
+		const bool wide = (type == GL_UNSIGNED_SHORT);
+		switch (format) {
+			case GL_LUMINANCE:
+				return wide ? GL_LUMINANCE16 : GL_LUMINANCE8;
+			case GL_LUMINANCE_ALPHA:
+				return wide ? GL_LUMINANCE16_ALPHA16 : GL_LUMINANCE8_ALPHA8;
+			case GL_RGB:
+			case GL_BGR:
+				return wide ? GL_RGB16 : GL_RGB8;
 		}
-		return p;
+		return wide ? GL_RGBA16 : GL_RGBA8;
+	}
+	
+	inline static bool isPowerOfTwo( uint x )
+	{
+		return (x & (x - 1)) == 0;
 	}
 	
 } // namespace
 
 
-// @@ Add plugin priorities. Use sorted list.
+int ImageData::channelCount() const
+{
+	switch (format) {
+		case GL_LUMINANCE:
+			return 1;
+		case GL_LUMINANCE_ALPHA:
+			return 2;
+		case GL_RGB:
+		case GL_BGR:
+			return 3;
+	}
+	return 4;
+}
+
+int ImageData::channelSize() const
+{
+	switch (type) {
+		case GL_UNSIGNED_SHORT:
+		case GL_HALF_FLOAT_ARB:
+			return 2;
+		case GL_FLOAT:
+			return 4;
+	}
+	return 1;
+}
+
+int ImageData::bytesPerLine() const
+{
+	const int bytes = width * channelCount() * channelSize();
+	return (bytes + alignment - 1) / alignment * alignment;
+}
+
+qint64 ImageData::levelSize(int w, int h) const
+{
+	if (compressedFormat != 0) {
+		return BlockCodec::levelSize(compressedFormat, w, h);
+	}
+	const qint64 bytes = qint64(w) * channelCount() * channelSize();
+	return (bytes + alignment - 1) / alignment * alignment * h;
+}
+
+
+float halfToFloat(ushort h)
+{
+	const uint sign = uint(h & 0x8000) << 16;
+	int exponent = (h >> 10) & 0x1F;
+	uint mantissa = h & 0x3FF;
+	
+	uint bits;
+	if (exponent == 0x1F) {
+		// Infinity or NaN.
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else if (exponent != 0) {
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+	else if (mantissa == 0) {
+		bits = sign;
+	}
+	else {
+		// Normalize the denormal.
+		exponent = 127 - 15 + 1;
+		while (!(mantissa & 0x400)) {
+			mantissa <<= 1;
+			exponent--;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+	}
+	
+	float f;
+	memcpy(&f, &bits, 4);
+	return f;
+}
+
+
+//static
+TextureCaps TextureCaps::current()
+{
+	TextureCaps caps;
+	
+	caps.maxSize = 256;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &caps.maxSize);
+	
+	caps.compressedFormats = BlockCodec::supportedFormats();
+	caps.halfFloatPixels = GLEW_ARB_half_float_pixel || GLEW_VERSION_3_0;
+	
+	return caps;
+}
+
+
+// Keep the list sorted by priority, the registration order across files is undefined.
 void ImagePluginManager::addPlugin(const ImagePlugin * plugin)
 {
 	Q_ASSERT(plugin != NULL);
 	if( s_pluginList == NULL ) {
 		s_pluginList = new QList<const ImagePlugin *>();
 	}
-	s_pluginList->append(plugin);
+	
+	int i = 0;
+	while( i < s_pluginList->count() && s_pluginList->at(i)->priority() >= plugin->priority() ) {
+		i++;
+	}
+	s_pluginList->insert(i, plugin);
 }
 
 void ImagePluginManager::removePlugin(const ImagePlugin * plugin)
@@ -111,105 +451,175 @@ QList<QByteArray> ImagePluginManager::supportedFormats()
 	return list;
 }
 
-QImage ImagePluginManager::load(QString name, GLuint obj, GLuint * target)
+ImageData ImagePluginManager::decode(const QString & name, const TextureCaps & caps)
 {
+	ImageData data;
+	
 	if (s_pluginList != NULL) {
 		foreach(const ImagePlugin * plugin, *s_pluginList) {
 			if (plugin->canLoad(name)) {
-				return plugin->load(name, obj, target);
+				data = plugin->decode(name);
+				if (!data.isNull()) {
+					break;
+				}
 			}
 		}
 	}
-
-	return QImage();
+	
+	if (data.isNull()) {
+		return data;
+	}
+	
+	// Decompress the formats that the driver does not support.
+	if (data.compressedFormat != 0 && !caps.compressedFormats.contains(data.compressedFormat)) {
+		data = decompress(data);
+		if (data.isNull()) {
+			return data;
+		}
+	}
+	
+	if (data.type == GL_HALF_FLOAT_ARB && !caps.halfFloatPixels) {
+		data = toFloat(data);
+	}
+	
+	// Drop the levels that do not fit in a texture.
+	while (data.width > caps.maxSize || data.height > caps.maxSize) {
+		data = nextLevel(data);
+		if (data.isNull()) {
+			return data;
+		}
+	}
+	
+	ImageData level = data;
+	while (!level.isNull() && (level.width > s_previewSize || level.height > s_previewSize)) {
+		level = nextLevel(level);
+	}
+	if (level.compressedFormat != 0) {
+		level = decompress(level);
+	}
+	if (!level.isNull()) {
+		data.preview = toImage(level);
+	}
+	
+	return data;
 }
 
-
-// @@ Add dds plugin.
-// @@ Add exr plugin.
-// @@ Add hdr plugin.
-
-
-static void updateOpenGLImage(QImage image, GLuint obj, GLuint * target)
+void ImagePluginManager::upload(const ImageData & data, GLuint obj, GLuint * target)
 {
-	QImage glImage = convertToBGRA(image);
-
-	int w = glImage.width();
-	int h = glImage.height();
-
-	// Resize texture if NP2 not supported.
-	if (!GLEW_ARB_texture_non_power_of_two) {
-		w = nextPowerOfTwo(w);
-		h = nextPowerOfTwo(h);
-	}
-
-	// Clamp to maximum texture size.
-	GLint maxTextureSize = 256;
-	glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxTextureSize );
-	if (w > maxTextureSize ) w = maxTextureSize;
-	if (h > maxTextureSize ) h = maxTextureSize;
-
-	if (glImage.width() != w || glImage.height() != h) {
-		glImage = glImage.scaled(w, h);
+	Q_ASSERT(!data.isNull());
+	
+	GLint format = data.internalFormat;
+	if (format == 0) {
+		format = (data.compressedFormat != 0) ? data.compressedFormat : internalFormat(data.format, data.type);
 	}
+	
+	QVector<ImageData::Level> levels;
+	ImageData::Level first = { data.width, data.height, data.pixels };
+	levels << first << data.mipmaps;
 
 	*target = GL_TEXTURE_2D;
-	glBindTexture(GL_TEXTURE_2D, obj);
+	GLState::bindTexture(GL_TEXTURE_2D, obj);
+	
+	glPixelStorei(GL_UNPACK_ALIGNMENT, data.alignment);
 
-	if (GLEW_SGIS_generate_mipmap || GLEW_VERSION_1_4) {
-		glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, glImage.width(), glImage.height(), 0, GL_BGRA, GL_UNSIGNED_BYTE, glImage.bits());
+	const bool generateMipmaps = (GLEW_SGIS_generate_mipmap || GLEW_VERSION_1_4);
+	const bool resize = !GLEW_ARB_texture_non_power_of_two && (!isPowerOfTwo(data.width) || !isPowerOfTwo(data.height));
+	
+	if (data.compressedFormat == 0 && (resize || (!generateMipmaps && data.mipmaps.isEmpty()))) {
+		// GLU also scales the image to a power of two.
+		const ImageData pixels = (data.type == GL_HALF_FLOAT_ARB) ? toFloat(data) : data;
+		gluBuild2DMipmaps(GL_TEXTURE_2D, format, pixels.width, pixels.height, pixels.format, pixels.type, pixels.pixels);
 	}
 	else {
-		gluBuild2DMipmaps(GL_TEXTURE_2D, 4, glImage.width(), glImage.height(), GL_BGRA, GL_UNSIGNED_BYTE, glImage.bits());
+		// Stage the pixels in a buffer object, so that the driver does not have to copy them before returning.
+		GLuint buffer = 0;
+		if (GLEW_ARB_pixel_buffer_object) {
+			qint64 size = 0;
+			foreach (const ImageData::Level & level, levels) {
+				size += data.levelSize(level.width, level.height);
+			}
+			
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, buffer);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER_ARB, size, NULL, GL_STREAM_DRAW);
+			
+			uchar * ptr = (uchar *)glMapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY);
+			if (ptr != NULL) {
+				// Use offsets into the buffer.
+				size_t offset = 0;
+				for (int i = 0; i < levels.count(); i++) {
+					const qint64 levelSize = data.levelSize(levels[i].width, levels[i].height);
+					memcpy(ptr + offset, levels[i].pixels, levelSize);
+					levels[i].pixels = (const uchar *)offset;
+					offset += levelSize;
+				}
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB);
+			}
+			else {
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+				glDeleteBuffers(1, &buffer);
+				buffer = 0;
+			}
+		}
+		
+		// Use the stored mipmaps when there are any.
+		const bool storedMipmaps = !data.mipmaps.isEmpty();
+		if (generateMipmaps) {
+			glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, storedMipmaps ? GL_FALSE : GL_TRUE);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, storedMipmaps ? levels.count() - 1 : 1000);
+		
+		for (int i = 0; i < levels.count(); i++) {
+			const ImageData::Level & level = levels.at(i);
+			if (data.compressedFormat != 0) {
+				glCompressedTexImage2D(GL_TEXTURE_2D, i, format, level.width, level.height, 0, data.levelSize(level.width, level.height), level.pixels);
+			}
+			else {
+				glTexImage2D(GL_TEXTURE_2D, i, format, level.width, level.height, 0, data.format, data.type, level.pixels);
+			}
+		}
+		
+		if (buffer != 0) {
+			// The texture keeps the data alive until the transfer is done.
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+			glDeleteBuffers(1, &buffer);
+		}
 	}
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 	ReportGLErrors();
 }
 
-// Image plugin that supports all the image types that Qt supports.
-class QtImagePlugin : public ImagePlugin
+QImage ImagePluginManager::load(QString name, GLuint obj, GLuint * target)
 {
-public:
-
-	virtual QList<QByteArray> supportedFormats() const
-	{
-		return QImageReader::supportedImageFormats();
+	ImageData data = decode(name, TextureCaps::current());
+	if (data.isNull()) {
+		return QImage();
 	}
 	
-	virtual bool canLoad(const QString & fileName) const
-	{
-		Q_UNUSED(fileName);
-		return true;
-	}
+	upload(data, obj, target);
 	
-	virtual QImage load(const QString & name, GLuint obj, GLuint * target) const
-	{
-		Q_ASSERT(obj != 0);
-		Q_ASSERT(target != NULL);
-		
-		QImage image;
-		if( name.isEmpty() || !image.load(name) ) {
-			image.load(":/images/default.png");
-		}
-
-		updateOpenGLImage(image, obj, target);
-		
-		return image;
-	}
-};
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-REGISTER_IMAGE_PLUGIN(QtImagePlugin);
+	return data.preview;
+}
 
 
+// Radiance and OpenEXR files are read by the float plugins, without the 8 bit conversion of stb.
 #define STBI_NO_HDR
 #include "stb_image.c"
 
+// Image plugin that decodes to the native channels of the file, tried first
+// because it does not expand the pixels to 32 bits.
 class StbImagePlugin : public ImagePlugin
 {
+	virtual int priority() const
+	{
+		return 1;
+	}
+	
 	virtual QList<QByteArray> supportedFormats() const
 	{
 		return QList<QByteArray>() << "tga" << "bmp" << "psd" << "pic";
@@ -217,42 +627,76 @@ class StbImagePlugin : public ImagePlugin
 
 	virtual bool canLoad(const QString & fileName) const
 	{
-		Q_UNUSED(fileName);
-		return true;
-
-		//QByteArray name = fileName.toAscii();
-		//int x, y, comp;
-		//return stbi_info(name.data(), &x, &y, &comp) != 0;
+		QByteArray name = QFile::encodeName(fileName);
+		int x, y, comp;
+		return stbi_info(name.data(), &x, &y, &comp) != 0;
 	}
 
-	virtual QImage load(const QString & fileName, GLuint obj, GLuint * target) const
+	virtual ImageData decode(const QString & fileName) const
 	{
-		Q_ASSERT(obj != 0);
-		Q_ASSERT(target != NULL);
-
-		QByteArray name = fileName.toAscii();
+		static const GLenum formats[] = { GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+		
+		QByteArray name = QFile::encodeName(fileName);
 
 		int w, h, comp;
-		unsigned char * data = stbi_load(name.data(), &w, &h, &comp, 4);
+		unsigned char * pixels = stbi_load(name.data(), &w, &h, &comp, 0);
 
-		if (data == NULL) {
-			return QImage();
+		if (pixels == NULL) {
+			return ImageData();
 		}
+		
+		ImageData data;
+		data.width = w;
+		data.height = h;
+		data.format = formats[comp - 1];
+		data.type = GL_UNSIGNED_BYTE;
+		data.alignment = 1;
+		data.buffer = QSharedPointer<uchar>(pixels, stbi_image_free);
+		data.pixels = pixels;
+		return data;
+	}
+};
 
-		QImage image(w, h, QImage::Format_ARGB32);
+REGISTER_IMAGE_PLUGIN(StbImagePlugin);
 
-		for (int y = 0; y < h; y++) {
-			for (int x = 0; x < w; x++) {
-				QRgb value = qRgba(data[0], data[1], data[2], data[3]);
-				image.setPixel(x, y, value);
-				data += 4;
-			}
-		}
 
-		updateOpenGLImage(image, obj, target);
+// Image plugin that supports all the image types that Qt supports.
+class QtImagePlugin : public ImagePlugin
+{
+public:
 
-		return image;
+	virtual QList<QByteArray> supportedFormats() const
+	{
+		return QImageReader::supportedImageFormats();
+	}
+	
+	virtual bool canLoad(const QString & fileName) const
+	{
+		Q_UNUSED(fileName);
+		return true;
+	}
+	
+	virtual ImageData decode(const QString & name) const
+	{
+		ImageData data;
+		if( name.isEmpty() || !data.image.load(name) ) {
+			return data;
+		}
+		
+		// 32 bit images are uploaded as they are, in any byte order.
+		if( data.image.format() != QImage::Format_ARGB32 && data.image.format() != QImage::Format_RGB32 ) {
+			data.image = data.image.convertToFormat(QImage::Format_ARGB32);
+		}
+		
+		const QImage & image = data.image;
+		data.width = image.width();
+		data.height = image.height();
+		data.format = GL_BGRA;
+		data.type = GL_UNSIGNED_INT_8_8_8_8_REV;
+		data.alignment = 4;
+		data.pixels = image.bits();
+		return data;
 	}
 };
 
-REGISTER_IMAGE_PLUGIN(StbImagePlugin);
+REGISTER_IMAGE_PLUGIN(QtImagePlugin);
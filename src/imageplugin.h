@@ -22,18 +22,84 @@
 
 #include "glutils.h"
 
+#include <QtCore/QList>
+#include <QtCore/QSharedPointer>
 #include <QtCore/QString>
+#include <QtCore/QVector>
 #include <QtGui/QImage>
 
 
-// Image plugin interface.
+// Decoded image, uploaded straight from the memory of the decoder.
+struct ImageData
+{
+	ImageData() : width(0), height(0), format(GL_RGBA), type(GL_UNSIGNED_BYTE), alignment(4), pixels(NULL),
+		compressedFormat(0), internalFormat(0) {}
+	
+	bool isNull() const { return pixels == NULL; }
+	
+	int channelCount() const;
+	int channelSize() const;
+	int bytesPerLine() const;
+	qint64 levelSize(int w, int h) const;
+	
+	int width;
+	int height;
+	GLenum format;		// GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_BGR, GL_RGBA or GL_BGRA.
+	GLenum type;		// GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT_8_8_8_8_REV, GL_HALF_FLOAT_ARB or GL_FLOAT.
+	int alignment;		// Alignment of the rows in bytes.
+	const uchar * pixels;
+	
+	// Block compressed format of the pixels, zero when they are not compressed.
+	GLenum compressedFormat;
+	
+	// Internal format of the texture, zero to derive it from the pixels.
+	GLint internalFormat;
+	
+	// Levels after the first one, for images that store their mipmaps.
+	struct Level
+	{
+		int width;
+		int height;
+		const uchar * pixels;
+	};
+	QVector<Level> mipmaps;
+	
+	// Owners of the pixels, either a buffer of the decoder or a QImage.
+	QSharedPointer<uchar> buffer;
+	QImage image;
+	
+	// Downsampled copy for the user interface.
+	QImage preview;
+};
+
+// Convert the bits of a half float.
+float halfToFloat(ushort h);
+
+
+// Texture limits of the current context. Queried in the GUI thread, since the decoders can not use GL.
+struct TextureCaps
+{
+	int maxSize;
+	QList<GLenum> compressedFormats;
+	bool halfFloatPixels;
+	
+	static TextureCaps current();
+};
+
+
+// Image plugin interface. Images are decoded on the loader threads, so the
+// plugins must not use GL while decoding.
 class ImagePlugin
 {
 public:
 	virtual ~ImagePlugin() {}
+	
+	// Plugins with higher priority are tried first.
+	virtual int priority() const { return 0; }
+	
 	virtual QList<QByteArray> supportedFormats() const = 0;
 	virtual bool canLoad(const QString & name) const = 0;
-	virtual QImage load(const QString & name, GLuint obj, GLuint * target) const = 0;
+	virtual ImageData decode(const QString & name) const = 0;
 };
 
 
@@ -45,6 +111,13 @@ namespace ImagePluginManager
 
 	QList<QByteArray> supportedFormats();
 	
+	// Decode with the first plugin that succeeds, fitting the image in the limits of the context. Thread safe.
+	ImageData decode(const QString & name, const TextureCaps & caps);
+	
+	// Upload decoded pixels to the texture object. Keeps the sampling state of the texture.
+	void upload(const ImageData & data, GLuint obj, GLuint * target);
+	
+	// Decode and upload synchronously.
 	QImage load(QString name, GLuint obj, GLuint * target);	
 };
 
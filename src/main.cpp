@@ -19,6 +19,7 @@
 */
 
 #include "qshaderedit.h"
+#include "bench.h"
 
 #include <QtGui/QApplication>
 #include <QtGui/QPlastiqueStyle>
@@ -34,9 +35,19 @@ int main(int argc, char **argv)
 	// This causes lockups in some X servers.
 	//XInitThreads();
 #endif
+#if defined(Q_WS_X11) && QT_VERSION >= 0x040800
+	// Let Qt initialize Xlib threading before opening the display, so that
+	// effects can be built in a shared context on a background thread.
+	QCoreApplication::setAttribute(Qt::AA_X11InitThreads);
+#endif
 	
     QApplication app(argc, argv);
 
+	// Headless benchmark mode.
+	if (app.arguments().contains("--bench")) {
+		return runBenchmark(app.arguments());
+	}
+
 #if defined(Q_WS_WIN)
 	app.setStyle(new QPlastiqueStyle());
 #endif
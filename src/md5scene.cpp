@@ -276,8 +276,10 @@ md5Scene::~md5Scene()
 	}
 }
 
-void md5Scene::transform() const
-{}
+Matrix4 md5Scene::transform() const
+{
+	return Matrix4();
+}
 
 void md5Scene::draw(Effect* effect) const
 {
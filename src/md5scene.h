@@ -141,7 +141,7 @@ class md5Scene : public Scene
 		void load(QString filename);
 		void compileBase();
 
-		virtual void transform() const;
+		virtual Matrix4 transform() const;
 		virtual void draw(Effect* effect) const;
 
 		virtual void setupMenu(QMenu * menu) const
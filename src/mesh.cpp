@@ -0,0 +1,283 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "mesh.h"
+
+#include <QtOpenGL/QGLContext>
+
+#include <stddef.h>
+
+
+namespace
+{
+	static bool hasGenericAttributes()
+	{
+		return GLEW_VERSION_2_0;
+	}
+	
+	static bool hasVertexArrayObjects()
+	{
+#if defined(GL_ARB_vertex_array_object)
+		return GLEW_ARB_vertex_array_object || GLEW_VERSION_3_0;
+#else
+		return false;
+#endif
+	}
+	
+	static bool hasMultiTexture()
+	{
+		return GLEW_ARB_multitexture || GLEW_VERSION_1_3;
+	}
+	
+} // namespace
+
+
+Mesh::Mesh() :
+	m_hasTangents(false),
+	m_vertexBuffer(0),
+	m_indexBuffer(0),
+	m_vertexCount(0),
+	m_indexCount(0),
+	m_vertexArray(0),
+	m_vertexArrayContext(NULL)
+{
+}
+
+Mesh::~Mesh()
+{
+	clear();
+}
+
+void Mesh::clear()
+{
+	m_vertices.clear();
+	m_indices.clear();
+	
+	if( m_vertexBuffer != 0 ) {
+		glDeleteBuffers(1, &m_vertexBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+		m_vertexBuffer = 0;
+		m_indexBuffer = 0;
+	}
+	
+#if defined(GL_ARB_vertex_array_object)
+	if( m_vertexArray != 0 && m_vertexArrayContext == QGLContext::currentContext() ) {
+		glDeleteVertexArrays(1, &m_vertexArray);
+	}
+#endif
+	m_vertexArray = 0;
+	m_vertexArrayContext = NULL;
+	
+	m_vertexCount = 0;
+	m_indexCount = 0;
+}
+
+GLuint Mesh::addVertex(const Vertex & v)
+{
+	m_vertices.append(v);
+	return m_vertices.size() - 1;
+}
+
+void Mesh::addTriangle(GLuint a, GLuint b, GLuint c)
+{
+	m_indices.append(a);
+	m_indices.append(b);
+	m_indices.append(c);
+}
+
+void Mesh::addQuad(const Vertex & a, const Vertex & b, const Vertex & c, const Vertex & d)
+{
+	const GLuint first = addVertex(a);
+	addVertex(b);
+	addVertex(c);
+	addVertex(d);
+	addTriangle(first, first + 1, first + 2);
+	addTriangle(first, first + 2, first + 3);
+}
+
+int Mesh::vertexCount() const
+{
+	return m_vertexBuffer != 0 ? m_vertexCount : m_vertices.size();
+}
+
+int Mesh::indexCount() const
+{
+	return m_vertexBuffer != 0 ? m_indexCount : m_indices.size();
+}
+
+void Mesh::upload()
+{
+	if( m_indices.isEmpty() ) {
+		return;
+	}
+	
+	if( m_vertexBuffer == 0 ) {
+		glGenBuffers(1, &m_vertexBuffer);
+		glGenBuffers(1, &m_indexBuffer);
+	}
+	
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex), m_vertices.constData(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(GLuint), m_indices.constData(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	
+	m_vertexCount = m_vertices.size();
+	m_indexCount = m_indices.size();
+	
+	m_vertices.clear();
+	m_indices.clear();
+}
+
+void Mesh::bind() const
+{
+	if( m_vertexBuffer == 0 ) {
+		return;
+	}
+	
+#if defined(GL_ARB_vertex_array_object)
+	if( hasVertexArrayObjects() ) {
+		const QGLContext * context = QGLContext::currentContext();
+		
+		if( m_vertexArray != 0 && m_vertexArrayContext == context ) {
+			glBindVertexArray(m_vertexArray);
+			return;
+		}
+		
+		if( m_vertexArray == 0 ) {
+			// Record the array state once, it is restored with a single bind.
+			glGenVertexArrays(1, &m_vertexArray);
+			m_vertexArrayContext = context;
+			glBindVertexArray(m_vertexArray);
+			setupArrays();
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			return;
+		}
+	}
+#endif
+	
+	setupArrays();
+}
+
+void Mesh::release() const
+{
+	if( m_vertexBuffer == 0 ) {
+		return;
+	}
+	
+#if defined(GL_ARB_vertex_array_object)
+	if( m_vertexArray != 0 && m_vertexArrayContext == QGLContext::currentContext() ) {
+		glBindVertexArray(0);
+		return;
+	}
+#endif
+	
+	clearArrays();
+}
+
+void Mesh::drawRange(int first, int count) const
+{
+	if( m_vertexBuffer == 0 || count <= 0 ) {
+		return;
+	}
+	
+	glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (const GLvoid *)(first * sizeof(GLuint)));
+}
+
+void Mesh::draw() const
+{
+	bind();
+	drawRange(0, m_indexCount);
+	release();
+}
+
+void Mesh::setupArrays() const
+{
+	const GLsizei stride = sizeof(Vertex);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	
+	// Conventional arrays, for the fixed function and the effects that use them.
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, stride, (const GLvoid *)offsetof(Vertex, pos));
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(GL_FLOAT, stride, (const GLvoid *)offsetof(Vertex, normal));
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glTexCoordPointer(2, GL_FLOAT, stride, (const GLvoid *)offsetof(Vertex, texcoord));
+	
+	if( m_hasTangents && hasMultiTexture() ) {
+		glClientActiveTextureARB(GL_TEXTURE6_ARB);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(3, GL_FLOAT, stride, (const GLvoid *)offsetof(Vertex, tangent));
+		glClientActiveTextureARB(GL_TEXTURE7_ARB);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(3, GL_FLOAT, stride, (const GLvoid *)offsetof(Vertex, bitangent));
+		glClientActiveTextureARB(GL_TEXTURE0_ARB);
+	}
+	
+	// Generic attributes, for shaders that do not use the built in inputs.
+	if( hasGenericAttributes() ) {
+		glEnableVertexAttribArray(PositionAttribute);
+		glVertexAttribPointer(PositionAttribute, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)offsetof(Vertex, pos));
+		glEnableVertexAttribArray(NormalAttribute);
+		glVertexAttribPointer(NormalAttribute, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(TexCoordAttribute);
+		glVertexAttribPointer(TexCoordAttribute, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)offsetof(Vertex, texcoord));
+		
+		if( m_hasTangents ) {
+			glEnableVertexAttribArray(TangentAttribute);
+			glVertexAttribPointer(TangentAttribute, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)offsetof(Vertex, tangent));
+			glEnableVertexAttribArray(BitangentAttribute);
+			glVertexAttribPointer(BitangentAttribute, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)offsetof(Vertex, bitangent));
+		}
+	}
+}
+
+void Mesh::clearArrays() const
+{
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	
+	if( m_hasTangents && hasMultiTexture() ) {
+		glClientActiveTextureARB(GL_TEXTURE6_ARB);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glClientActiveTextureARB(GL_TEXTURE7_ARB);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glClientActiveTextureARB(GL_TEXTURE0_ARB);
+	}
+	
+	if( hasGenericAttributes() ) {
+		glDisableVertexAttribArray(PositionAttribute);
+		glDisableVertexAttribArray(NormalAttribute);
+		glDisableVertexAttribArray(TexCoordAttribute);
+		
+		if( m_hasTangents ) {
+			glDisableVertexAttribArray(TangentAttribute);
+			glDisableVertexAttribArray(BitangentAttribute);
+		}
+	}
+	
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,114 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <GL/glew.h>
+
+#include <QtCore/QVector>
+
+class QGLContext;
+
+
+// Indexed triangle geometry stored in buffer objects.
+// Attributes are fed both through the conventional arrays and through
+// the generic attributes that GLSLEffect binds to these names:
+//   0: position, 2: normal, 8: texcoord, 14: tangent, 15: bitangent
+// The indices match the NVIDIA aliasing of the conventional arrays.
+class Mesh
+{
+public:
+	struct Vertex
+	{
+		Vertex() { }
+		Vertex(float x, float y, float z, float nx, float ny, float nz, float s, float t)
+		{
+			pos[0] = x; pos[1] = y; pos[2] = z;
+			normal[0] = nx; normal[1] = ny; normal[2] = nz;
+			texcoord[0] = s; texcoord[1] = t;
+			tangent[0] = tangent[1] = tangent[2] = 0.0f;
+			bitangent[0] = bitangent[1] = bitangent[2] = 0.0f;
+		}
+		
+		float pos[3];
+		float normal[3];
+		float texcoord[2];
+		float tangent[3];
+		float bitangent[3];
+	};
+	
+	enum Attribute
+	{
+		PositionAttribute = 0,
+		NormalAttribute = 2,
+		TexCoordAttribute = 8,
+		TangentAttribute = 14,
+		BitangentAttribute = 15
+	};
+	
+	Mesh();
+	~Mesh();
+	
+	void clear();
+	
+	GLuint addVertex(const Vertex & v);
+	void addTriangle(GLuint a, GLuint b, GLuint c);
+	void addQuad(const Vertex & a, const Vertex & b, const Vertex & c, const Vertex & d);
+	
+	// Send the tangents in texture units 6 and 7.
+	void setHasTangents(bool hasTangents) { m_hasTangents = hasTangents; }
+	
+	int vertexCount() const;
+	int indexCount() const;
+	
+	// Copy the geometry to the buffer objects and release the client copy.
+	void upload();
+	
+	void bind() const;
+	void release() const;
+	
+	// Draw a range of triangles, the mesh must be bound.
+	void drawRange(int first, int count) const;
+	
+	void draw() const;
+	
+private:
+	Q_DISABLE_COPY(Mesh)
+	
+	void setupArrays() const;
+	void clearArrays() const;
+	
+	QVector<Vertex> m_vertices;
+	QVector<GLuint> m_indices;
+	bool m_hasTangents;
+	
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	int m_vertexCount;
+	int m_indexCount;
+	
+	// Vertex array objects are not shared, remember the context that owns it.
+	mutable GLuint m_vertexArray;
+	mutable const QGLContext * m_vertexArrayContext;
+};
+
+
+#endif // MESH_H
@@ -65,11 +65,11 @@ static void assignVariant(QVariant & to, const QVariant & from)
 
 
 
-Parameter::Parameter() : m_widget(Widget_Default)
+Parameter::Parameter() : m_widget(Widget_Default), m_frozen(false)
 {
 }
 
-Parameter::Parameter(const QString & name) : m_name(name), m_widget(Widget_Default)
+Parameter::Parameter(const QString & name) : m_name(name), m_widget(Widget_Default), m_frozen(false)
 {
 }
 
@@ -45,6 +45,9 @@ public:
 	const QString & name() const { return m_name; }
 	const QString & description() const { return m_description; }
 	
+	// Parameters that share a group are shown together, empty if ungrouped.
+	const QString & group() const { return m_group; }
+	
 	void setDescription(const QString& desc) { m_description = desc; }
 	
 	QVariant value() const { return m_value; }
@@ -58,6 +61,11 @@ public:
 	virtual bool isEditable() const;
 	virtual Widget widget() const { return m_widget; }
 	
+	// Frozen parameters are baked into specialized programs as constants.
+	virtual bool canFreeze() const { return false; }
+	bool isFrozen() const { return m_frozen; }
+	void setFrozen(bool b) { m_frozen = b; }
+	
 	bool hasRange() const;
 	QVariant minValue() const { return m_minValue; } 
 	QVariant maxValue() const { return m_maxValue; }
@@ -80,16 +88,19 @@ public:
 	
 protected:
 	void setName(const QString& name) { m_name = name; }
+	void setGroup(const QString& group) { m_group = group; }
 	void setWidget(Widget w) { /*Q_ASSERT(m_value.type() == QVariant::List);*/ m_widget = w; }
 	
 private:
 	QString m_name;
 	QString m_description;
+	QString m_group;
 	
 	QVariant m_value;
 	QVariant m_minValue, m_maxValue;
 	
 	Widget m_widget;
+	bool m_frozen;
 };
 
 #endif // PARAMETER_H
@@ -181,7 +181,7 @@ void ParameterDelegate::paint(QPainter * painter, const QStyleOptionViewItem & o
 	QStyleOptionViewItem option = o;
 	
 	// dont't draw selection behind editor widgets
-	if (index.column() == 1 && param->isEditable()) {
+	if (index.column() == 1 && param != NULL && param->isEditable()) {
 		option.state &= ~QStyle::State_Selected;
 		option.state &= ~QStyle::State_HasFocus;
 	}
@@ -23,24 +23,48 @@
 #include "effect.h"
 
 
+// The internal id of an index encodes its parent:
+// - top level items (parameters and groups) use -1.
+// - children of the top level item at row r use (r << 16).
+// - components of the grouped parameter at row k of group r use (r << 16) | (k + 1).
+namespace
+{
+	inline int topRow(int id) { return id >> 16; }
+	inline int subRow(int id) { return (id & 0xFFFF) - 1; }
+}
+
+
 QModelIndex ParameterModel::index(int row, int column, const QModelIndex & parent) const
 {
 	if( !parent.isValid() ) {
 		return createIndex(row, column, -1);
 	}
+	
+	const int parentId = parent.internalId();
+	if( parentId == -1 ) {
+		return createIndex(row, column, parent.row() << 16);
+	}
 	else {
-		return createIndex(row, column, parent.row());
+		Q_ASSERT(subRow(parentId) == -1);
+		return createIndex(row, column, (topRow(parentId) << 16) | (parent.row() + 1));
 	}
-	return QModelIndex();
 }
 
 QModelIndex ParameterModel::parent(const QModelIndex & index) const
 {
-	if( !index.isValid() || isParameter(index) ) {
+	if( !index.isValid() ) {
 		return QModelIndex();
 	}
+	
+	const int id = index.internalId();
+	if( id == -1 ) {
+		return QModelIndex();
+	}
+	else if( subRow(id) == -1 ) {
+		return createIndex(topRow(id), 0, -1);
+	}
 	else {
-		return createIndex(index.internalId(), 0, -1);
+		return createIndex(subRow(id), 0, topRow(id) << 16);
 	}
 }
 
@@ -48,7 +72,10 @@ int ParameterModel::rowCount(const QModelIndex & parent) const
 {
 	if( m_effect != NULL ) {
 		if( !parent.isValid() ) {
-			return m_effect->parameterCount();
+			return m_items.count();
+		}
+		else if( isGroup(parent) ) {
+			return m_items.at(parent.row()).parameters.count();
 		}
 		else if( isParameter(parent) ) {
 			return parameter(parent)->componentCount();
@@ -69,7 +96,13 @@ QVariant ParameterModel::data(const QModelIndex &index, int role) const
 		return QVariant();
 	}
 
-	if( isComponent(index) ) {
+	if( isGroup(index) ) {
+		// Parameter group.
+		if (index.column() == 0 && role == Qt::DisplayRole) {
+			return m_items.at(index.row()).group;
+		}
+	}
+	else if( isComponent(index) ) {
 		// Parameter component.
 		if (index.column() == 0) {			
 			if (role == Qt::DisplayRole)
@@ -91,6 +124,9 @@ QVariant ParameterModel::data(const QModelIndex &index, int role) const
 			if (role == Qt::ToolTipRole) { // only show tooltip when over col 0, otherwise it gets annoying
 				return parameter(index)->description();
 			}
+			if (role == Qt::CheckStateRole && canFreeze(index)) {
+				return parameter(index)->isFrozen() ? Qt::Checked : Qt::Unchecked;
+			}
 		}
 		else if (index.column() == 1) {
 			if (role == Qt::DisplayRole) {
@@ -130,14 +166,27 @@ QModelIndex ParameterModel::buddy(const QModelIndex & index) const
 Qt::ItemFlags ParameterModel::flags(const QModelIndex &index) const
 {
 	Q_ASSERT(index.isValid());
+	if (isGroup(index)) {
+		return Qt::ItemIsEnabled;
+	}
 	if (index.column() == 1) {
 		return QAbstractItemModel::flags(index) | Qt::ItemIsEditable; 
 	}
+	if (canFreeze(index)) {
+		return QAbstractItemModel::flags(index) | Qt::ItemIsUserCheckable;
+	}
 	return QAbstractItemModel::flags(index);
 }
 
 bool ParameterModel::setData(const QModelIndex &index, const QVariant &value, int role)
 {
+	if (index.isValid() && index.column() == 0 && role == Qt::CheckStateRole && canFreeze(index)) {
+		parameter(index)->setFrozen(value.toInt() == Qt::Checked);
+		emit dataChanged(index, index);
+		emit freezeChanged();
+		return true;
+	}
+	
 	if (!index.isValid() || index.column() != 1 || role != Qt::EditRole)
 		return false;
 
@@ -147,8 +196,9 @@ bool ParameterModel::setData(const QModelIndex &index, const QVariant &value, in
 		if( param->componentValue(index.row()) != value ) {
 			param->setComponentValue(index.row(), value);
 			emit dataChanged(index, index);
-			QModelIndex parentIndex = createIndex(index.internalId(), 1, -1);
+			QModelIndex parentIndex = this->index(index.parent().row(), 1, index.parent().parent());
 			emit dataChanged(parentIndex, parentIndex);
+			emit parameterChanged();
 		}
 		return true;
 	}
@@ -157,6 +207,7 @@ bool ParameterModel::setData(const QModelIndex &index, const QVariant &value, in
 		if( param->value() != value ) {
 			param->setValue(value);
 			emit dataChanged(index, index);
+			emit parameterChanged();
 		}
 		return true;
 	}
@@ -166,6 +217,7 @@ bool ParameterModel::setData(const QModelIndex &index, const QVariant &value, in
 void ParameterModel::clear()
 {
 	m_effect = NULL;
+	m_items.clear();
 	reset();
 }
 
@@ -173,29 +225,91 @@ void ParameterModel::setEffect(Effect * effect)
 {
 	Q_ASSERT(effect != NULL);
 	m_effect = effect;
+	buildItems();
 	reset();
 }
 
 Parameter* ParameterModel::parameter(const QModelIndex& index) const
 {
-	if (isParameter(index)) {
-		Q_ASSERT(index.row() < m_effect->parameterCount());	
-		return m_effect->parameterAt(index.row());
+	const int idx = parameterIndex(index);
+	if (idx == -1) {
+		return NULL;
 	}
-	else {
-		Q_ASSERT(index.internalId() < m_effect->parameterCount()); 
-		return m_effect->parameterAt(index.internalId());
+	Q_ASSERT(idx < m_effect->parameterCount());
+	return m_effect->parameterAt(idx);
+}
+
+// Parameters of effects that can be specialized have a check box to freeze them.
+bool ParameterModel::canFreeze(const QModelIndex &index) const
+{
+	return isParameter(index) && m_effect->canSpecialize() && parameter(index)->canFreeze();
+}
+
+bool ParameterModel::isGroup(const QModelIndex &index) const
+{
+	return index.internalId() == -1 && !m_items.at(index.row()).group.isEmpty();
+}
+
+bool ParameterModel::isParameter(const QModelIndex &index) const
+{
+	const int id = index.internalId();
+	if (id == -1) {
+		return m_items.at(index.row()).group.isEmpty();
 	}
+	return subRow(id) == -1 && !m_items.at(topRow(id)).group.isEmpty();
+}
+
+bool ParameterModel::isComponent(const QModelIndex &index) const
+{
+	return !isGroup(index) && !isParameter(index);
 }
 
-// static
-bool ParameterModel::isParameter(const QModelIndex &index)
+// Group parameters by name, in order of first appearance.
+void ParameterModel::buildItems()
 {
-	return index.internalId() == -1;
+	m_items.clear();
+	
+	const int count = m_effect->parameterCount();
+	for (int i = 0; i < count; i++) {
+		const QString & group = m_effect->parameterAt(i)->group();
+		
+		int item = -1;
+		if (!group.isEmpty()) {
+			for (int g = 0; g < m_items.count(); g++) {
+				if (m_items.at(g).group == group) {
+					item = g;
+					break;
+				}
+			}
+		}
+		
+		if (item == -1) {
+			Item newItem;
+			newItem.group = group;
+			m_items.append(newItem);
+			item = m_items.count() - 1;
+		}
+		m_items[item].parameters.append(i);
+	}
 }
 
-// static
-bool ParameterModel::isComponent(const QModelIndex &index)
+// Index of the parameter the given item belongs to, -1 for groups.
+int ParameterModel::parameterIndex(const QModelIndex &index) const
 {
-	return index.internalId() != -1;
+	const int id = index.internalId();
+	if (id == -1) {
+		const Item & item = m_items.at(index.row());
+		return item.group.isEmpty() ? item.parameters.at(0) : -1;
+	}
+	
+	const Item & item = m_items.at(topRow(id));
+	if (subRow(id) != -1) {
+		// Component of a grouped parameter.
+		return item.parameters.at(subRow(id));
+	}
+	if (item.group.isEmpty()) {
+		// Component of a top level parameter.
+		return item.parameters.at(0);
+	}
+	return item.parameters.at(index.row());
 }
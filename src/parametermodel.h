@@ -52,11 +52,30 @@ public:
 	
 	// Helper methods.
 	bool isEditable(const QModelIndex &index) const;
-	static bool isParameter(const QModelIndex &index);
-	static bool isComponent(const QModelIndex &index);
+	bool isGroup(const QModelIndex &index) const;
+	bool isParameter(const QModelIndex &index) const;
+	bool isComponent(const QModelIndex &index) const;
+	bool canFreeze(const QModelIndex &index) const;
+	
+signals:
+	// Edited values are saved with the document, frozen parameters only change how it renders.
+	void parameterChanged();
+	void freezeChanged();
+	
+private:
+	void buildItems();
+	int parameterIndex(const QModelIndex &index) const;
+	
+	// Top level item, either a single parameter or a named group of parameters.
+	struct Item
+	{
+		QString group;
+		QList<int> parameters;
+	};
 	
 private:
 	Effect* m_effect;
+	QList<Item> m_items;
 };
 
 #endif // PARAMETERMODEL_H
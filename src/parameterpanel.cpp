@@ -22,6 +22,7 @@
 #include "effect.h"
 #include "parametermodel.h"
 #include "parameterdelegate.h"
+#include "texmanager.h"
 
 #include <QtGui/QHeaderView>
 
@@ -61,7 +62,8 @@ bool ParameterPanel::isEditorActive() const
 void ParameterPanel::initWidget()
 {
 	m_model = new ParameterModel(this);
-	connect(m_model, SIGNAL(dataChanged(QModelIndex, QModelIndex)), this, SIGNAL(parameterChanged()));
+	connect(m_model, SIGNAL(parameterChanged()), this, SIGNAL(parameterChanged()));
+	connect(m_model, SIGNAL(freezeChanged()), this, SIGNAL(freezeChanged()));
 
 	m_delegate = new ParameterDelegate(this);
 
@@ -77,6 +79,9 @@ void ParameterPanel::initWidget()
 	//	m_view->setIndentation(0);	// @@ This would be nice if it didn't affect the roots.
 
 	setWidget(m_view);
+	
+	// Update the texture icons when the images are loaded.
+	connect(TextureLoader::instance(), SIGNAL(loaded(QString)), m_view->viewport(), SLOT(update()));
 }
 
 void ParameterPanel::setEffect(Effect * effect)
@@ -47,6 +47,7 @@ public:
 	
 signals:
 	void parameterChanged();
+	void freezeChanged();
 
 public slots:
 	void setEffect(Effect * effect);
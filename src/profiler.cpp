@@ -0,0 +1,373 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "profiler.h"
+#include "glutils.h"
+
+#include <QtCore/QtAlgorithms>
+
+namespace
+{
+#if defined(GL_ARB_pipeline_statistics_query)
+	// Query targets in the order of FrameProfiler::Statistic.
+	static const GLenum s_statisticTargets[FrameProfiler::StatisticCount] = {
+		GL_VERTEX_SHADER_INVOCATIONS_ARB,
+		GL_PRIMITIVES_SUBMITTED_ARB,
+		GL_CLIPPING_OUTPUT_PRIMITIVES_ARB,
+		GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+	};
+#endif
+
+	// Counters wrap at 2^32 without the 64 bit results of the timer query extensions.
+	static quint64 queryResult(GLuint query)
+	{
+#if defined(GL_ARB_timer_query)
+		if (GLEW_ARB_timer_query) {
+			GLuint64 result = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+			return result;
+		}
+#endif
+		if (GLEW_EXT_timer_query) {
+			GLuint64EXT result = 0;
+			glGetQueryObjectui64vEXT(query, GL_QUERY_RESULT, &result);
+			return result;
+		}
+
+		GLuint result = 0;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT, &result);
+		return result;
+	}
+
+	static bool isQueryAvailable(GLuint query)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		return available != 0;
+	}
+
+} // namespace
+
+
+FrameProfiler::FrameProfiler() :
+	m_frameIndex(0),
+	m_passCount(0),
+	m_pass(-1),
+	m_passStart(0),
+	m_initialized(false),
+	m_timerQuery(false),
+	m_countFragments(false),
+	m_statisticsQuery(false)
+{
+}
+
+FrameProfiler::~FrameProfiler()
+{
+	// The owner must make the context current.
+	for (int i = 0; i < FrameLatency; i++) {
+		if (!m_frames[i].queries.isEmpty()) {
+			glDeleteQueries(m_frames[i].queries.count(), m_frames[i].queries.data());
+		}
+		if (!m_frames[i].sampleQueries.isEmpty()) {
+			glDeleteQueries(m_frames[i].sampleQueries.count(), m_frames[i].sampleQueries.data());
+		}
+		if (!m_frames[i].statisticQueries.isEmpty()) {
+			glDeleteQueries(m_frames[i].statisticQueries.count(), m_frames[i].statisticQueries.data());
+		}
+	}
+}
+
+//static
+bool FrameProfiler::isGpuTimingSupported()
+{
+#if defined(GL_ARB_timer_query)
+	if (GLEW_ARB_timer_query) {
+		return true;
+	}
+#endif
+	return GLEW_EXT_timer_query != 0;
+}
+
+//static
+bool FrameProfiler::isFragmentCountSupported()
+{
+	return GLEW_VERSION_1_5 || GLEW_ARB_occlusion_query;
+}
+
+//static
+bool FrameProfiler::isPipelineStatisticsSupported()
+{
+#if defined(GL_ARB_pipeline_statistics_query)
+	return GLEW_ARB_pipeline_statistics_query != 0;
+#else
+	return false;
+#endif
+}
+
+void FrameProfiler::beginFrame(int passCount)
+{
+	if (!m_initialized) {
+		m_timerQuery = isGpuTimingSupported();
+		m_statisticsQuery = isPipelineStatisticsSupported();
+		m_initialized = true;
+	}
+
+	m_frameIndex = (m_frameIndex + 1) % FrameLatency;
+	Frame & frame = m_frames[m_frameIndex];
+
+	// Read the results of the frame that used these queries before.
+	if (frame.pending) {
+		collect(frame);
+	}
+
+	if (passCount != m_passCount) {
+		m_passCount = passCount;
+		clear();
+	}
+
+	frame.passCount = passCount;
+	frame.counting = m_countFragments;
+
+	if (m_timerQuery && frame.queries.count() < passCount) {
+		const int count = frame.queries.count();
+		frame.queries.resize(passCount);
+		glGenQueries(passCount - count, frame.queries.data() + count);
+	}
+
+	if (frame.counting && frame.sampleQueries.count() < passCount) {
+		const int count = frame.sampleQueries.count();
+		frame.sampleQueries.resize(passCount);
+		glGenQueries(passCount - count, frame.sampleQueries.data() + count);
+	}
+
+	if (m_statisticsQuery && frame.statisticQueries.count() < passCount * StatisticCount) {
+		const int count = frame.statisticQueries.count();
+		frame.statisticQueries.resize(passCount * StatisticCount);
+		glGenQueries(passCount * StatisticCount - count, frame.statisticQueries.data() + count);
+	}
+}
+
+void FrameProfiler::beginPass(int pass)
+{
+	Q_ASSERT(pass >= 0 && pass < m_passCount);
+
+	m_pass = pass;
+	m_passStart = microseconds();
+
+	if (m_timerQuery) {
+		glBeginQuery(GL_TIME_ELAPSED_EXT, m_frames[m_frameIndex].queries.at(pass));
+	}
+	if (m_frames[m_frameIndex].counting) {
+		glBeginQuery(GL_SAMPLES_PASSED, m_frames[m_frameIndex].sampleQueries.at(pass));
+	}
+#if defined(GL_ARB_pipeline_statistics_query)
+	if (m_statisticsQuery) {
+		for (int s = 0; s < StatisticCount; s++) {
+			glBeginQuery(s_statisticTargets[s], m_frames[m_frameIndex].statisticQueries.at(pass * StatisticCount + s));
+		}
+	}
+#endif
+}
+
+void FrameProfiler::endPass()
+{
+	Q_ASSERT(m_pass != -1);
+
+	if (m_timerQuery) {
+		glEndQuery(GL_TIME_ELAPSED_EXT);
+	}
+	if (m_frames[m_frameIndex].counting) {
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+#if defined(GL_ARB_pipeline_statistics_query)
+	if (m_statisticsQuery) {
+		for (int s = 0; s < StatisticCount; s++) {
+			glEndQuery(s_statisticTargets[s]);
+		}
+	}
+#endif
+
+	append(m_cpuTimes[m_pass], (microseconds() - m_passStart) / 1000.0);
+	m_pass = -1;
+}
+
+void FrameProfiler::endFrame()
+{
+	Frame & frame = m_frames[m_frameIndex];
+	frame.pending = (m_timerQuery || m_statisticsQuery || frame.counting) && m_passCount > 0;
+}
+
+void FrameProfiler::poll()
+{
+	// Oldest frames first, the ones after the current frame in the ring.
+	for (int i = 1; i <= FrameLatency; i++) {
+		Frame & frame = m_frames[(m_frameIndex + i) % FrameLatency];
+		if (frame.pending && isAvailable(frame)) {
+			collect(frame);
+		}
+	}
+}
+
+void FrameProfiler::clear()
+{
+	for (int i = 0; i < FrameLatency; i++) {
+		m_frames[i].pending = false;
+	}
+
+	m_cpuTimes.clear();
+	m_gpuTimes.clear();
+	m_cpuTimes.resize(m_passCount);
+	m_gpuTimes.resize(m_passCount);
+	m_fragments.fill(0, m_passCount);
+	m_statistics.fill(0, m_passCount * StatisticCount);
+}
+
+void FrameProfiler::setFragmentCounting(bool enable)
+{
+	m_countFragments = enable && isFragmentCountSupported();
+	m_fragments.fill(0, m_passCount);
+}
+
+bool FrameProfiler::isFragmentCounting() const
+{
+	return m_countFragments;
+}
+
+bool FrameProfiler::hasGpuTimes() const
+{
+	return m_timerQuery;
+}
+
+bool FrameProfiler::hasPipelineStatistics() const
+{
+	return m_statisticsQuery;
+}
+
+int FrameProfiler::passCount() const
+{
+	return m_passCount;
+}
+
+FrameProfiler::Stats FrameProfiler::cpuStats(int pass) const
+{
+	Q_ASSERT(pass >= 0 && pass < m_passCount);
+	return stats(m_cpuTimes.at(pass));
+}
+
+FrameProfiler::Stats FrameProfiler::gpuStats(int pass) const
+{
+	Q_ASSERT(pass >= 0 && pass < m_passCount);
+	return stats(m_gpuTimes.at(pass));
+}
+
+quint64 FrameProfiler::fragmentCount(int pass) const
+{
+	Q_ASSERT(pass >= 0 && pass < m_passCount);
+	return m_fragments.at(pass);
+}
+
+quint64 FrameProfiler::statistic(int pass, Statistic statistic) const
+{
+	Q_ASSERT(pass >= 0 && pass < m_passCount);
+	Q_ASSERT(statistic >= 0 && statistic < StatisticCount);
+	return m_statistics.at(pass * StatisticCount + statistic);
+}
+
+quint64 FrameProfiler::totalFragmentCount() const
+{
+	quint64 total = 0;
+	foreach (quint64 count, m_fragments) {
+		total += count;
+	}
+	return total;
+}
+
+void FrameProfiler::collect(Frame & frame)
+{
+	frame.pending = false;
+
+	for (int i = 0; i < frame.passCount && i < m_passCount; i++)
+	{
+		// Drop the results that are not ready yet instead of waiting for them.
+		if (m_timerQuery && isQueryAvailable(frame.queries.at(i))) {
+			append(m_gpuTimes[i], queryResult(frame.queries.at(i)) / 1000000.0);
+		}
+
+		if (frame.counting && isQueryAvailable(frame.sampleQueries.at(i))) {
+			m_fragments[i] = queryResult(frame.sampleQueries.at(i));
+		}
+
+		if (m_statisticsQuery) {
+			for (int s = 0; s < StatisticCount; s++) {
+				const GLuint query = frame.statisticQueries.at(i * StatisticCount + s);
+				if (isQueryAvailable(query)) {
+					m_statistics[i * StatisticCount + s] = queryResult(query);
+				}
+			}
+		}
+	}
+}
+
+// Queries complete in order, so the last query of the frame tells whether all of them are done.
+bool FrameProfiler::isAvailable(const Frame & frame) const
+{
+	const int last = qMin(frame.passCount, m_passCount) - 1;
+	if (last < 0) {
+		return true;
+	}
+	if (m_statisticsQuery) {
+		return isQueryAvailable(frame.statisticQueries.at(last * StatisticCount + StatisticCount - 1));
+	}
+	if (frame.counting) {
+		return isQueryAvailable(frame.sampleQueries.at(last));
+	}
+	return !m_timerQuery || isQueryAvailable(frame.queries.at(last));
+}
+
+//static
+void FrameProfiler::append(QList<double> & history, double time)
+{
+	history.append(time);
+	if (history.count() > HistorySize) {
+		history.removeFirst();
+	}
+}
+
+//static
+FrameProfiler::Stats FrameProfiler::stats(const QList<double> & history)
+{
+	Stats s;
+	if (history.isEmpty()) {
+		return s;
+	}
+
+	QList<double> sorted = history;
+	qSort(sorted);
+
+	double sum = 0;
+	foreach (double t, sorted) {
+		sum += t;
+	}
+
+	s.count = sorted.count();
+	s.min = sorted.first();
+	s.avg = sum / s.count;
+	s.p99 = sorted.at(qBound(0, int(0.99 * s.count + 0.5) - 1, s.count - 1));
+	return s;
+}
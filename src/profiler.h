@@ -0,0 +1,130 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+
+#include <QtCore/QList>
+#include <QtCore/QVector>
+
+
+/// Measures the CPU and GPU time of each pass, the pipeline statistics of
+/// each pass, and optionally counts the fragments that each pass shades.
+/// GPU results are read back a few frames later, so that the queries never
+/// stall the pipeline.
+class FrameProfiler
+{
+public:
+	// Number of frames before the results of a frame are read.
+	enum { FrameLatency = 4 };
+
+	// Counters of GL_ARB_pipeline_statistics_query.
+	enum Statistic
+	{
+		VertexShaderInvocations,
+		PrimitivesSubmitted,
+		ClippingOutputPrimitives,
+		FragmentShaderInvocations,
+		StatisticCount
+	};
+
+	struct Stats
+	{
+		Stats() : min(0), avg(0), p99(0), count(0) {}
+		double min, avg, p99;
+		int count;
+	};
+
+	FrameProfiler();
+	~FrameProfiler();
+
+	static bool isGpuTimingSupported();
+	static bool isFragmentCountSupported();
+	static bool isPipelineStatisticsSupported();
+
+	void beginFrame(int passCount);
+	void beginPass(int pass);
+	void endPass();
+	void endFrame();
+
+	// Collect the frames in flight whose results are ready, without waiting for the others.
+	void poll();
+
+	void clear();
+
+	// Count the samples that pass the depth and stencil tests.
+	void setFragmentCounting(bool enable);
+	bool isFragmentCounting() const;
+
+	bool hasGpuTimes() const;
+	bool hasPipelineStatistics() const;
+	int passCount() const;
+	Stats cpuStats(int pass) const;
+	Stats gpuStats(int pass) const;
+	quint64 fragmentCount(int pass) const;
+	quint64 totalFragmentCount() const;
+	quint64 statistic(int pass, Statistic statistic) const;
+
+private:
+	enum { HistorySize = 128 };
+
+	// Queries of a frame in flight.
+	struct Frame
+	{
+		Frame() : passCount(0), counting(false), pending(false) {}
+		QVector<GLuint> queries;
+		QVector<GLuint> sampleQueries;
+		QVector<GLuint> statisticQueries;
+		int passCount;
+		bool counting;
+		bool pending;
+	};
+
+	void collect(Frame & frame);
+	bool isAvailable(const Frame & frame) const;
+	static void append(QList<double> & history, double time);
+	static Stats stats(const QList<double> & history);
+
+	Frame m_frames[FrameLatency];
+	int m_frameIndex;
+
+	int m_passCount;
+	int m_pass;
+	qint64 m_passStart;
+
+	bool m_initialized;
+	bool m_timerQuery;
+	bool m_countFragments;
+	bool m_statisticsQuery;
+
+	// Recent times of each pass, in milliseconds.
+	QVector< QList<double> > m_cpuTimes;
+	QVector< QList<double> > m_gpuTimes;
+
+	// Fragments of each pass in the latest collected frame.
+	QVector<quint64> m_fragments;
+
+	// Pipeline statistics of each pass in the latest collected frame.
+	QVector<quint64> m_statistics;
+};
+
+
+#endif // PROFILER_H
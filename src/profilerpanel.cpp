@@ -0,0 +1,128 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "profilerpanel.h"
+#include "profiler.h"
+
+#include <QtCore/QTimer>
+#include <QtGui/QHeaderView>
+#include <QtGui/QTreeWidget>
+
+namespace
+{
+	static QString formatTime(const FrameProfiler::Stats & stats, double value)
+	{
+		if (stats.count == 0) {
+			return "-";
+		}
+		return QString::number(value, 'f', 3);
+	}
+
+	static QString formatCount(const FrameProfiler * profiler, int pass, FrameProfiler::Statistic statistic)
+	{
+		if (!profiler->hasPipelineStatistics()) {
+			return "-";
+		}
+		return QString::number(profiler->statistic(pass, statistic));
+	}
+
+} // namespace
+
+
+ProfilerPanel::ProfilerPanel(const QString & title, QWidget * parent /*= 0*/, Qt::WFlags flags /*= 0*/) :
+	QDockWidget(title, parent, flags), m_profiler(NULL)
+{
+	m_tree = new QTreeWidget(this);
+	m_tree->setRootIsDecorated(false);
+	m_tree->setAlternatingRowColors(true);
+	m_tree->setHeaderLabels(QStringList()
+		<< tr("Pass")
+		<< tr("CPU min") << tr("CPU avg") << tr("CPU p99")
+		<< tr("GPU min") << tr("GPU avg") << tr("GPU p99")
+		<< tr("VS invocations") << tr("Primitives") << tr("Clipped primitives") << tr("FS invocations"));
+	m_tree->header()->setResizeMode(QHeaderView::ResizeToContents);
+	setWidget(m_tree);
+
+	// Times are in milliseconds, counts are of the latest frame.
+	setToolTip(tr("Frame times in milliseconds and pipeline statistics of the latest frame"));
+
+	m_timer = new QTimer(this);
+	connect(m_timer, SIGNAL(timeout()), this, SLOT(refresh()));
+	m_timer->start(500);
+}
+
+ProfilerPanel::~ProfilerPanel()
+{
+}
+
+void ProfilerPanel::setProfiler(const FrameProfiler * profiler)
+{
+	m_profiler = profiler;
+	refresh();
+}
+
+void ProfilerPanel::setTechnique(const QString & name)
+{
+	m_technique = name;
+	refresh();
+}
+
+QSize ProfilerPanel::sizeHint() const
+{
+	return QSize(200, 100);
+}
+
+void ProfilerPanel::refresh()
+{
+	if (!isVisible()) {
+		return;
+	}
+
+	emit aboutToRefresh();
+
+	m_tree->clear();
+
+	if (m_profiler == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < m_profiler->passCount(); i++)
+	{
+		const FrameProfiler::Stats cpu = m_profiler->cpuStats(i);
+		const FrameProfiler::Stats gpu = m_profiler->gpuStats(i);
+
+		QTreeWidgetItem * item = new QTreeWidgetItem(m_tree);
+		if (m_technique.isEmpty()) {
+			item->setText(0, QString::number(i + 1));
+		}
+		else {
+			item->setText(0, QString("%1 / %2").arg(m_technique).arg(i + 1));
+		}
+		item->setText(1, formatTime(cpu, cpu.min));
+		item->setText(2, formatTime(cpu, cpu.avg));
+		item->setText(3, formatTime(cpu, cpu.p99));
+		item->setText(4, formatTime(gpu, gpu.min));
+		item->setText(5, formatTime(gpu, gpu.avg));
+		item->setText(6, formatTime(gpu, gpu.p99));
+		item->setText(7, formatCount(m_profiler, i, FrameProfiler::VertexShaderInvocations));
+		item->setText(8, formatCount(m_profiler, i, FrameProfiler::PrimitivesSubmitted));
+		item->setText(9, formatCount(m_profiler, i, FrameProfiler::ClippingOutputPrimitives));
+		item->setText(10, formatCount(m_profiler, i, FrameProfiler::FragmentShaderInvocations));
+	}
+}
@@ -0,0 +1,65 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef PROFILERPANEL_H
+#define PROFILERPANEL_H
+
+#include <QtGui/QDockWidget>
+
+class QTimer;
+class QTreeWidget;
+
+class FrameProfiler;
+
+
+class ProfilerPanel : public QDockWidget
+{
+	Q_OBJECT
+public:
+
+	ProfilerPanel(const QString & title, QWidget * parent = 0, Qt::WFlags flags = 0);
+	~ProfilerPanel();
+
+	void setProfiler(const FrameProfiler * profiler);
+
+	// Name of the technique that the passes belong to.
+	void setTechnique(const QString & name);
+
+	virtual QSize sizeHint() const;
+
+public slots:
+
+	void refresh();
+
+signals:
+
+	// Emitted before the results are shown, so that the view can collect the frames in flight.
+	void aboutToRefresh();
+
+private:
+
+	const FrameProfiler * m_profiler;
+	QString m_technique;
+	QTreeWidget * m_tree;
+	QTimer * m_timer;
+
+};
+
+
+#endif // PROFILERPANEL_H
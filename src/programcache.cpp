@@ -0,0 +1,211 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "programcache.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtGui/QDesktopServices>
+
+#if defined(Q_OS_WIN)
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+namespace
+{
+	static qint64 s_maxSize = 32 * 1024 * 1024;
+
+	// Builds can run on the builder threads.
+	static QMutex s_mutex;
+
+	static QString cacheDir()
+	{
+		QString path = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+		if (path.isEmpty()) {
+			path = QDir::temp().filePath("qshaderedit");
+		}
+		return path + "/programs";
+	}
+
+	static QString cacheFile(const QByteArray & key)
+	{
+		return cacheDir() + "/" + key + ".bin";
+	}
+
+	static bool writeFile(const QString & fileName, quint32 format, const QByteArray & binary)
+	{
+		QFile file(fileName);
+		if (!file.open(QIODevice::WriteOnly)) {
+			return false;
+		}
+
+		QDataStream stream(&file);
+		stream << format << binary;
+		return stream.status() == QDataStream::Ok;
+	}
+
+	// Set the modification time to now, eviction removes the oldest files first.
+	static void touchFile(const QString & fileName)
+	{
+#if defined(Q_OS_WIN)
+		_wutime((const wchar_t *)fileName.utf16(), NULL);
+#else
+		utime(QFile::encodeName(fileName).constData(), NULL);
+#endif
+	}
+
+	// Remove the least recently used binaries until the cache fits its size.
+	static void evict()
+	{
+		QDir dir(cacheDir());
+		QFileInfoList files = dir.entryInfoList(QStringList() << "*.bin", QDir::Files, QDir::Time);
+
+		qint64 size = 0;
+		foreach (const QFileInfo & info, files) {
+			size += info.size();
+			if (size > s_maxSize) {
+				dir.remove(info.fileName());
+			}
+		}
+	}
+
+} // namespace
+
+
+bool ProgramCache::isSupported()
+{
+#if defined(GL_ARB_get_program_binary)
+	if (!GLEW_ARB_get_program_binary) {
+		return false;
+	}
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	return formatCount > 0 && s_maxSize > 0;
+#else
+	return false;
+#endif
+}
+
+QByteArray ProgramCache::key(const QList<QByteArray> & sources)
+{
+	QCryptographicHash hash(QCryptographicHash::Md5);
+
+	hash.addData((const char *)glGetString(GL_VENDOR));
+	hash.addData((const char *)glGetString(GL_RENDERER));
+	hash.addData((const char *)glGetString(GL_VERSION));
+
+	foreach (const QByteArray & source, sources) {
+		// Hash the length too, so that moving text between inputs changes the key.
+		hash.addData(QByteArray::number(source.length()));
+		hash.addData(source);
+	}
+
+	return hash.result().toHex();
+}
+
+bool ProgramCache::load(const QByteArray & key, GLuint program)
+{
+#if defined(GL_ARB_get_program_binary)
+	QMutexLocker locker(&s_mutex);
+
+	const QString fileName = cacheFile(key);
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	quint32 format = 0;
+	QByteArray binary;
+
+	QDataStream stream(&file);
+	stream >> format >> binary;
+	file.close();
+
+	if (stream.status() != QDataStream::Ok || binary.isEmpty()) {
+		QFile::remove(fileName);
+		return false;
+	}
+
+	glProgramBinary(program, format, binary.constData(), binary.size());
+
+	GLint linkSucceed = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linkSucceed);
+	if (linkSucceed == GL_FALSE) {
+		// The driver rejected the binary, do not try it again.
+		QFile::remove(fileName);
+		return false;
+	}
+
+	// Mark the entry as recently used.
+	touchFile(fileName);
+
+	return true;
+#else
+	Q_UNUSED(key);
+	Q_UNUSED(program);
+	return false;
+#endif
+}
+
+void ProgramCache::store(const QByteArray & key, GLuint program)
+{
+#if defined(GL_ARB_get_program_binary)
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+
+	QByteArray binary(length, 0);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, NULL, &format, binary.data());
+
+	QMutexLocker locker(&s_mutex);
+
+	if (!QDir().mkpath(cacheDir())) {
+		return;
+	}
+
+	if (writeFile(cacheFile(key), format, binary)) {
+		evict();
+	}
+#else
+	Q_UNUSED(key);
+	Q_UNUSED(program);
+#endif
+}
+
+qint64 ProgramCache::maxSize()
+{
+	return s_maxSize;
+}
+
+void ProgramCache::setMaxSize(qint64 size)
+{
+	s_maxSize = size;
+}
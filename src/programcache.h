@@ -0,0 +1,48 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <GL/glew.h>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+
+
+// Persistent cache of linked program binaries.
+namespace ProgramCache
+{
+	bool isSupported();
+
+	// Key for the given sources on the current GL driver.
+	QByteArray key(const QList<QByteArray> & sources);
+
+	// Restore the program from the cache, returns false on a miss.
+	bool load(const QByteArray & key, GLuint program);
+
+	// Store the binary of a linked program.
+	void store(const QByteArray & key, GLuint program);
+
+	qint64 maxSize();
+	void setMaxSize(qint64 size);
+};
+
+
+#endif // PROGRAMCACHE_H
@@ -24,24 +24,60 @@
 #include "texmanager.h"
 #include "scene.h"
 #include "glutils.h"
+#include "transform.h"
+#include "glstate.h"
+#include "capture.h"
 
 #include <QtCore/QUrl>
+#include <QtCore/QTimer>
 #include <QtGui/QMouseEvent>
 #include <QtGui/QWheelEvent>
+#include <QtOpenGL/QGLFramebufferObject>
 
 
 SceneView::SceneView(QWidget * parent, QGLWidget * shareWidget) : QGLWidget(parent, shareWidget),
+	m_button(Qt::NoButton),
 	m_effect(NULL), 
 	m_scene(NULL), 
 	m_wireframe(false), 
-	m_ortho(false)
+	m_ortho(false),
+	m_showTimings(false),
+	m_savedStateCalls(0),
+	m_animated(false),
+	m_matricesDirty(false),
+	m_progressive(false),
+	m_progressiveRestart(true),
+	m_nextTile(0),
+	m_fbo(NULL),
+	m_dynamicResolution(false),
+	m_interacting(false),
+	m_scaleLevel(0),
+	m_scaledFbo(NULL),
+	m_overdraw(false),
+	m_overdrawFrames(0)
 {
 	setAutoBufferSwap(false);
+	
+	m_frameTimer = new QTimer(this);
+	m_frameTimer->setSingleShot(true);
+	connect(m_frameTimer, SIGNAL(timeout()), this, SLOT(onFrameTimeout()));
+	
+	m_interactionTimer = new QTimer(this);
+	m_interactionTimer->setSingleShot(true);
+	connect(m_interactionTimer, SIGNAL(timeout()), this, SLOT(onInteractionTimeout()));
+	
+	m_capture = new FrameCapture(this);
+	connect(m_capture, SIGNAL(failed(QString)), this, SIGNAL(captureFailed(QString)));
 }
 
 
 SceneView::~SceneView()
 {
+	// The profiler deletes its queries.
+	makeCurrent();
+	delete m_capture;
+	delete m_fbo;
+	delete m_scaledFbo;
 }
 
 
@@ -58,6 +94,8 @@ QSize SceneView::minimumSizeHint() const
 void SceneView::setEffect(Effect * effect)
 {
 	m_effect = effect;
+	m_profiler.clear();
+	m_progressiveRestart = true;
 	if( m_effect != NULL ) {
 		makeCurrent();
 	}
@@ -70,7 +108,7 @@ void SceneView::setScene(Scene * scene)
 	}
 	m_scene = scene;
 	resetTransform();
-	emit updateGL();
+	invalidate();
 }
 
 
@@ -155,75 +193,520 @@ void SceneView::paintGL()
 		return;
 	}
 	
+	m_lastFrame.start();
+	GLState::resetSavedCalls();
+	
+	if( m_matricesDirty )
+	{
+		updateMatrices();
+	}
+	
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 	
+	bool complete = true;
+	
 	if( m_scene != NULL )
 	{
-		if (m_effect != NULL && !m_effect->isBuilding() && m_effect->isValid())
+		if (m_effect != NULL && (!m_effect->isBuilding() || m_effect->buildsInBackground()) && m_effect->isValid())
 		{
-			// Setup ligh parameters @@ Move this to scene->setup() or begin()
-			float light_vector[4] = {1.2f/sqrt(3.08f), 1.0f/sqrt(3.08f), 0.8f/sqrt(3.08f), 0.0f};
-			glLightfv( GL_LIGHT0, GL_POSITION, light_vector );
-			
 			if (m_wireframe) {
-				glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+				GLState::polygonMode(GL_LINE);
 			}
 			else {
-				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+				GLState::polygonMode(GL_FILL);
 			}
 			
-			m_effect->begin();
-			
-			for(int i = 0; i < m_effect->getPassNum(); i++)
-			{
-				m_effect->beginPass(i);
+			if (m_overdraw) {
+				renderOverdraw();
+				
+				if (m_showTimings) {
+					drawTimings();
+				}
+			}
+			else if (m_progressive && QGLFramebufferObject::hasOpenGLFramebufferObjects()) {
+				complete = renderProgressive();
+			}
+			else if (m_dynamicResolution && m_interacting && QGLFramebufferObject::hasOpenGLFramebufferObjects()) {
+				renderScaled();
 				
-				m_scene->draw(m_effect);
+				if (m_showTimings) {
+					drawTimings();
+				}
+			}
+			else {
+				renderEffect(m_effect, m_scene, &m_profiler);
 				
-				m_effect->endPass();
+				if (m_showTimings) {
+					drawTimings();
+				}
 			}
-			
-			m_effect->end();
 		}
 		else
 		{
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			GLState::polygonMode(GL_LINE);
 			m_scene->draw(NULL);
 		}
 	}
 	
+	// Only complete frames are saved.
+	if( complete && m_capture->wantsFrame() )
+	{
+		m_capture->readFrame(size());
+	}
+	
  	swapBuffers();
 	
+	m_savedStateCalls = GLState::savedCalls();
+	
 	//qDebug("paint!");
+	
+	if( !complete )
+	{
+		// Continue with the remaining tiles in the next iteration.
+		scheduleFrame();
+	}
+	else if( m_animated )
+	{
+		invalidate();
+	}
+	else if( m_overdraw && m_overdrawFrames > 0 )
+	{
+		// Keep rendering until the fragment counts of the last change are read back.
+		m_overdrawFrames--;
+		scheduleFrame();
+	}
 }
 
+// Render as many tiles as fit in the time budget, and present the partial image.
+// Returns true when the image is complete.
+bool SceneView::renderProgressive()
+{
+	const int tileSize = 64;
+	const int timeBudget = 25;
+	
+	if( m_fbo == NULL || m_fbo->size() != size() )
+	{
+		delete m_fbo;
+		m_fbo = new QGLFramebufferObject(size(), QGLFramebufferObject::Depth);
+		m_progressiveRestart = true;
+		
+		// Creating the framebuffer binds its texture.
+		GLState::invalidate();
+	}
+	
+	m_fbo->bind();
+	
+	if( m_progressiveRestart )
+	{
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		m_nextTile = 0;
+		m_progressiveRestart = false;
+		
+		// All the tiles of an animated effect show the same instant.
+		m_effect->setTime(m_effect->time());
+	}
+	
+	const int tileCountX = (width() + tileSize - 1) / tileSize;
+	const int tileCountY = (height() + tileSize - 1) / tileSize;
+	const int tileCount = tileCountX * tileCountY;
+	
+	QTime time;
+	time.start();
+	
+	GLState::enable(GL_SCISSOR_TEST);
+	
+	const int firstTile = m_nextTile;
+	int batchSize = 1;
+	
+	while( m_nextTile < tileCount )
+	{
+		const int batchEnd = qMin(m_nextTile + batchSize, tileCount);
+		for( ; m_nextTile < batchEnd; m_nextTile++ )
+		{
+			// Tiles go top to bottom.
+			const int x = (m_nextTile % tileCountX) * tileSize;
+			const int y = height() - (m_nextTile / tileCountX + 1) * tileSize;
+			glScissor(x, y, tileSize, tileSize);
+			
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			renderEffect(m_effect, m_scene);
+		}
+		
+		// Wait for the whole batch, then size the next one to fill the rest of the budget.
+		glFinish();
+		
+		const int elapsed = time.elapsed();
+		if( elapsed >= timeBudget ) {
+			break;
+		}
+		
+		const int done = m_nextTile - firstTile;
+		batchSize = elapsed > 0 ? qMax(1, (timeBudget - elapsed) * done / elapsed) : 4 * batchSize;
+	}
+	
+	GLState::disable(GL_SCISSOR_TEST);
+	
+	m_fbo->release();
+	
+	presentTexture(m_fbo->texture());
+	
+	const bool complete = m_nextTile >= tileCount;
+	if( complete ) {
+		// Follow the clock again.
+		m_effect->setTime(-1.0f);
+	}
+	
+	return complete;
+}
 
-void SceneView::updateMatrices()
+// Render at a fraction of the view resolution while the frame time exceeds the budget.
+void SceneView::renderScaled()
 {
-	makeCurrent();
+	static const float scales[] = { 1.0f, 0.7f, 0.5f, 0.35f, 0.25f };
+	static const int scaleCount = sizeof(scales) / sizeof(scales[0]);
+	const int frameBudget = 33;
+	
+	QTime time;
+	time.start();
+	
+	if( m_scaleLevel == 0 )
+	{
+		renderEffect(m_effect, m_scene, &m_profiler);
+	}
+	else
+	{
+		const QSize scaledSize = (QSizeF(size()) * scales[m_scaleLevel]).toSize().expandedTo(QSize(1, 1));
+		if( m_scaledFbo == NULL || m_scaledFbo->size() != scaledSize )
+		{
+			delete m_scaledFbo;
+			m_scaledFbo = new QGLFramebufferObject(scaledSize, QGLFramebufferObject::Depth);
+			GLState::invalidate();
+		}
+		
+		m_scaledFbo->bind();
+		glViewport(0, 0, scaledSize.width(), scaledSize.height());
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		
+		renderEffect(m_effect, m_scene, &m_profiler);
+		
+		m_scaledFbo->release();
+		glViewport(0, 0, width(), height());
+		
+		// Upscale with bilinear filtering.
+		GLState::bindTexture(0, GL_TEXTURE_2D, m_scaledFbo->texture());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		
+		presentTexture(m_scaledFbo->texture());
+	}
+	
+	glFinish();
+	const int elapsed = time.elapsed();
+	
+	// Lower the resolution when over budget, raise it when the next level fits comfortably.
+	if( elapsed > frameBudget )
+	{
+		m_scaleLevel = qMin(m_scaleLevel + 1, scaleCount - 1);
+	}
+	else if( m_scaleLevel > 0 )
+	{
+		const float ratio = scales[m_scaleLevel - 1] / scales[m_scaleLevel];
+		if( elapsed * ratio * ratio < 0.8f * frameBudget ) {
+			m_scaleLevel--;
+		}
+	}
+}
+
+// Draw the texture over the whole view.
+void SceneView::presentTexture(GLuint texture)
+{
+	GLState::polygonMode(GL_FILL);
+	GLState::disable(GL_DEPTH_TEST);
+	GLState::useProgram(0);
+	
 	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
 	glLoadIdentity();
 	
-	float aspect = float(width())/float(height());
+	glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+	drawTexture(QRectF(-1, -1, 2, 2), texture);
 	
-	if( m_ortho ) {
-		glOrtho(-aspect,aspect, -1,1, -30,30);
-		glScalef(m_z/5, m_z/5, m_z/5);
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	
+	// drawTexture changes the texture state directly.
+	GLState::invalidate();
+	GLState::enable(GL_DEPTH_TEST);
+}
+
+// Render the effect counting the fragments that each pixel shades in the
+// stencil buffer, and replace the image with a heatmap of the counts.
+void SceneView::renderOverdraw()
+{
+	const bool stencil = format().stencil();
+	
+	if( stencil )
+	{
+		GLState::enable(GL_STENCIL_TEST);
+		glStencilFunc(GL_ALWAYS, 0, ~0);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
 	}
-	else {
-		perspective(30, aspect, 0.3, 50);
+	
+	renderEffect(m_effect, m_scene, &m_profiler);
+	
+	if( stencil )
+	{
+		drawHeatmap();
+		GLState::disable(GL_STENCIL_TEST);
 	}
 	
+	drawFragmentCounts();
+}
+
+// Color the pixels by the value of the stencil buffer.
+void SceneView::drawHeatmap()
+{
+	static const float colors[][3] = {
+		{0.0f, 0.0f, 0.0f},
+		{0.0f, 0.0f, 0.6f},
+		{0.0f, 0.5f, 1.0f},
+		{0.0f, 0.8f, 0.0f},
+		{1.0f, 1.0f, 0.0f},
+		{1.0f, 0.5f, 0.0f},
+		{1.0f, 0.0f, 0.0f},
+		{1.0f, 1.0f, 1.0f}
+	};
+	static const int levelCount = sizeof(colors) / sizeof(colors[0]);
+	
+	// The effect may have changed any state.
+	GLState::invalidate();
+	GLState::polygonMode(GL_FILL);
+	GLState::disable(GL_DEPTH_TEST);
+	GLState::disable(GL_BLEND);
+	GLState::useProgram(0);
+	GLState::activeTexture(0);
+	glDisable(GL_TEXTURE_2D);
+	
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
 	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
 	glLoadIdentity();
 	
+	// Each level covers the pixels with at least that many fragments.
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	for( int i = 0; i < levelCount; i++ )
+	{
+		glStencilFunc(GL_LEQUAL, i, ~0);
+		glColor3fv(colors[i]);
+		glRectf(-1, -1, 1, 1);
+	}
+	
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	
+	GLState::enable(GL_DEPTH_TEST);
+}
+
+// Overlay with the fragments shaded by each pass, read a few frames later.
+void SceneView::drawFragmentCounts()
+{
+	GLState::polygonMode(GL_FILL);
+	glColor3f(1.0f, 1.0f, 1.0f);
+	
+	if( !m_profiler.isFragmentCounting() )
+	{
+		renderText(4, height() - 6, tr("Occlusion queries are not supported."));
+		GLState::invalidate();
+		return;
+	}
+	
+	const int passCount = m_profiler.passCount();
+	const double pixelCount = double(width()) * double(height());
+	
+	for( int i = 0; i < passCount; i++ )
+	{
+		renderText(4, height() - 6 - 14 * (passCount - i + 1), tr("Pass %1: %2 fragments").arg(i + 1).arg(m_profiler.fragmentCount(i)));
+	}
+	
+	const quint64 total = m_profiler.totalFragmentCount();
+	renderText(4, height() - 6 - 14, tr("Total: %1 fragments, %2 per pixel").arg(total).arg(total / pixelCount, 0, 'f', 2));
+	
+	if( format().stencil() ) {
+		renderText(4, height() - 6, tr("Fragments per pixel: black 0, blue 1, cyan 2, green 3, yellow 4, orange 5, red 6, white 7+"));
+	}
+	else {
+		renderText(4, height() - 6, tr("No stencil buffer, the heatmap is not available."));
+	}
+	
+	GLState::invalidate();
+}
+
+void SceneView::invalidate()
+{
+	m_progressiveRestart = true;
+	m_overdrawFrames = FrameProfiler::FrameLatency;
+	scheduleFrame();
+}
+
+void SceneView::scheduleFrame()
+{
+	if( m_frameTimer->isActive() )
+	{
+		return;
+	}
+	
+	// Do not render faster than the display refresh.
+	const int frameInterval = 16;
+	int delay = 0;
+	if( !m_lastFrame.isNull() )
+	{
+		delay = qMax(0, frameInterval - m_lastFrame.elapsed());
+	}
+	m_frameTimer->start(delay);
+}
+
+void SceneView::setAnimated(bool b)
+{
+	m_animated = b;
+	if( m_animated )
+	{
+		invalidate();
+	}
+}
+
+void SceneView::onFrameTimeout()
+{
+	updateGL();
+}
+
+// Use the dynamic resolution until the interaction stops.
+void SceneView::interact()
+{
+	m_interacting = true;
+	m_interactionTimer->start(300);
+}
+
+void SceneView::onInteractionTimeout()
+{
+	if( m_button != Qt::NoButton )
+	{
+		// Still dragging.
+		m_interactionTimer->start(300);
+		return;
+	}
+	
+	// Snap back to full resolution.
+	m_interacting = false;
+	invalidate();
+}
+
+
+//static
+void SceneView::renderEffect(Effect * effect, const Scene * scene, FrameProfiler * profiler /*= NULL*/)
+{
+	Q_ASSERT(effect != NULL);
+	Q_ASSERT(scene != NULL);
+	
+	// Setup ligh parameters @@ Move this to scene->setup() or begin()
+	float light_vector[4] = {1.2f/sqrt(3.08f), 1.0f/sqrt(3.08f), 0.8f/sqrt(3.08f), 0.0f};
+	glLightfv( GL_LIGHT0, GL_POSITION, light_vector );
+	
+	const int passCount = effect->getPassNum();
+	if (profiler != NULL) {
+		profiler->beginFrame(passCount);
+	}
+	
+	effect->begin();
+	
+	for(int i = 0; i < passCount; i++)
+	{
+		if (profiler != NULL) {
+			profiler->beginPass(i);
+		}
+		
+		effect->beginPass(i);
+		
+		scene->draw(effect);
+		
+		effect->endPass();
+		
+		if (profiler != NULL) {
+			profiler->endPass();
+		}
+	}
+	
+	effect->end();
+	
+	if (profiler != NULL) {
+		profiler->endFrame();
+	}
+}
+
+// Overlay with the average time of each pass.
+void SceneView::drawTimings()
+{
+	GLState::polygonMode(GL_FILL);
+	glColor3f(1.0f, 1.0f, 0.0f);
+	
+	for (int i = 0; i < m_profiler.passCount(); i++)
+	{
+		QString text = tr("Pass %1: CPU %2 ms").arg(i + 1).arg(m_profiler.cpuStats(i).avg, 0, 'f', 2);
+		if (m_profiler.hasGpuTimes()) {
+			text += tr("  GPU %1 ms").arg(m_profiler.gpuStats(i).avg, 0, 'f', 2);
+		}
+		renderText(4, 14 * (i + 1), text);
+	}
+	
+	// Counted on the previous frame.
+	renderText(4, 14 * (m_profiler.passCount() + 1), tr("Redundant GL calls skipped: %1").arg(m_savedStateCalls));
+	
+	GLState::invalidate();
+}
+
+
+void SceneView::updateMatrices()
+{
+	m_matricesDirty = false;
+	
+	makeCurrent();
+	
+	Transform::load(modelViewMatrix(), projectionMatrix(float(width())/float(height())));
+}
+
+Matrix4 SceneView::projectionMatrix(float aspect) const
+{
+	Matrix4 projection;
+	if( m_ortho ) {
+		projection = Matrix4::ortho(-aspect,aspect, -1,1, -30,30);
+		projection.scale(m_z/5, m_z/5, m_z/5);
+	}
+	else {
+		projection = Matrix4::perspective(30, aspect, 0.3f, 50);
+	}
+	return projection;
+}
+
+Matrix4 SceneView::modelViewMatrix() const
+{
 	// World transform:
-	gluLookAt(m_x, m_y, m_z, m_x, m_y, m_z-1, 0, 1, 0);
-	glRotatef(m_beta, 1, 0, 0);
-	glRotatef(m_alpha, 0, 1, 0);
+	Matrix4 modelView = Matrix4::lookAt(m_x, m_y, m_z, m_x, m_y, m_z-1, 0, 1, 0);
+	modelView.rotate(m_beta, 1, 0, 0);
+	modelView.rotate(m_alpha, 0, 1, 0);
 	
 	// Object transform:
-	m_scene->transform();
+	if( m_scene != NULL ) {
+		modelView = modelView * m_scene->transform();
+	}
+	return modelView;
 }
 
 
@@ -231,6 +714,7 @@ void SceneView::mousePressEvent(QMouseEvent *event)
 {
 	m_pos = event->pos();
 	m_button = event->button();
+	interact();
 }
 
 void SceneView::mouseMoveEvent(QMouseEvent *event)
@@ -258,8 +742,9 @@ void SceneView::mouseMoveEvent(QMouseEvent *event)
 
 	m_pos = pos;
 
-	updateMatrices();
-	emit updateGL();
+	m_matricesDirty = true;
+	interact();
+	invalidate();
 }
 
 void SceneView::mouseReleaseEvent(QMouseEvent *event)
@@ -271,8 +756,9 @@ void SceneView::mouseReleaseEvent(QMouseEvent *event)
 void SceneView::wheelEvent(QWheelEvent *e)
 {
 	m_z += (m_z * e->delta()/120.0)/20.0;
-	updateMatrices();
-	emit updateGL();
+	m_matricesDirty = true;
+	interact();
+	invalidate();
 }
 
 void SceneView::resetTransform()
@@ -293,7 +779,7 @@ bool SceneView::isWireframe() const
 void SceneView::setWireframe(bool b)
 {
 	m_wireframe = b;
-	emit updateGL();
+	invalidate();
 }
 
 bool SceneView::isOrtho() const
@@ -301,9 +787,119 @@ bool SceneView::isOrtho() const
 	return m_ortho;
 }
 
+bool SceneView::isTimingsVisible() const
+{
+	return m_showTimings;
+}
+
+bool SceneView::isProgressive() const
+{
+	return m_progressive;
+}
+
+void SceneView::setProgressive(bool b)
+{
+	m_progressive = b;
+	if( !m_progressive )
+	{
+		makeCurrent();
+		delete m_fbo;
+		m_fbo = NULL;
+		
+		// Release the time of an unfinished image.
+		if( m_effect != NULL ) {
+			m_effect->setTime(-1.0f);
+		}
+	}
+	invalidate();
+}
+
+bool SceneView::isDynamicResolution() const
+{
+	return m_dynamicResolution;
+}
+
+void SceneView::setDynamicResolution(bool b)
+{
+	m_dynamicResolution = b;
+	m_scaleLevel = 0;
+	if( !m_dynamicResolution )
+	{
+		makeCurrent();
+		delete m_scaledFbo;
+		m_scaledFbo = NULL;
+	}
+	invalidate();
+}
+
+bool SceneView::isOverdraw() const
+{
+	return m_overdraw;
+}
+
+void SceneView::setOverdraw(bool b)
+{
+	m_overdraw = b;
+	makeCurrent();
+	m_profiler.setFragmentCounting(b);
+	invalidate();
+}
+
+void SceneView::setTimingsVisible(bool b)
+{
+	m_showTimings = b;
+	invalidate();
+}
+
+const FrameProfiler * SceneView::profiler() const
+{
+	return &m_profiler;
+}
+
+void SceneView::pollProfiler()
+{
+	if( !isValid() ) {
+		return;
+	}
+	makeCurrent();
+	m_profiler.poll();
+}
+
+void SceneView::saveScreenshot(const QString & fileName)
+{
+	m_capture->saveScreenshot(fileName);
+	invalidate();
+}
+
+void SceneView::startCapture(const QString & fileName)
+{
+	m_capture->startCapture(fileName);
+	invalidate();
+}
+
+void SceneView::stopCapture()
+{
+	m_capture->stopCapture();
+}
+
+bool SceneView::exportSequence(SequenceExporter * exporter, const SequenceExporter::Options & options)
+{
+	const QSize size = options.size;
+	const bool succeed = exporter->run(m_effect, m_scene, modelViewMatrix(), projectionMatrix(float(size.width())/float(size.height())), options);
+	
+	// Restore the state of the view.
+	makeCurrent();
+	glViewport(0, 0, width(), height());
+	m_matricesDirty = true;
+	GLState::invalidate();
+	invalidate();
+	
+	return succeed;
+}
+
 void SceneView::setOrtho(bool b)
 {
 	m_ortho = b;
-	updateMatrices();
-	emit updateGL();
+	m_matricesDirty = true;
+	invalidate();
 }
@@ -24,10 +24,18 @@
 // Include GLEW before anything else.
 #include <GL/glew.h>
 
+#include <QtCore/QTime>
 #include <QtOpenGL/QGLWidget>
 
+#include "profiler.h"
+#include "sequenceexport.h"
+#include "transform.h"
+
 
 class QRectF;
+class QTimer;
+class QGLFramebufferObject;
+class FrameCapture;
 class QWheelEvent;
 class QMouseEvent;
 class Effect;
@@ -50,11 +58,50 @@ public:
 
 	bool isWireframe() const;
 	bool isOrtho() const;
+	bool isTimingsVisible() const;
+	bool isProgressive() const;
+	bool isDynamicResolution() const;
+	bool isOverdraw() const;
+	
+	const FrameProfiler * profiler() const;
+	
+	// Save the next frame, or every frame while capturing.
+	void saveScreenshot(const QString & fileName);
+	void startCapture(const QString & fileName);
+	void stopCapture();
+	
+	// Render the animation offscreen with the current camera.
+	bool exportSequence(SequenceExporter * exporter, const SequenceExporter::Options & options);
+	
+	// Render the scene with all the passes of the effect.
+	static void renderEffect(Effect * effect, const Scene * scene, FrameProfiler * profiler = NULL);
 	
 public slots:
 	
 	void setWireframe(bool b);	
 	void setOrtho(bool b);
+	void setTimingsVisible(bool b);
+	void setProgressive(bool b);
+	void setDynamicResolution(bool b);
+	void setOverdraw(bool b);
+	
+	// Request a new frame. Requests are coalesced into at most one frame per refresh.
+	void invalidate();
+	
+	// Render continuously while the effect is animated.
+	void setAnimated(bool b);
+	
+	// Read the profiler results of the frames in flight, for views that stopped rendering.
+	void pollProfiler();
+	
+signals:
+	
+	void captureFailed(const QString & fileName);
+	
+private slots:
+	
+	void onFrameTimeout();
+	void onInteractionTimeout();
 	
 
 protected:
@@ -65,6 +112,8 @@ protected:
 	void resetGL();
 	
 	void updateMatrices();
+	Matrix4 projectionMatrix(float aspect) const;
+	Matrix4 modelViewMatrix() const;
 	
 	// Mouse events
 	virtual void mousePressEvent(QMouseEvent *event);
@@ -74,6 +123,17 @@ protected:
 
 	void resetTransform();
 	
+	void drawTimings();
+	
+	bool renderProgressive();
+	void renderScaled();
+	void presentTexture(GLuint texture);
+	void renderOverdraw();
+	void drawHeatmap();
+	void drawFragmentCounts();
+	void scheduleFrame();
+	void interact();
+	
 private:
 	
 	float m_alpha;
@@ -89,6 +149,35 @@ private:
 	
 	bool m_wireframe;
 	bool m_ortho;
+	
+	FrameProfiler m_profiler;
+	bool m_showTimings;
+	int m_savedStateCalls;
+	
+	// Frame scheduling.
+	QTimer * m_frameTimer;
+	QTime m_lastFrame;
+	bool m_animated;
+	bool m_matricesDirty;
+	
+	// Progressive rendering.
+	bool m_progressive;
+	bool m_progressiveRestart;
+	int m_nextTile;
+	QGLFramebufferObject * m_fbo;
+	
+	// Dynamic resolution, while the user interacts with the view.
+	bool m_dynamicResolution;
+	bool m_interacting;
+	int m_scaleLevel;
+	QTimer * m_interactionTimer;
+	QGLFramebufferObject * m_scaledFbo;
+	
+	// Overdraw heatmap and fragment counts.
+	bool m_overdraw;
+	int m_overdrawFrames;
+	
+	FrameCapture * m_capture;
 };
 
 #endif // QGLVIEW_H
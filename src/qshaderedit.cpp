@@ -26,11 +26,16 @@
 #include "messagepanel.h"
 #include "parameterpanel.h"
 #include "scenepanel.h"
+#include "profilerpanel.h"
+#include "texturepanel.h"
 #include "editor.h"
 #include "newdialog.h"
 #include "scene.h"
 #include "document.h"
 #include "glutils.h"
+#include "programcache.h"
+#include "shadercost.h"
+#include "texmanager.h"
 
 #include <QtCore/QFile>
 #include <QtCore/QTimer>
@@ -159,8 +164,8 @@ void QShaderEdit::onCursorPositionChanged()
 
 void QShaderEdit::onShaderTextChanged()
 {
-	// Compile after 1.5 seconds of inactivity.
-	m_activityTimer->start(1500);
+	// Compile after a period of inactivity that depends on the build time.
+	m_activityTimer->start(buildDelay());
 }
 
 void QShaderEdit::onModifiedChanged(bool changed)
@@ -182,10 +187,11 @@ void QShaderEdit::onActivityTimeout()
 {
 	Q_ASSERT(m_document->effect() != NULL);
 	
-	// Delay recompilation while editor is active or effect still compiling.
-	if (m_parameterPanel->isEditorActive() || m_document->effect()->isBuilding())
+	// Delay recompilation while editor is active, effect still compiling or a sequence is exported.
+	Effect * effect = m_document->effect();
+	if (m_parameterPanel->isEditorActive() || (effect->isBuilding() && !effect->buildsInBackground()) || m_scenePanel->isExporting())
 	{
-		m_activityTimer->start(1500);
+		m_activityTimer->start(buildDelay());
 		return;
 	}
 	
@@ -195,7 +201,10 @@ void QShaderEdit::onActivityTimeout()
 	statusBar()->showMessage(tr("Compiling..."));
 
 	// Compile the effect.
-	m_document->build();
+	if (!m_document->build())
+	{
+		statusBar()->showMessage(tr("No code changes, compilation skipped."), 2000);
+	}
 }
 
 
@@ -220,6 +229,11 @@ void QShaderEdit::onEffectCreated()
 	connect(effect, SIGNAL(infoMessage(QString)), m_messagePanel, SLOT(info(QString)));
 	connect(effect, SIGNAL(errorMessage(QString)), m_messagePanel, SLOT(error(QString)));
 	connect(effect, SIGNAL(buildMessage(QString,int,OutputParser*)), m_messagePanel, SLOT(log(QString,int,OutputParser*)));
+	connect(effect, SIGNAL(specialized(bool)), m_scenePanel, SLOT(refresh()));
+	
+	if (effect->canSpecialize()) {
+		effect->setSpecialized(m_specializeAction->isChecked());
+	}
 	
 	updateActions();
 	updateTechniques();
@@ -227,6 +241,9 @@ void QShaderEdit::onEffectCreated()
 	// Init scene view.
 	m_scenePanel->setEffect(effect);
 	
+	// Build times are tracked per effect.
+	m_buildTimes.clear();
+	updateBuildTimeLabel();
 }
 
 void QShaderEdit::onEffectDeleted()
@@ -244,11 +261,18 @@ void QShaderEdit::onEffectBuilding()
 	Effect * effect = m_document->effect();
 	Q_ASSERT(effect != NULL);
 
+	m_buildTime.start();
+
 	// @@ Why?
 	//m_parameterPanel->clear();
 
 	m_messagePanel->clear();
 	
+	// Keep rendering the current program while it builds in the background.
+	if (effect->buildsInBackground()) {
+		return;
+	}
+	
 	// Stop animation while building.
 	if (effect->isAnimated()) {
 		m_scenePanel->stopAnimation();
@@ -261,6 +285,16 @@ void QShaderEdit::onEffectBuilt(bool succeed)
 	Effect * effect = m_document->effect();
 	Q_ASSERT(effect != NULL);
 	
+	if (!m_buildTime.isNull())
+	{
+		m_buildTimes.append(m_buildTime.elapsed());
+		if (m_buildTimes.count() > MaxBuildTimes) {
+			m_buildTimes.removeFirst();
+		}
+		m_buildTime = QTime();
+		updateBuildTimeLabel();
+	}
+	
 	if (succeed)
 	{
 		statusBar()->showMessage(tr("Compilation succeed."), 2000);
@@ -276,6 +310,17 @@ void QShaderEdit::onEffectBuilt(bool succeed)
 	updateTechniques();
 	m_parameterPanel->setEffect(effect);
 	
+	if (m_shaderCostAction->isChecked())
+	{
+		// Line costs of a failed build would not match the sources.
+		if (succeed) {
+			analyzeShaderCost();
+		}
+		else {
+			m_editor->clearLineCosts();
+		}
+	}
+	
 	// @@ Restart animation? 
 	if (effect->isAnimated()) {
 		m_scenePanel->startAnimation();
@@ -288,6 +333,41 @@ void QShaderEdit::onEffectBuilt(bool succeed)
 	m_scenePanel->refresh();
 }
 
+void QShaderEdit::onSpecializeToggled(bool enable)
+{
+	Effect * effect = m_document->effect();
+	if (effect != NULL && effect->canSpecialize()) {
+		effect->setSpecialized(enable);
+		m_scenePanel->refresh();
+	}
+}
+
+void QShaderEdit::onShaderCostToggled(bool enable)
+{
+	Effect * effect = m_document->effect();
+	if (enable && effect != NULL && effect->isValid()) {
+		analyzeShaderCost();
+	}
+	else {
+		m_editor->clearLineCosts();
+	}
+}
+
+// Report the cost of every stage and annotate the lines of the editors.
+void QShaderEdit::analyzeShaderCost()
+{
+	Effect * effect = m_document->effect();
+	Q_ASSERT(effect != NULL);
+	
+	const int count = effect->getInputNum();
+	for (int i = 0; i < count; i++)
+	{
+		const ShaderCost cost = effect->analyzeCost(i);
+		m_messagePanel->info(tr("%1: %2\n").arg(effect->getInputName(i)).arg(cost.summary()), i);
+		m_editor->setLineCosts(i, cost.lineCosts);
+	}
+}
+
 void QShaderEdit::onParameterChanged()
 {
 	m_scenePanel->refresh();
@@ -302,6 +382,7 @@ void QShaderEdit::onTechniqueChanged(int index)
 		
 		effect->selectTechnique(index);
 		
+		m_profilerPanel->setTechnique(m_techniqueCombo->itemText(index));
 		m_scenePanel->refresh();
 	}
 }
@@ -412,6 +493,19 @@ void QShaderEdit::createEditor()
 	m_gotoAction->setShortcut(tr("Ctrl+G"));
 #endif
 	connect(m_gotoAction, SIGNAL(triggered()), m_editor, SLOT(gotoDialog()));
+	
+	m_shaderCostAction = new QAction(tr("Shader &Cost"), this);
+	m_shaderCostAction->setCheckable(true);
+	m_shaderCostAction->setChecked(false);
+	m_shaderCostAction->setStatusTip(tr("Estimate the cost of each stage and line after every build"));
+	connect(m_shaderCostAction, SIGNAL(toggled(bool)), this, SLOT(onShaderCostToggled(bool)));
+	
+	m_specializeAction = new QAction(tr("&Specialize"), this);
+	m_specializeAction->setCheckable(true);
+	m_specializeAction->setChecked(false);
+	m_specializeAction->setEnabled(false);
+	m_specializeAction->setStatusTip(tr("Render with the checked parameters baked into the shaders as constants"));
+	connect(m_specializeAction, SIGNAL(toggled(bool)), this, SLOT(onSpecializeToggled(bool)));
 
 	
 	// Add hidden actions.
@@ -446,8 +540,22 @@ void QShaderEdit::createDockWindows()
 	m_parameterPanel->setObjectName("ParameterDock");
 	m_parameterPanel->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
 	addDockWidget(Qt::RightDockWidgetArea, m_parameterPanel);
+	
+	m_profilerPanel = new ProfilerPanel(tr("Profiler"), this);
+	m_profilerPanel->setObjectName("ProfilerDock");
+	m_profilerPanel->setVisible(false);
+	m_profilerPanel->setProfiler(m_scenePanel->profiler());
+	connect(m_profilerPanel, SIGNAL(aboutToRefresh()), m_scenePanel, SLOT(pollProfiler()));
+	addDockWidget(Qt::BottomDockWidgetArea, m_profilerPanel);
+
+	m_texturePanel = new TexturePanel(tr("Textures"), this);
+	m_texturePanel->setObjectName("TextureDock");
+	m_texturePanel->setVisible(false);
+	addDockWidget(Qt::BottomDockWidgetArea, m_texturePanel);
 	connect(m_parameterPanel, SIGNAL(parameterChanged()), m_document, SLOT(onParameterChanged()));
 	connect(m_parameterPanel, SIGNAL(parameterChanged()), this, SLOT(onParameterChanged()));
+	connect(m_parameterPanel, SIGNAL(freezeChanged()), m_scenePanel, SLOT(refresh()));
+	connect(TextureLoader::instance(), SIGNAL(loaded(QString)), m_scenePanel, SLOT(refresh()));
 }
 
 
@@ -567,6 +675,9 @@ void QShaderEdit::createMenus()
 	viewMenu->addAction(m_scenePanel->toggleViewAction());
 	viewMenu->addAction(m_parameterPanel->toggleViewAction());
 	viewMenu->addAction(m_messagePanel->toggleViewAction());
+	viewMenu->addAction(m_profilerPanel->toggleViewAction());
+	viewMenu->addAction(m_texturePanel->toggleViewAction());
+	viewMenu->addAction(m_shaderCostAction);
 	
 	viewMenu->addSeparator();
 	
@@ -622,6 +733,7 @@ void QShaderEdit::createToolbars()
 	techniqueLabel->setBuddy(m_techniqueCombo);
 	m_techniqueToolBar->addWidget(techniqueLabel);
 	m_techniqueToolBar->addWidget(m_techniqueCombo);
+	m_techniqueToolBar->addAction(m_specializeAction);
 
 	setUnifiedTitleAndToolBarOnMac(true);
 }
@@ -632,6 +744,8 @@ void QShaderEdit::createStatusbar()
 	m_statusLabel = new QLabel(statusBar());
 	m_statusLabel->setText(tr(" Line: 0  Col: 0"));
 	statusBar()->addPermanentWidget(m_statusLabel);
+	m_buildTimeLabel = new QLabel(statusBar());
+	statusBar()->addPermanentWidget(m_buildTimeLabel);
 }
 
 void QShaderEdit::updateActions()
@@ -643,6 +757,9 @@ void QShaderEdit::updateActions()
 	m_findNextAction->setEnabled(true);
 	m_findPreviousAction->setEnabled(true);
 	m_gotoAction->setEnabled(true);
+	
+	Effect * effect = m_document->effect();
+	m_specializeAction->setEnabled(effect != NULL && effect->canSpecialize());
 
 	/*QString fileName;
 	fileName = m_document->fileName();
@@ -681,6 +798,8 @@ void QShaderEdit::updateTechniques()
 			effect->selectTechnique(idx);
 		}
 	}
+	
+	m_profilerPanel->setTechnique(count > 0 ? m_techniqueCombo->currentText() : QString());
 }
 
 void QShaderEdit::updateWindowTitle(QString title)
@@ -749,6 +868,42 @@ void QShaderEdit::addRecentFile(QString fileName)
 	updateRecentFileActions();
 }
 
+// Time to wait after the last edit before building the effect.
+int QShaderEdit::buildDelay() const
+{
+	if (m_buildTimes.isEmpty()) {
+		return 1500;
+	}
+	
+	int average = 0;
+	foreach (int t, m_buildTimes) {
+		average += t;
+	}
+	average /= m_buildTimes.count();
+	
+	// Build cheap effects right away, back off for the expensive ones.
+	if (average < 30) {
+		return 0;
+	}
+	return qBound(100, 3 * average, 5000);
+}
+
+void QShaderEdit::updateBuildTimeLabel()
+{
+	if (m_buildTimes.isEmpty()) {
+		m_buildTimeLabel->clear();
+		return;
+	}
+	
+	QStringList times;
+	foreach (int t, m_buildTimes) {
+		times.append(QString::number(t));
+	}
+	
+	m_buildTimeLabel->setText(tr(" Build: %1 ms  Delay: %2 ms ").arg(m_buildTimes.last()).arg(buildDelay()));
+	m_buildTimeLabel->setToolTip(tr("Recent build times: %1 ms").arg(times.join(", ")));
+}
+
 
 /*virtual*/ void QShaderEdit::closeEvent(QCloseEvent * event)
 {
@@ -839,6 +994,11 @@ void QShaderEdit::loadSettings()
 	Document::setLastEffect(pref.value("lastEffect", ".").toString());
 	SceneFactory::setLastFile(pref.value("lastScene", ".").toString());
 	ParameterPanel::setLastPath(pref.value("lastParameterPath", ".").toString());
+	ProgramCache::setMaxSize(pref.value("programCacheSize", ProgramCache::maxSize()).toLongLong());
+	TextureCache * textureCache = TextureCache::instance();
+	textureCache->setHostBudget(pref.value("textureHostBudget", textureCache->hostBudget()).toLongLong());
+	textureCache->setVideoBudget(pref.value("textureVideoBudget", textureCache->videoBudget()).toLongLong());
+	m_shaderCostAction->setChecked(pref.value("shaderCost", false).toBool());
 
 	if (maximize) {
 		setWindowState(windowState() | Qt::WindowMaximized);
@@ -864,5 +1024,9 @@ void QShaderEdit::saveSettings()
 	pref.setValue("lastEffect", Document::lastEffect());
 	pref.setValue("lastScene", SceneFactory::lastFile());
 	pref.setValue("lastParameterPath", ParameterPanel::lastPath());
+	pref.setValue("programCacheSize", ProgramCache::maxSize());
+	pref.setValue("textureHostBudget", TextureCache::instance()->hostBudget());
+	pref.setValue("textureVideoBudget", TextureCache::instance()->videoBudget());
+	pref.setValue("shaderCost", m_shaderCostAction->isChecked());
 }
 
@@ -21,6 +21,8 @@
 #ifndef QSHADEREDIT_H
 #define QSHADEREDIT_H
 
+#include <QtCore/QList>
+#include <QtCore/QTime>
 #include <QtGui/QMainWindow>
 
 class QTimer;
@@ -33,6 +35,8 @@ class QGLWidget;
 class MessagePanel;
 class ParameterPanel;
 class ScenePanel;
+class ProfilerPanel;
+class TexturePanel;
 class Editor;
 class Document;
 struct Effect;
@@ -68,6 +72,8 @@ protected slots:
 	void onEffectBuilt(bool succeed);
 	void onParameterChanged();
 	void onTechniqueChanged(int index);
+	void onShaderCostToggled(bool enable);
+	void onSpecializeToggled(bool enable);
 	
 	void updateEffectInputs();	
 	
@@ -92,6 +98,11 @@ protected:
 	void updateRecentFileActions();
 	void addRecentFile(QString filename);
 	
+	int buildDelay() const;
+	void updateBuildTimeLabel();
+	
+	void analyzeShaderCost();
+	
 
 	// Events
 	virtual void closeEvent(QCloseEvent * event);
@@ -132,11 +143,14 @@ protected:
 	
 	// Status bar.
 	QLabel * m_statusLabel;
+	QLabel * m_buildTimeLabel;
 	
 	// Panels.
 	MessagePanel * m_messagePanel;
 	ParameterPanel * m_parameterPanel;
 	ScenePanel * m_scenePanel;
+	ProfilerPanel * m_profilerPanel;
+	TexturePanel * m_texturePanel;
 	
 	// Actions.
 	QAction * m_newAction;
@@ -156,9 +170,16 @@ protected:
 	QAction * m_findNextAction;
 	QAction * m_findPreviousAction;
 	QAction * m_gotoAction;
+	QAction * m_shaderCostAction;
+	QAction * m_specializeAction;
 	
 	// Timer.
 	QTimer * m_activityTimer;
+	
+	// Duration of the recent builds of the current effect, in milliseconds.
+	enum { MaxBuildTimes = 8 };
+	QTime m_buildTime;
+	QList<int> m_buildTimes;
 };
 
 
@@ -20,6 +20,7 @@
 
 #include "scene.h"
 #include "effect.h"
+#include "mesh.h"
 
 // Include GLEW before anything else.
 #include <GL/glew.h>
@@ -33,22 +34,11 @@
 #include <math.h>
 
 
-extern void drawTeapot();
+extern void buildTeapot(Mesh & mesh);
 
-class DisplayListScene : public Scene
+class MeshScene : public Scene
 {
 public:
-	DisplayListScene() : m_dlist(0)
-	{
-	}
-
-	virtual ~DisplayListScene()
-	{
-		if( m_dlist != 0 ) {
-			glDeleteLists(m_dlist, 1);
-		}
-	}
-	
 
 	virtual void draw(Effect* effect) const
 	{
@@ -63,11 +53,12 @@ public:
 		glMaterialfv(GL_FRONT, GL_SPECULAR, ks);
 		glMaterialf(GL_FRONT, GL_SHININESS, 8);
 		
-		glCallList(m_dlist);
+		m_mesh.draw();
 	}
 	
-	virtual void transform() const
+	virtual Matrix4 transform() const
 	{
+		return Matrix4();
 	}
 	
 	virtual void setupMenu(QMenu * menu) const
@@ -77,28 +68,28 @@ public:
 	}
 
 protected:
-	GLuint m_dlist;
+	Mesh m_mesh;
 	
 };
 
 
-class TeapotScene : public DisplayListScene
+class TeapotScene : public MeshScene
 {
 public:
 	TeapotScene()
 	{
-		m_dlist = glGenLists(1);
-		glNewList(m_dlist, GL_COMPILE);
-		drawTeapot();
-		glEndList();
+		buildTeapot(m_mesh);
+		m_mesh.upload();
 	}
 	
-	virtual void transform() const
+	virtual Matrix4 transform() const
 	{
 		// Object transform:
-		glRotated(270.0, 1.0, 0.0, 0.0);
-		glScaled(0.5, 0.5, 0.5);
-		glTranslated(0.0, 0.0, -1.5);			
+		Matrix4 m;
+		m.rotate(270.0f, 1.0f, 0.0f, 0.0f);
+		m.scale(0.5f, 0.5f, 0.5f);
+		m.translate(0.0f, 0.0f, -1.5f);
+		return m;
 	}
 };
 
@@ -128,39 +119,26 @@ REGISTER_SCENE_FACTORY(TeapotSceneFactory);
 
 
 
-class QuadScene : public DisplayListScene
+class QuadScene : public MeshScene
 {
 public:
 	QuadScene()
 	{
-		const bool hasMultiTexture = GLEW_ARB_multitexture || GLEW_VERSION_1_3;
+		Mesh::Vertex v[4] = {
+			Mesh::Vertex(-1, -1, 0,  0, 0, 1,  0, 1),
+			Mesh::Vertex( 1, -1, 0,  0, 0, 1,  1, 1),
+			Mesh::Vertex( 1,  1, 0,  0, 0, 1,  1, 0),
+			Mesh::Vertex(-1,  1, 0,  0, 0, 1,  0, 0)
+		};
 		
-		m_dlist = glGenLists(1);
-		glNewList(m_dlist, GL_COMPILE);
-		glBegin(GL_QUADS);
-			glNormal3f(0, 0, 1);
-	
-			if( hasMultiTexture ) {
-				glMultiTexCoord3f(GL_TEXTURE6, 1, 0, 0);
-				glMultiTexCoord3f(GL_TEXTURE7, 0, -1, 0);
-			}
+		for(int i = 0; i < 4; i++) {
+			v[i].tangent[0] = 1;
+			v[i].bitangent[1] = -1;
+		}
 		
-			glTexCoord2f(0, 1);
-			glVertex2f(-1, -1);
-
-			glNormal3f(0, 0, 1);
-			glTexCoord2f(1, 1);
-			glVertex2f(1, -1);
-
-			glNormal3f(0, 0, 1);
-			glTexCoord2f(1, 0);
-			glVertex2f(1, 1);
-
-			glNormal3f(0, 0, 1);
-			glTexCoord2f(0, 0);
-			glVertex2f(-1, 1);
-		glEnd();
-		glEndList();
+		m_mesh.addQuad(v[0], v[1], v[2], v[3]);
+		m_mesh.setHasTangents(true);
+		m_mesh.upload();
 	}
 };
 
@@ -458,54 +436,45 @@ REGISTER_SCENE_FACTORY(TriangleSceneFactory);
 #endif
 
 
-class CubeScene : public DisplayListScene
+class CubeScene : public MeshScene
 {
 public:
 	CubeScene()
 	{
-		m_dlist = glGenLists(1);
-		glNewList(m_dlist, GL_COMPILE);
-		glBegin(GL_QUADS);
+		typedef Mesh::Vertex V;
 		
 		// Front Face
-		glNormal3f(0, 0, 1);
-		glTexCoord2f(0.0f, 0.0f); glVertex3f(-1.0f, -1.0f,  1.0f);
-		glTexCoord2f(1.0f, 0.0f); glVertex3f( 1.0f, -1.0f,  1.0f);
-		glTexCoord2f(1.0f, 1.0f); glVertex3f( 1.0f,  1.0f,  1.0f);
-		glTexCoord2f(0.0f, 1.0f); glVertex3f(-1.0f,  1.0f,  1.0f);
+		m_mesh.addQuad(V(-1.0f, -1.0f,  1.0f,  0, 0, 1,  0.0f, 0.0f),
+		               V( 1.0f, -1.0f,  1.0f,  0, 0, 1,  1.0f, 0.0f),
+		               V( 1.0f,  1.0f,  1.0f,  0, 0, 1,  1.0f, 1.0f),
+		               V(-1.0f,  1.0f,  1.0f,  0, 0, 1,  0.0f, 1.0f));
 		// Back Face
-		glNormal3f(0, 0, -1);
-		glTexCoord2f(1.0f, 0.0f); glVertex3f(-1.0f, -1.0f, -1.0f);
-		glTexCoord2f(1.0f, 1.0f); glVertex3f(-1.0f,  1.0f, -1.0f);
-		glTexCoord2f(0.0f, 1.0f); glVertex3f( 1.0f,  1.0f, -1.0f);
-		glTexCoord2f(0.0f, 0.0f); glVertex3f( 1.0f, -1.0f, -1.0f);
+		m_mesh.addQuad(V(-1.0f, -1.0f, -1.0f,  0, 0, -1,  1.0f, 0.0f),
+		               V(-1.0f,  1.0f, -1.0f,  0, 0, -1,  1.0f, 1.0f),
+		               V( 1.0f,  1.0f, -1.0f,  0, 0, -1,  0.0f, 1.0f),
+		               V( 1.0f, -1.0f, -1.0f,  0, 0, -1,  0.0f, 0.0f));
 		// Top Face
-		glNormal3f(0, 1, 0);
-		glTexCoord2f(0.0f, 1.0f); glVertex3f(-1.0f,  1.0f, -1.0f);
-		glTexCoord2f(0.0f, 0.0f); glVertex3f(-1.0f,  1.0f,  1.0f);
-		glTexCoord2f(1.0f, 0.0f); glVertex3f( 1.0f,  1.0f,  1.0f);
-		glTexCoord2f(1.0f, 1.0f); glVertex3f( 1.0f,  1.0f, -1.0f);
+		m_mesh.addQuad(V(-1.0f,  1.0f, -1.0f,  0, 1, 0,  0.0f, 1.0f),
+		               V(-1.0f,  1.0f,  1.0f,  0, 1, 0,  0.0f, 0.0f),
+		               V( 1.0f,  1.0f,  1.0f,  0, 1, 0,  1.0f, 0.0f),
+		               V( 1.0f,  1.0f, -1.0f,  0, 1, 0,  1.0f, 1.0f));
 		// Bottom Face
-		glNormal3f(0, -1, 0);
-		glTexCoord2f(1.0f, 1.0f); glVertex3f(-1.0f, -1.0f, -1.0f);
-		glTexCoord2f(0.0f, 1.0f); glVertex3f( 1.0f, -1.0f, -1.0f);
-		glTexCoord2f(0.0f, 0.0f); glVertex3f( 1.0f, -1.0f,  1.0f);
-		glTexCoord2f(1.0f, 0.0f); glVertex3f(-1.0f, -1.0f,  1.0f);
+		m_mesh.addQuad(V(-1.0f, -1.0f, -1.0f,  0, -1, 0,  1.0f, 1.0f),
+		               V( 1.0f, -1.0f, -1.0f,  0, -1, 0,  0.0f, 1.0f),
+		               V( 1.0f, -1.0f,  1.0f,  0, -1, 0,  0.0f, 0.0f),
+		               V(-1.0f, -1.0f,  1.0f,  0, -1, 0,  1.0f, 0.0f));
 		// Right face
-		glNormal3f(1, 0, 0);
-		glTexCoord2f(1.0f, 0.0f); glVertex3f( 1.0f, -1.0f, -1.0f);
-		glTexCoord2f(1.0f, 1.0f); glVertex3f( 1.0f,  1.0f, -1.0f);
-		glTexCoord2f(0.0f, 1.0f); glVertex3f( 1.0f,  1.0f,  1.0f);
-		glTexCoord2f(0.0f, 0.0f); glVertex3f( 1.0f, -1.0f,  1.0f);
+		m_mesh.addQuad(V( 1.0f, -1.0f, -1.0f,  1, 0, 0,  1.0f, 0.0f),
+		               V( 1.0f,  1.0f, -1.0f,  1, 0, 0,  1.0f, 1.0f),
+		               V( 1.0f,  1.0f,  1.0f,  1, 0, 0,  0.0f, 1.0f),
+		               V( 1.0f, -1.0f,  1.0f,  1, 0, 0,  0.0f, 0.0f));
 		// Left Face
-		glNormal3f(-1, 0, 0);
-		glTexCoord2f(0.0f, 0.0f); glVertex3f(-1.0f, -1.0f, -1.0f);
-		glTexCoord2f(1.0f, 0.0f); glVertex3f(-1.0f, -1.0f,  1.0f);
-		glTexCoord2f(1.0f, 1.0f); glVertex3f(-1.0f,  1.0f,  1.0f);
-		glTexCoord2f(0.0f, 1.0f); glVertex3f(-1.0f,  1.0f, -1.0f);
+		m_mesh.addQuad(V(-1.0f, -1.0f, -1.0f,  -1, 0, 0,  0.0f, 0.0f),
+		               V(-1.0f, -1.0f,  1.0f,  -1, 0, 0,  1.0f, 0.0f),
+		               V(-1.0f,  1.0f,  1.0f,  -1, 0, 0,  1.0f, 1.0f),
+		               V(-1.0f,  1.0f, -1.0f,  -1, 0, 0,  0.0f, 1.0f));
 		
-		glEnd();
-		glEndList();
+		m_mesh.upload();
 	}
 };
 
@@ -538,7 +507,7 @@ REGISTER_SCENE_FACTORY(CubeSceneFactory);
 class ObjScene : public Scene
 {
 public:
-	ObjScene(): m_dlistBase(0), m_dlistCount(0)
+	ObjScene()
 	{
 		QString fileName = QFileDialog::getOpenFileName(NULL, QObject::tr("Open File"),
 			SceneFactory::lastFile(), QString(QObject::tr("OBJ Files (%1)")).arg("*.obj"));
@@ -549,25 +518,28 @@ public:
 		}		
 	}
 	
-	~ObjScene()
+	ObjScene(const QString & fileName)
 	{
-		if (m_dlistBase)
-			glDeleteLists(m_dlistBase, m_dlistCount);
+		load( fileName );
 	}
 	
-	virtual void transform() const
+	virtual Matrix4 transform() const
 	{
-		glScalef(m_scale, m_scale, m_scale);
-		glTranslatef(-m_center.x, -m_center.y, -m_center.z);
+		Matrix4 m;
+		m.scale(m_scale, m_scale, m_scale);
+		m.translate(-m_center.x, -m_center.y, -m_center.z);
+		return m;
 	}
 	
 	virtual void draw(Effect* effect) const
 	{
-		GLuint lastList = m_dlistBase + m_dlistCount;  
-		for (GLuint n = m_dlistBase; n < lastList; n++) {
+		m_mesh.bind();
+		foreach (const Group & group, m_groups) {
 			if(effect) effect->beginMaterialGroup();
-			glCallList(n);
+			group.material.bind();
+			m_mesh.drawRange(group.first, group.count);
 		}
+		m_mesh.release();
 	}
 	
 	virtual void setupMenu(QMenu * menu) const
@@ -606,7 +578,7 @@ private:
 		Material(): ka(0.1f, 0.1f, 0.1f, 1.0f), kd(1.0f, 1.0f, 1.0f, 1.0f), ks(0.0f, 0.0f, 0.0f, 0.0f), ns(20.0f)		 
 		{ }
 		
-		void bind() 
+		void bind() const
 		{
 			glMaterialfv(GL_FRONT, GL_AMBIENT, (GLfloat*)&ka);
 			glMaterialfv(GL_FRONT, GL_DIFFUSE, (GLfloat*)&kd);
@@ -705,6 +677,14 @@ private:
 		QVector< QVector<Vertex> > faces;
 	};
 	
+	// Range of triangles that share a material.
+	struct Group
+	{
+		Material material;
+		int first;
+		int count;
+	};
+	
 	static float min(float a, float b) 
 	{
 		return a < b ? a : b;
@@ -721,8 +701,8 @@ private:
 		if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
 			return;
 		
-		if (m_dlistBase)
-			glDeleteLists(m_dlistBase, m_dlistCount);
+		m_mesh.clear();
+		m_groups.clear();
 		
 		QRegExp vertexPattern("^v\\s+(.*)\\s+(.*)\\s+(.*)");
 		QRegExp normalPattern("^vn\\s+(.*)\\s+(.*)\\s+(.*)");
@@ -867,36 +847,55 @@ private:
 		m_scale = 1.0f / max(vmax.x - m_center.x, max(vmax.y - m_center.y, vmax.z - m_center.z));
 		
 		
-		// create display lists
+		// create the mesh, one group per material
 		if (surfaces[0]->faces.isEmpty())
 			surfaces.remove(0);
-		m_dlistCount = surfaces.size();
-		m_dlistBase = glGenLists(m_dlistCount);
 		
-		for (GLuint n = 0; n < m_dlistCount; n++) {
-			glNewList(m_dlistBase + n, GL_COMPILE);			
-			Surface* surf = surfaces[n];			
-			surf->material->bind();
-			
+		int first = 0;
+		foreach (const Surface* surf, surfaces) {
 			for (int face = 0; face < surf->faces.count(); face++) {
-				QVector<Vertex> verts = surf->faces[face];
+				const QVector<Vertex> & verts = surf->faces[face];
 				
-				glBegin(GL_POLYGON);
+				GLuint base = m_mesh.vertexCount();
 				for (int vert = 0; vert < verts.count(); vert++) {
+					Mesh::Vertex v(0, 0, 0, 0, 0, 1, 0, 0);
 					
-					if (verts[vert].texcoord >= 0)
-						glTexCoord2fv((GLfloat*)&texcoords[verts[vert].texcoord]);
+					if (verts[vert].texcoord >= 0) {
+						const vec2 & t = texcoords[verts[vert].texcoord];
+						v.texcoord[0] = t.s;
+						v.texcoord[1] = t.t;
+					}
 					
-					if (verts[vert].normal >= 0)
-						glNormal3fv((GLfloat*)&normals[verts[vert].normal]);
+					if (verts[vert].normal >= 0) {
+						const vec3 & n = normals[verts[vert].normal];
+						v.normal[0] = n.x;
+						v.normal[1] = n.y;
+						v.normal[2] = n.z;
+					}
 					
-					glVertex3fv((GLfloat*)&vertices[verts[vert].pos]);
+					const vec3 & pos = vertices[verts[vert].pos];
+					v.pos[0] = pos.x;
+					v.pos[1] = pos.y;
+					v.pos[2] = pos.z;
+					
+					m_mesh.addVertex(v);
+				}
+				
+				// Triangulate the polygon as a fan.
+				for (int vert = 2; vert < verts.count(); vert++) {
+					m_mesh.addTriangle(base, base + vert - 1, base + vert);
 				}
-				glEnd();
 			}
 			
-			glEndList();
-		}		
+			Group group;
+			group.material = *surf->material;
+			group.first = first;
+			group.count = m_mesh.indexCount() - first;
+			m_groups.append(group);
+			
+			first = m_mesh.indexCount();
+		}
+		m_mesh.upload();
 		
 		delete defaultMaterial;
 		qDeleteAll(materialLibs);
@@ -906,7 +905,8 @@ private:
 	vec3 m_center;
 	float m_scale;
 	
-	GLuint m_dlistBase, m_dlistCount;
+	Mesh m_mesh;
+	QVector<Group> m_groups;
 };
 
 // Obj scene factory.
@@ -997,6 +997,12 @@ Scene * SceneFactory::defaultScene()
 	return new TeapotScene();
 }
 
+//static
+Scene * SceneFactory::loadScene(const QString & fileName)
+{
+	return new ObjScene(fileName);
+}
+
 //static
 const QString & SceneFactory::lastFile()
 {
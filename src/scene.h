@@ -24,6 +24,8 @@
 #include <QtCore/QObject>
 #include <QtGui/QIcon>
 
+#include "transform.h"
+
 class QMenu;
 
 // @@ I'm not sure where to expose the scene selection. Here are 
@@ -46,7 +48,8 @@ public:
 	// pass effect to work around ATI driver bug (Effect::beginMaterialGroup())
 	virtual void draw(class Effect* effect) const = 0;
 	
-	virtual void transform() const = 0;
+	// Object transform.
+	virtual Matrix4 transform() const = 0;
 	virtual void setupMenu(QMenu * menu) const = 0;
 };
 
@@ -64,6 +67,7 @@ public:
 	static void addFactory(const SceneFactory * factory);
 	static void removeFactory(const SceneFactory * factory);
 	static Scene * defaultScene();
+	static Scene * loadScene(const QString & fileName);
 	
 	static const QString & lastFile();
 	static void setLastFile(const QString & lastFile);
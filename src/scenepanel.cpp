@@ -19,23 +19,24 @@
 
 #include "scenepanel.h"
 
-#include <QtCore/QTimer>
+#include <QtCore/QFileInfo>
 #include <QtGui/QMenu>
 #include <QtGui/QAction>
+#include <QtGui/QFileDialog>
+#include <QtGui/QMessageBox>
+#include <QtGui/QProgressDialog>
 
+#include "exportdialog.h"
 #include "qglview.h"
 #include "scene.h"
 
 
 ScenePanel::ScenePanel(const QString & title, QWidget * parent /*= 0*/, QGLWidget * shareWidget /*= 0*/, Qt::WFlags flags /*= 0*/) :
-	QDockWidget(title, parent, flags), m_view(NULL)
+	QDockWidget(title, parent, flags), m_view(NULL), m_exporting(false)
 {
 	m_view = new SceneView(this, shareWidget);
 	setWidget(m_view);
 	
-	m_animationTimer = new QTimer(this);
-	connect(m_animationTimer, SIGNAL(timeout()), this, SLOT(refresh()));
-	
 
 	m_sceneMenu = new QMenu(tr("&Scene"), this);
 	
@@ -65,8 +66,55 @@ ScenePanel::ScenePanel(const QString & title, QWidget * parent /*= 0*/, QGLWidge
 	m_orthoAction->setChecked(false);
 	connect(m_orthoAction, SIGNAL(toggled(bool)), m_view, SLOT(setOrtho(bool)));
 	
+	m_timingsAction = new QAction(tr("Show Timings"), this);
+	m_timingsAction->setCheckable(true);
+	m_timingsAction->setChecked(false);
+	connect(m_timingsAction, SIGNAL(toggled(bool)), m_view, SLOT(setTimingsVisible(bool)));
+	
+	m_progressiveAction = new QAction(tr("Progressive"), this);
+	m_progressiveAction->setCheckable(true);
+	m_progressiveAction->setChecked(false);
+	m_progressiveAction->setStatusTip(tr("Render expensive effects in tiles over several frames"));
+	connect(m_progressiveAction, SIGNAL(toggled(bool)), m_view, SLOT(setProgressive(bool)));
+	
+	m_dynamicResolutionAction = new QAction(tr("Dynamic Resolution"), this);
+	m_dynamicResolutionAction->setCheckable(true);
+	m_dynamicResolutionAction->setChecked(false);
+	m_dynamicResolutionAction->setStatusTip(tr("Lower the resolution while moving the camera if rendering is slow"));
+	connect(m_dynamicResolutionAction, SIGNAL(toggled(bool)), m_view, SLOT(setDynamicResolution(bool)));
+	
+	m_overdrawAction = new QAction(tr("Overdraw"), this);
+	m_overdrawAction->setCheckable(true);
+	m_overdrawAction->setChecked(false);
+	m_overdrawAction->setStatusTip(tr("Show how many fragments each pixel shades and the fragment count of each pass"));
+	connect(m_overdrawAction, SIGNAL(toggled(bool)), m_view, SLOT(setOverdraw(bool)));
+	
 	m_renderMenu->addAction(m_wireframeAction);
 	m_renderMenu->addAction(m_orthoAction);
+	m_renderMenu->addAction(m_timingsAction);
+	m_renderMenu->addAction(m_progressiveAction);
+	m_renderMenu->addAction(m_dynamicResolutionAction);
+	m_renderMenu->addAction(m_overdrawAction);
+	
+	m_sceneMenu->addSeparator();
+	
+	QAction * screenshotAction = new QAction(tr("Save Screenshot..."), this);
+	connect(screenshotAction, SIGNAL(triggered()), this, SLOT(saveScreenshot()));
+	m_sceneMenu->addAction(screenshotAction);
+	
+	m_captureAction = new QAction(tr("Capture Frames..."), this);
+	m_captureAction->setCheckable(true);
+	m_captureAction->setChecked(false);
+	m_captureAction->setStatusTip(tr("Save every rendered frame to numbered files"));
+	connect(m_captureAction, SIGNAL(toggled(bool)), this, SLOT(captureFrames(bool)));
+	m_sceneMenu->addAction(m_captureAction);
+	
+	QAction * exportAction = new QAction(tr("Export Sequence..."), this);
+	exportAction->setStatusTip(tr("Render the animation offscreen to images or a video"));
+	connect(exportAction, SIGNAL(triggered()), this, SLOT(exportSequence()));
+	m_sceneMenu->addAction(exportAction);
+	
+	connect(m_view, SIGNAL(captureFailed(QString)), this, SLOT(onCaptureFailed(QString)));
 }
 
 ScenePanel::~ScenePanel()
@@ -84,6 +132,16 @@ QMenu * ScenePanel::menu()
 	return m_sceneMenu;
 }
 
+const FrameProfiler * ScenePanel::profiler() const
+{
+	return m_view->profiler();
+}
+
+void ScenePanel::pollProfiler()
+{
+	m_view->pollProfiler();
+}
+
 void ScenePanel::setViewUpdatesEnabled(bool enable)
 {
 	m_view->setUpdatesEnabled(enable);
@@ -91,17 +149,85 @@ void ScenePanel::setViewUpdatesEnabled(bool enable)
 
 void ScenePanel::startAnimation()
 {
-	m_animationTimer->start(30);
+	m_view->setAnimated(true);
 }
 
 void ScenePanel::stopAnimation()
 {
-	m_animationTimer->stop();
+	m_view->setAnimated(false);
+}
+
+bool ScenePanel::isExporting() const
+{
+	return m_exporting;
 }
 
 void ScenePanel::refresh()
 {
-	m_view->updateGL();
+	m_view->invalidate();
+}
+
+void ScenePanel::saveScreenshot()
+{
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Save Screenshot"), QString(), tr("Images (*.png *.exr)"));
+	if( !fileName.isEmpty() ) {
+		if( QFileInfo(fileName).suffix().isEmpty() ) {
+			fileName += ".png";
+		}
+		m_view->saveScreenshot(fileName);
+	}
+}
+
+void ScenePanel::captureFrames(bool enable)
+{
+	if( !enable ) {
+		m_view->stopCapture();
+		return;
+	}
+	
+	const QString fileName = QFileDialog::getSaveFileName(this, tr("Capture Frames"), QString(), tr("Images (*.png *.exr)"));
+	if( fileName.isEmpty() ) {
+		m_captureAction->setChecked(false);
+		return;
+	}
+	m_view->startCapture(fileName);
+}
+
+void ScenePanel::onCaptureFailed(const QString & fileName)
+{
+	m_captureAction->setChecked(false);
+	QMessageBox::warning(this, tr("Capture"), tr("Could not save '%1'.").arg(fileName));
+}
+
+void ScenePanel::exportSequence()
+{
+	ExportDialog dialog(this);
+	dialog.setOptions(m_exportOptions);
+	if( dialog.exec() != QDialog::Accepted ) {
+		return;
+	}
+	m_exportOptions = dialog.options();
+	
+	if( !m_exportOptions.video && QFileInfo(m_exportOptions.fileName).suffix().isEmpty() ) {
+		m_exportOptions.fileName += ".png";
+	}
+	
+	SequenceExporter exporter(m_view);
+	
+	QProgressDialog progress(tr("Exporting frames..."), tr("Cancel"), 0, m_exportOptions.frameCount, this);
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(0);
+	connect(&exporter, SIGNAL(progress(int)), &progress, SLOT(setValue(int)));
+	connect(&progress, SIGNAL(canceled()), &exporter, SLOT(cancel()));
+	
+	m_exporting = true;
+	const bool succeed = m_view->exportSequence(&exporter, m_exportOptions);
+	m_exporting = false;
+	progress.reset();
+	
+	if( !succeed && !exporter.errorString().isEmpty() ) {
+		QMessageBox::warning(this, tr("Export Sequence"), exporter.errorString());
+	}
 }
 
 void ScenePanel::selectScene()
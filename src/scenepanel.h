@@ -22,12 +22,14 @@
 
 #include <QtGui/QDockWidget>
 
-class QTimer;
+#include "sequenceexport.h"
+
 class QGLWidget;
 class QMenu;
 
 class Effect;
 class SceneView;
+class FrameProfiler;
 
 class ScenePanel : public QDockWidget
 {
@@ -41,26 +43,45 @@ public:
 	
 	QMenu * menu();
 	
+	const FrameProfiler * profiler() const;
+	
 	void setViewUpdatesEnabled(bool enable);
 	
 	void startAnimation();
 	void stopAnimation();
 	
+	bool isExporting() const;
+	
 	
 public slots:
 	
 	void refresh();
 	void selectScene();	
+	void pollProfiler();
+	
+private slots:
+	
+	void saveScreenshot();
+	void captureFrames(bool enable);
+	void onCaptureFailed(const QString & fileName);
+	void exportSequence();
 	
 private:
 
 	SceneView * m_view;
-	QTimer * m_animationTimer;
 	
 	QMenu * m_sceneMenu;
 	QMenu * m_renderMenu;
 	QAction * m_wireframeAction;
 	QAction * m_orthoAction;
+	QAction * m_timingsAction;
+	QAction * m_progressiveAction;
+	QAction * m_dynamicResolutionAction;
+	QAction * m_overdrawAction;
+	QAction * m_captureAction;
+	
+	SequenceExporter::Options m_exportOptions;
+	bool m_exporting;
 	
 };
 
@@ -0,0 +1,167 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "sequenceexport.h"
+#include "capture.h"
+#include "effect.h"
+#include "glstate.h"
+#include "qglview.h"
+#include "texmanager.h"
+#include "transform.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QEventLoop>
+#include <QtCore/QProcess>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtOpenGL/QGLFramebufferObject>
+
+
+SequenceExporter::SequenceExporter(QGLWidget * widget) : m_widget(widget), m_cancelled(false)
+{
+}
+
+bool SequenceExporter::run(Effect * effect, const Scene * scene, const Matrix4 & modelView, const Matrix4 & projection, const Options & options)
+{
+	m_cancelled = false;
+	m_error.clear();
+
+	// Let pending builds and texture loads land before the first frame, so that every frame renders the same program and textures.
+	// Show the progress meanwhile, so that the wait can be cancelled.
+	emit progress(0);
+	while (effect != NULL && (effect->isBuilding() || TextureLoader::instance()->pendingCount() > 0)) {
+		QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+		if (m_cancelled) {
+			return false;
+		}
+	}
+
+	if (effect == NULL || scene == NULL || !effect->isValid()) {
+		m_error = tr("There is no built effect to export.");
+		return false;
+	}
+
+	if (!QGLFramebufferObject::hasOpenGLFramebufferObjects()) {
+		m_error = tr("Offscreen rendering is not supported.");
+		return false;
+	}
+
+	m_widget->makeCurrent();
+
+	QGLFramebufferObject fbo(options.size, QGLFramebufferObject::Depth);
+	if (!fbo.isValid()) {
+		m_error = tr("Could not create a %1x%2 framebuffer.").arg(options.size.width()).arg(options.size.height());
+		return false;
+	}
+
+	// Creating the framebuffer binds its texture.
+	GLState::invalidate();
+
+	QProcess process;
+	if (options.video) {
+		QStringList arguments;
+		arguments << "-y" << "-f" << "rawvideo" << "-pix_fmt" << "bgra";
+		arguments << "-s" << QString("%1x%2").arg(options.size.width()).arg(options.size.height());
+		arguments << "-r" << QString::number(options.frameRate);
+		arguments << "-i" << "-";
+		
+		// Frames are read bottom up.
+		arguments << "-vf" << "vflip";
+		if (options.size.width() % 2 == 0 && options.size.height() % 2 == 0) {
+			// Most players only decode 4:2:0 video.
+			arguments << "-pix_fmt" << "yuv420p";
+		}
+		arguments << options.fileName;
+
+		process.start(options.ffmpeg, arguments);
+		if (!process.waitForStarted()) {
+			m_error = tr("Could not start '%1'.").arg(options.ffmpeg);
+			return false;
+		}
+	}
+
+	// Encode on every core while the GPU renders.
+	FrameCapture capture(m_widget, QThread::idealThreadCount());
+	connect(&capture, SIGNAL(failed(QString)), this, SLOT(onCaptureFailed(QString)));
+	if (options.video) {
+		capture.setVideoOutput(&process);
+	}
+	capture.startCapture(options.fileName);
+
+	// Textures reloaded during the export are swapped in afterwards.
+	TextureLoader::instance()->setSuspended(true);
+
+	for (int i = 0; i < options.frameCount && !m_cancelled; i++)
+	{
+		effect->setTime(float(options.startTime + i / options.frameRate));
+
+		fbo.bind();
+		glViewport(0, 0, options.size.width(), options.size.height());
+		Transform::load(modelView, projection);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		SceneView::renderEffect(effect, scene);
+
+		capture.readFrame(options.size);
+		fbo.release();
+
+		emit progress(i + 1);
+
+		// Keep the progress dialog responsive, it may repaint other views.
+		QCoreApplication::processEvents();
+		m_widget->makeCurrent();
+	}
+
+	capture.flush();
+	QCoreApplication::sendPostedEvents(&capture, QEvent::User);
+	capture.stopCapture();
+
+	effect->setTime(-1.0f);
+	TextureLoader::instance()->setSuspended(false);
+
+	if (options.video) {
+		process.closeWriteChannel();
+		process.waitForFinished(-1);
+
+		if (m_error.isEmpty() && (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0)) {
+			m_error = tr("ffmpeg failed:\n%1").arg(QString::fromLocal8Bit(process.readAllStandardError().right(1024)));
+		}
+	}
+
+	return m_error.isEmpty() && !m_cancelled;
+}
+
+const QString & SequenceExporter::errorString() const
+{
+	return m_error;
+}
+
+void SequenceExporter::cancel()
+{
+	m_cancelled = true;
+}
+
+void SequenceExporter::onCaptureFailed(const QString & fileName)
+{
+	if (m_error.isEmpty()) {
+		m_error = tr("Could not write '%1'.").arg(fileName);
+	}
+	m_cancelled = true;
+}
@@ -0,0 +1,84 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef SEQUENCEEXPORT_H
+#define SEQUENCEEXPORT_H
+
+#include <QtCore/QObject>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+
+class QGLWidget;
+class Effect;
+class Scene;
+class Matrix4;
+
+
+/// Renders an animated effect offscreen at fixed time steps, and saves the
+/// frames as an image sequence or pipes them to ffmpeg. Frames are read back
+/// and encoded while the next ones render.
+class SequenceExporter : public QObject
+{
+	Q_OBJECT
+public:
+	struct Options
+	{
+		Options() : size(640, 480), frameRate(30.0), frameCount(60), startTime(0.0), video(false), ffmpeg("ffmpeg") {}
+		
+		// Image sequences are numbered after this name.
+		QString fileName;
+		QSize size;
+		double frameRate;
+		int frameCount;
+		double startTime;
+		
+		// Encode a video with the ffmpeg binary.
+		bool video;
+		QString ffmpeg;
+	};
+
+	SequenceExporter(QGLWidget * widget);
+
+	// Renders with the context of the widget.
+	bool run(Effect * effect, const Scene * scene, const Matrix4 & modelView, const Matrix4 & projection, const Options & options);
+
+	const QString & errorString() const;
+
+public slots:
+
+	void cancel();
+
+signals:
+
+	void progress(int frame);
+
+private slots:
+
+	void onCaptureFailed(const QString & fileName);
+
+private:
+
+	QGLWidget * m_widget;
+	bool m_cancelled;
+	QString m_error;
+};
+
+
+#endif // SEQUENCEEXPORT_H
@@ -0,0 +1,453 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "shadercost.h"
+#include "tokenizer.h"
+
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+
+#include <ctype.h>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+	// Relative costs, in ALU instructions.
+	enum {
+		TextureCost = 4,
+		TranscendentalCost = 4,
+		DivideCost = 2,
+		
+		// Iterations assumed for loops without a constant bound.
+		UnknownTrips = 8
+	};
+
+	static const char * const s_textureFunctions[] = {
+		"texture", "textureProj", "textureLod", "textureGrad", "textureOffset", "texelFetch", "textureGather",
+		"texture1D", "texture2D", "texture3D", "textureCube", "texture2DProj", "texture2DLod", "textureCubeLod",
+		"texture2DRect", "shadow2D", "shadow2DProj",
+		"tex1D", "tex2D", "tex3D", "texCUBE", "texRECT", "tex2Dproj", "tex2Dlod", "tex2Dbias", "tex2Dgrad", "texCUBElod",
+		NULL
+	};
+
+	static const char * const s_transcendentalFunctions[] = {
+		"pow", "exp", "exp2", "log", "log2", "sqrt", "inversesqrt", "rsqrt",
+		"sin", "cos", "tan", "asin", "acos", "atan", "atan2", "sinh", "cosh", "tanh",
+		"normalize", "length", "distance", "reflect", "refract", "faceforward", "lit",
+		NULL
+	};
+
+	static const char * const s_textureInstructions[] = {
+		"TEX", "TXP", "TXB", "TXL", "TXD", "TXF", "TXQ",
+		NULL
+	};
+
+	static const char * const s_transcendentalInstructions[] = {
+		"RSQ", "RCP", "POW", "EX2", "LG2", "EXP", "LOG", "SIN", "COS", "SCS", "LIT", "NRM", "DIV",
+		NULL
+	};
+
+	static const char * const s_assemblyDeclarations[] = {
+		"PARAM", "ATTRIB", "TEMP", "OUTPUT", "OPTION", "ADDRESS", "ALIAS", "END",
+		NULL
+	};
+
+	static bool contains(const char * const * list, const QByteArray & name)
+	{
+		for (int i = 0; list[i] != NULL; i++) {
+			if (name == list[i]) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static bool isIdentifier(const QByteArray & text)
+	{
+		return !text.isEmpty() && (isalpha((unsigned char)text.at(0)) || text.at(0) == '_');
+	}
+
+	static bool isNumber(const QByteArray & text)
+	{
+		return !text.isEmpty() && (isdigit((unsigned char)text.at(0)) || text.at(0) == '.');
+	}
+
+	// Number of vec4 registers taken by a variable of the given type, 0 if it is not a type.
+	static int typeRegisters(const QByteArray & type)
+	{
+		static const char * const scalars[] = { "float", "int", "uint", "bool", "half", "fixed", "double", NULL };
+		if (contains(scalars, type)) {
+			return 1;
+		}
+		
+		// Vectors: vec3, ivec2, float4, half3...
+		static const char * const vectors[] = { "vec", "ivec", "uvec", "bvec", "dvec", "float", "int", "half", "fixed", "bool", NULL };
+		for (int i = 0; vectors[i] != NULL; i++) {
+			const int length = qstrlen(vectors[i]);
+			if (type.size() == length + 1 && type.startsWith(vectors[i]) && type.at(length) >= '2' && type.at(length) <= '4') {
+				return 1;
+			}
+		}
+		
+		// Matrices use a register per column: mat3, mat4x3, float4x4...
+		static const char * const matrices[] = { "mat", "dmat", "float", "half", NULL };
+		for (int i = 0; matrices[i] != NULL; i++) {
+			const int length = qstrlen(matrices[i]);
+			if (type.startsWith(matrices[i]) && type.size() > length) {
+				const char columns = type.at(length);
+				if (columns >= '2' && columns <= '4' && (type.size() == length + 1 || (type.size() == length + 3 && type.at(length + 1) == 'x'))) {
+					return columns - '0';
+				}
+			}
+		}
+		
+		return 0;
+	}
+
+	// Cost of an operator token, which may hold a run of operators like "=-".
+	static int operatorCost(const QByteArray & op)
+	{
+		if (op == "=" || op == "?" || op == ":" || op == "!") {
+			return 0;
+		}
+		return op.contains('/') ? DivideCost : 1;
+	}
+
+	// Iterations of a for loop with a header like "int i = 0; i < 16; i++".
+	static int forTrips(const QList<Token> & header)
+	{
+		// Find the start value and the bound.
+		int init = -1;
+		int condition = -1;
+		for (int i = 0; i < header.count(); i++) {
+			if (header.at(i).text == ";") {
+				if (init == -1) {
+					init = i;
+				}
+				else {
+					condition = i;
+					break;
+				}
+			}
+		}
+		if (init < 2 || condition < init + 4) {
+			return -1;
+		}
+		
+		const QByteArray & start = header.at(init - 1).text;
+		const QByteArray & op = header.at(condition - 2).text;
+		const QByteArray & bound = header.at(condition - 1).text;
+		if (header.at(init - 2).text != "=" || !isNumber(start) || !isNumber(bound)) {
+			return -1;
+		}
+		
+		// The step, 1 unless it is "+= n" or "-= n".
+		double step = 1;
+		for (int i = condition + 1; i + 1 < header.count(); i++) {
+			if ((header.at(i).text == "+=" || header.at(i).text == "-=") && isNumber(header.at(i + 1).text)) {
+				step = header.at(i + 1).text.toDouble();
+				break;
+			}
+		}
+		if (step <= 0) {
+			return -1;
+		}
+		
+		double range = fabs(bound.toDouble() - start.toDouble());
+		if (op == "<=" || op == ">=") {
+			range += 1;
+		}
+		else if (op != "<" && op != ">" && op != "!=") {
+			return -1;
+		}
+		return int(ceil(range / step));
+	}
+
+	// Block of code that is repeated by a loop.
+	struct Scope
+	{
+		int multiplier;
+		int braceDepth;
+		bool braced;
+	};
+
+	static int lineCount(const QByteArray & source)
+	{
+		return source.count('\n') + 1;
+	}
+
+} // namespace
+
+
+QString ShaderCost::summary() const
+{
+	QStringList trips;
+	foreach (int count, loopTrips) {
+		trips << (count < 0 ? QString("?") : QString::number(count));
+	}
+
+	QString text;
+	if (native) {
+		text = QObject::tr("%1 instructions, %2 texture fetches, %3 temporaries").arg(instructions).arg(textureFetches).arg(temporaries);
+	}
+	else {
+		text = QObject::tr("~%1 instructions, %2 texture fetches, ~%3 temporaries").arg(instructions).arg(textureFetches).arg(temporaries);
+	}
+	if (!trips.isEmpty()) {
+		text += QObject::tr(", loop iterations: %1").arg(trips.join(", "));
+	}
+	return text;
+}
+
+//static
+ShaderCost ShaderCost::estimate(const QByteArray & source)
+{
+	ShaderCost cost;
+	cost.lineCosts.fill(0, lineCount(source));
+
+	const QList<Token> tokens = tokenize(source);
+	const int count = tokens.count();
+
+	QList<Scope> scopes;
+	int braceDepth = 0;
+	
+	// Braces of struct declarations do not hold code.
+	int structDepth = -1;
+	bool structPending = false;
+	
+	// Multiplier of the loop body that starts at the next token.
+	int pendingTrips = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		const Token & token = tokens.at(i);
+		if (token.directive) {
+			continue;
+		}
+		
+		const QByteArray & text = token.text;
+		const QByteArray & next = (i + 1 < count) ? tokens.at(i + 1).text : QByteArray();
+		
+		if (pendingTrips != 0) {
+			// Loop bodies are a block or a single statement.
+			Scope scope;
+			scope.multiplier = (scopes.isEmpty() ? 1 : scopes.last().multiplier) * pendingTrips;
+			scope.braceDepth = braceDepth;
+			scope.braced = (text == "{");
+			scopes.append(scope);
+			pendingTrips = 0;
+		}
+		
+		const int multiplier = scopes.isEmpty() ? 1 : scopes.last().multiplier;
+		const bool code = braceDepth > 0 && structDepth == -1;
+		
+		int tokenCost = 0;
+		
+		if (text == "struct") {
+			structPending = true;
+		}
+		else if (text == "{") {
+			if (structPending && structDepth == -1) {
+				structDepth = braceDepth;
+			}
+			structPending = false;
+			braceDepth++;
+		}
+		else if (text == "}") {
+			braceDepth--;
+			if (braceDepth == structDepth) {
+				structDepth = -1;
+			}
+			
+			// Close the loop bodies that end with this block.
+			while (!scopes.isEmpty() && scopes.last().braceDepth >= braceDepth && (scopes.last().braced || scopes.last().braceDepth > braceDepth)) {
+				const bool braced = scopes.last().braced;
+				scopes.removeLast();
+				if (braced) {
+					break;
+				}
+			}
+		}
+		else if (text == ";") {
+			structPending = false;
+			
+			// Single statement loop bodies end here.
+			while (!scopes.isEmpty() && !scopes.last().braced && scopes.last().braceDepth == braceDepth) {
+				scopes.removeLast();
+			}
+		}
+		else if ((text == "for" || text == "while") && next == "(" && code) {
+			// Collect the loop header.
+			QList<Token> header;
+			int depth = 0;
+			int j = i + 1;
+			for (; j < count; j++) {
+				if (tokens.at(j).text == "(") {
+					depth++;
+				}
+				else if (tokens.at(j).text == ")" && --depth == 0) {
+					break;
+				}
+				if (j > i + 1) {
+					header.append(tokens.at(j));
+				}
+			}
+			
+			// The condition of a do-while loop does not start a loop.
+			if (j + 1 < count && tokens.at(j + 1).text == ";") {
+				i = j;
+				continue;
+			}
+			
+			const int trips = (text == "for") ? forTrips(header) : -1;
+			cost.loopTrips.append(trips);
+			
+			// Evaluating the condition costs an instruction per iteration.
+			const int iterations = trips < 0 ? UnknownTrips : trips;
+			cost.lineCosts[token.line - 1] += multiplier * iterations;
+			cost.instructions++;
+			
+			pendingTrips = qMax(iterations, 1);
+			i = j;
+			continue;
+		}
+		else if (text == "do" && next == "{" && code) {
+			cost.loopTrips.append(-1);
+			pendingTrips = UnknownTrips;
+		}
+		else if (isIdentifier(text) && next == "(" && code) {
+			if (contains(s_textureFunctions, text)) {
+				tokenCost = TextureCost;
+				cost.textureFetches++;
+			}
+			else if (contains(s_transcendentalFunctions, text)) {
+				tokenCost = TranscendentalCost;
+			}
+			else if (text == "mul") {
+				// Cg matrix product, a dot product per row.
+				tokenCost = 4;
+			}
+		}
+		else if (isIdentifier(text) && isIdentifier(next) && code) {
+			// Local declarations, "vec3 a, b;" takes two registers.
+			const int registers = typeRegisters(text);
+			if (registers > 0) {
+				int variables = 1;
+				int depth = 0;
+				for (int j = i + 2; j < count && tokens.at(j).text != ";"; j++) {
+					const QByteArray & t = tokens.at(j).text;
+					if (t == "(" || t == "[") {
+						depth++;
+					}
+					else if (t == ")" || t == "]") {
+						depth--;
+					}
+					else if (t == "," && depth == 0) {
+						variables++;
+					}
+					else if (t == "{" || t == "}") {
+						// A function definition.
+						variables = 0;
+						break;
+					}
+				}
+				cost.temporaries += registers * variables;
+			}
+		}
+		else if (!isIdentifier(text) && !isNumber(text) && code && text.size() <= 3 && strchr("+-*/%<>=&|^", text.at(0)) != NULL) {
+			tokenCost = operatorCost(text);
+		}
+		
+		if (tokenCost > 0) {
+			cost.instructions += tokenCost;
+			cost.lineCosts[token.line - 1] += tokenCost * multiplier;
+		}
+	}
+
+	return cost;
+}
+
+//static
+ShaderCost ShaderCost::estimateAssembly(const QByteArray & source)
+{
+	ShaderCost cost;
+	cost.lineCosts.fill(0, lineCount(source));
+
+	const QList<Token> tokens = tokenize(source);
+	const int count = tokens.count();
+
+	// The first token of every statement is the opcode.
+	bool statementStart = true;
+	for (int i = 0; i < count; i++)
+	{
+		const Token & token = tokens.at(i);
+		
+		if (token.text == ";") {
+			statementStart = true;
+			continue;
+		}
+		if (!statementStart) {
+			continue;
+		}
+		statementStart = false;
+		
+		// Skip the header, like "!!ARBfp1.0".
+		if (token.text.startsWith("!!")) {
+			while (i + 1 < count && tokens.at(i + 1).line == token.line) {
+				i++;
+			}
+			statementStart = true;
+			continue;
+		}
+		
+		// Remove the saturation suffix.
+		QByteArray opcode = token.text;
+		if (opcode.endsWith("_SAT")) {
+			opcode.chop(4);
+		}
+		
+		if (opcode == "TEMP") {
+			for (int j = i + 1; j < count && tokens.at(j).text != ";"; j++) {
+				if (isIdentifier(tokens.at(j).text)) {
+					cost.temporaries++;
+				}
+			}
+			continue;
+		}
+		if (!isIdentifier(opcode) || contains(s_assemblyDeclarations, opcode)) {
+			continue;
+		}
+		
+		int instructionCost = 1;
+		if (contains(s_textureInstructions, opcode)) {
+			instructionCost = TextureCost;
+			cost.textureFetches++;
+		}
+		else if (contains(s_transcendentalInstructions, opcode)) {
+			instructionCost = TranscendentalCost;
+		}
+		
+		cost.instructions++;
+		cost.lineCosts[token.line - 1] += instructionCost;
+	}
+
+	return cost;
+}
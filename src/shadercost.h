@@ -0,0 +1,59 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef SHADERCOST_H
+#define SHADERCOST_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+
+/// Static cost of a shader stage. The counts are estimated from the source,
+/// unless the driver reported the native counts of the compiled program.
+struct ShaderCost
+{
+	ShaderCost() : instructions(0), textureFetches(0), temporaries(0), native(false) {}
+
+	int instructions;
+	int textureFetches;
+	int temporaries;
+
+	// Iterations of each loop, -1 when the bound is not a constant.
+	QList<int> loopTrips;
+
+	// Weighted cost of each source line, including the loop iterations.
+	QVector<int> lineCosts;
+
+	// The counts come from the driver.
+	bool native;
+
+	QString summary() const;
+
+	// Estimate the cost of GLSL or Cg code.
+	static ShaderCost estimate(const QByteArray & source);
+
+	// Estimate the cost of an ARB vertex or fragment program.
+	static ShaderCost estimateAssembly(const QByteArray & source);
+};
+
+
+#endif // SHADERCOST_H
@@ -71,7 +71,9 @@
  * OpenGL(TM) is a trademark of Silicon Graphics, Inc.
  */
 
-#include <GL/glew.h>
+#include "mesh.h"
+
+#include <math.h>
 
 
 /* -- PRIVATE FUNCTIONS ---------------------------------------------------- */
@@ -172,28 +174,105 @@ static double cpdata[][3] =
 	{ 0.84,   -1.5,    0.075  }
 };
 
-static double tex[2][2][2] =
+/* Bernstein basis and its derivative. */
+static void bernstein( double t, double b[4], double d[4] )
 {
-	{ {0.0, 0.0}, {1.0, 0.0} },
-	{ {0.0, 1.0}, {1.0, 1.0} }
-};
+	double s = 1.0 - t;
+
+	b[0] = s * s * s;
+	b[1] = 3.0 * t * s * s;
+	b[2] = 3.0 * t * t * s;
+	b[3] = t * t * t;
 
-static void teapot( GLint grid, GLdouble scale, GLenum type )
+	d[0] = -3.0 * s * s;
+	d[1] = 3.0 * s * s - 6.0 * t * s;
+	d[2] = 6.0 * t * s - 3.0 * t * t;
+	d[3] = 3.0 * t * t;
+}
+
+/*
+ * Evaluate the patch like glMap2d with ustride 3 and vstride 12, the
+ * normal is du x dv like GL_AUTO_NORMAL.
+ */
+static void evalPatch( double p[4][4][3], double u, double v, double pos[3], double normal[3] )
 {
-	double p[4][4][3], q[4][4][3], r[4][4][3], s[4][4][3];
-	long i, j, k, l;
+	double bu[4], du[4], bv[4], dv[4];
+	double tu[3] = { 0.0, 0.0, 0.0 }, tv[3] = { 0.0, 0.0, 0.0 };
+	long j, k, l;
+
+	bernstein( u, bu, du );
+	bernstein( v, bv, dv );
+
+	for( l = 0; l < 3; l++ )
+	{
+		pos[l] = 0.0;
+		for( j = 0; j < 4; j++ )
+			for( k = 0; k < 4; k++ )
+		{
+			pos[l] += bv[j] * bu[k] * p[j][k][l];
+			tu[l] += bv[j] * du[k] * p[j][k][l];
+			tv[l] += dv[j] * bu[k] * p[j][k][l];
+		}
+	}
+
+	normal[0] = tu[1] * tv[2] - tu[2] * tv[1];
+	normal[1] = tu[2] * tv[0] - tu[0] * tv[2];
+	normal[2] = tu[0] * tv[1] - tu[1] * tv[0];
+}
+
+static void evalMesh( Mesh & mesh, double p[4][4][3], GLint grid )
+{
+	GLuint first = mesh.vertexCount();
+	long i, j;
 
-	glPushAttrib( GL_ENABLE_BIT | GL_EVAL_BIT );
-	glEnable( GL_AUTO_NORMAL );
-	glEnable( GL_NORMALIZE );
-	glEnable( GL_MAP2_VERTEX_3 );
-	glEnable( GL_MAP2_TEXTURE_COORD_2 );
+	for( j = 0; j <= grid; j++ )
+	{
+		for( i = 0; i <= grid; i++ )
+		{
+			/* Same grid as glMapGrid2d(grid, 1.0, 0.0, grid, 0.0, 1.0) */
+			double u = 1.0 - double( i ) / grid;
+			double v = double( j ) / grid;
+			double pos[3], normal[3];
 
-//	glPushMatrix();
-	/* Need this to put top of the teapot towards +Z */
-//	glRotated(270.0, 1.0, 0.0, 0.0);
-//	glScaled(0.5 * scale, 0.5 * scale, 0.5 * scale);
-//	glTranslated(0.0, 0.0, -1.5);
+			evalPatch( p, u, v, pos, normal );
+
+			double length = sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+			if( length < 1e-9 )
+			{
+				/* Degenerate corner, take the normal from slightly inside the patch. */
+				double tmp[3];
+				evalPatch( p, u + ( u < 0.5 ? 1e-3 : -1e-3 ), v + ( v < 0.5 ? 1e-3 : -1e-3 ), tmp, normal );
+				length = sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+			}
+			if( length > 0.0 )
+			{
+				normal[0] /= length;
+				normal[1] /= length;
+				normal[2] /= length;
+			}
+
+			/* The texture map is the identity on the patch domain. */
+			mesh.addVertex( Mesh::Vertex( pos[0], pos[1], pos[2], normal[0], normal[1], normal[2], u, v ) );
+		}
+	}
+
+	/* Same triangles and winding as the glEvalMesh2 quad strips. */
+	for( j = 0; j < grid; j++ )
+	{
+		for( i = 0; i < grid; i++ )
+		{
+			GLuint a0 = first + j * ( grid + 1 ) + i;
+			GLuint b0 = a0 + grid + 1;
+			mesh.addTriangle( a0, b0, b0 + 1 );
+			mesh.addTriangle( a0, b0 + 1, a0 + 1 );
+		}
+	}
+}
+
+static void teapot( Mesh & mesh, GLint grid )
+{
+	double p[4][4][3], q[4][4][3], r[4][4][3], s[4][4][3];
+	long i, j, k, l;
 
 	for( i = 0; i < 10; i++ )
 	{
@@ -219,34 +298,20 @@ static void teapot( GLint grid, GLdouble scale, GLenum type )
 			}
 		}
 
-		glMap2d(GL_MAP2_TEXTURE_COORD_2, 0.0, 1.0, 2, 2, 0.0, 1.0, 4, 2,
-				&tex[0][0][0]);
-		glMap2d(GL_MAP2_VERTEX_3, 0.0, 1.0, 3, 4, 0.0, 1.0, 12, 4,
-				&p[0][0][0]);
-		glMapGrid2d(grid, 1.0, 0.0, grid, 0.0, 1.0);
-		glEvalMesh2(type, 0, grid, 0, grid);
-		glMap2d(GL_MAP2_VERTEX_3, 0.0, 1.0, 3, 4, 0.0, 1.0, 12, 4,
-				&q[0][0][0]);
-		glEvalMesh2(type, 0, grid, 0, grid);
+		evalMesh( mesh, p, grid );
+		evalMesh( mesh, q, grid );
 		if( i < 6 )
 		{
-			glMap2d(GL_MAP2_VERTEX_3, 0.0, 1.0, 3, 4, 0.0, 1.0, 12, 4,
-					&r[0][0][0]);
-			glEvalMesh2(type, 0, grid, 0, grid);
-			glMap2d(GL_MAP2_VERTEX_3, 0.0, 1.0, 3, 4, 0.0, 1.0, 12, 4,
-					&s[0][0][0]);
-			glEvalMesh2(type, 0, grid, 0, grid);
+			evalMesh( mesh, r, grid );
+			evalMesh( mesh, s, grid );
 		}
 	}
-
-//	glPopMatrix();
-	glPopAttrib();
 }
 
 
 /* -- INTERFACE FUNCTIONS -------------------------------------------------- */
 
-void drawTeapot()
+void buildTeapot( Mesh & mesh )
 {
-	teapot( 14, 1.0f, GL_FILL );
+	teapot( mesh, 14 );
 }
@@ -21,39 +21,165 @@
 #include "texmanager.h"
 #include "glutils.h"
 #include "imageplugin.h"
+#include "glstate.h"
 
 #include <QtCore/QSharedData>
 #include <QtCore/QDebug>
+#include <QtCore/QMap>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QEvent>
+#include <QtCore/QRunnable>
 #include <QtGui/QImage>
+#include <QtOpenGL/QGLContext>
+
+
+namespace
+{
+	// Size of the previews read back from the textures.
+	static const int s_previewSize = 256;
+	
+	// Make a context current for the scope, and restore the previous one.
+	class ContextScope
+	{
+	public:
+		ContextScope(const QGLContext * context) : m_previous(QGLContext::currentContext())
+		{
+			if( context != NULL && context != m_previous ) {
+				const_cast<QGLContext *>(context)->makeCurrent();
+			}
+		}
+		~ContextScope()
+		{
+			if( m_previous != NULL && m_previous != QGLContext::currentContext() ) {
+				const_cast<QGLContext *>(m_previous)->makeCurrent();
+			}
+		}
+	private:
+		const QGLContext * m_previous;
+	};
+	
+	// Bytes per texel of the uncompressed internal formats. Drivers pad RGB to four channels.
+	static int texelSize(GLint format)
+	{
+		switch (format) {
+			case GL_LUMINANCE8:
+			case GL_ALPHA8:
+			case GL_INTENSITY8:
+				return 1;
+			case GL_LUMINANCE8_ALPHA8:
+			case GL_LUMINANCE16:
+			case GL_LUMINANCE16F_ARB:
+				return 2;
+			case GL_LUMINANCE16_ALPHA16:
+			case GL_LUMINANCE_ALPHA16F_ARB:
+			case GL_LUMINANCE32F_ARB:
+				return 4;
+			case GL_RGB16:
+			case GL_RGBA16:
+			case GL_RGB16F_ARB:
+			case GL_RGBA16F_ARB:
+			case GL_LUMINANCE_ALPHA32F_ARB:
+				return 8;
+			case GL_RGB32F_ARB:
+			case GL_RGBA32F_ARB:
+				return 16;
+		}
+		return 4;
+	}
+	
+	// Estimated size of the bound texture in video memory, the mipmaps add a third.
+	static qint64 estimateVideoMemory(GLenum target)
+	{
+		GLint width = 0, height = 0, format = 0, compressed = GL_FALSE;
+		glGetTexLevelParameteriv(target, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(target, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(target, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+		glGetTexLevelParameteriv(target, 0, GL_TEXTURE_COMPRESSED, &compressed);
+		
+		qint64 size = qint64(width) * height * texelSize(format);
+		if( compressed ) {
+			GLint bytes = 0;
+			glGetTexLevelParameteriv(target, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &bytes);
+			size = bytes;
+		}
+		return size + size / 3;
+	}
+	
+	static qint64 imageMemory(const QImage & image)
+	{
+		return qint64(image.bytesPerLine()) * image.height();
+	}
+	
+	// Posted by the decoding jobs.
+	class DecodedEvent : public QEvent
+	{
+	public:
+		DecodedEvent(const QString & name, int serial, const ImageData & data) : QEvent(QEvent::User),
+			m_name(name), m_serial(serial), m_data(data)
+		{
+		}
+		const QString & name() const { return m_name; }
+		int serial() const { return m_serial; }
+		const ImageData & data() const { return m_data; }
+	private:
+		QString m_name;
+		int m_serial;
+		ImageData m_data;
+	};
+	
+	class DecodeJob : public QRunnable
+	{
+	public:
+		DecodeJob(QObject * receiver, const QString & name, int serial, const TextureCaps & caps) :
+			m_receiver(receiver), m_name(name), m_serial(serial), m_caps(caps)
+		{
+		}
+		virtual void run()
+		{
+			ImageData data = ImagePluginManager::decode(m_name, m_caps);
+			QCoreApplication::postEvent(m_receiver, new DecodedEvent(m_name, m_serial, data));
+		}
+	private:
+		QObject * m_receiver;
+		QString m_name;
+		int m_serial;
+		TextureCaps m_caps;
+	};
+	
+} // namespace
 
 
 class GLTexture::Private : public QSharedData
 {
 public:
-	Private()
+	Private() : m_context(QGLContext::currentContext()), m_loading(false)
 	{
 		glGenTextures(1, &m_object);
 		
 		// load default texture
-		m_image = ImagePluginManager::load(":images/default.png", m_object, &m_target);
-		m_icon = m_image.scaled(16, 16, Qt::KeepAspectRatio, Qt::FastTransformation);
+		loadDefault();
+		touch();
 	}
-	Private(const QString & name) : m_name(name)
+	Private(const QString & name) : m_name(name), m_context(QGLContext::currentContext()), m_loading(true)
 	{
 		glGenTextures(1, &m_object);
 		
-		m_image = ImagePluginManager::load(m_name, m_object, &m_target);
-		m_icon = m_image.scaled(16, 16, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+		// Show the default texture until the image is decoded.
+		loadDefault();
+		touch();
+		
+		TextureLoader::instance()->load(m_name);
 	}
 	~Private()
 	{
 		if(m_object != 0) {
 			qDebug() << "eliminate:" << m_name;
 			
-			// Remove from the cache.
-			s_textureMap.remove(m_name);
+			TextureLoader::instance()->cancel(m_name);
 			
-			glDeleteTextures(1, &m_object);
+			// The cache can release textures of other contexts.
+			ContextScope scope(m_context);
+			GLState::deleteTexture(m_object);
 			m_object = 0;
 		}
 	}
@@ -62,22 +188,139 @@ public:
 	GLuint object() const { return m_object; }
 	GLuint target() const { return m_target; }
 	QImage icon() const { return m_icon; }
-	QImage image() const { return m_image; }
+	bool isLoading() const { return m_loading; }
+	
+	QImage image() const
+	{
+		touch();
+		if( m_image.isNull() ) {
+			m_image = readImage();
+		}
+		return m_image;
+	}
+	
+	// Swap in the decoded image, keeping the sampling state of the texture.
+	void finishLoad(const ImageData & data)
+	{
+		m_loading = false;
+		
+		if( data.isNull() ) {
+			qWarning() << "failed to load:" << m_name;
+			return;
+		}
+		
+		ImagePluginManager::upload(data, m_object, &m_target);
+		m_videoMemory = estimateVideoMemory(m_target);
+		
+		// Only the icon stays in memory, the preview is read back when it is needed.
+		m_icon = data.preview.scaled(16, 16, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+		m_image = QImage();
+	}
+	
+	qint64 hostMemory() const { return imageMemory(m_icon) + imageMemory(m_image); }
+	qint64 videoMemory() const { return m_videoMemory; }
+	
+	quint64 lastUse() const { return m_lastUse; }
+	void touch() const { m_lastUse = ++s_useCount; }
+	
+	// Returns the freed memory.
+	qint64 dropImage()
+	{
+		const qint64 size = imageMemory(m_image);
+		m_image = QImage();
+		return size;
+	}
+	
+	// The cache keeps a reference, so that the texture outlives the effects that use it.
+	static void retain(Private * p)
+	{
+		p->ref.ref();
+		s_textureMap[p->m_name] = p;
+	}
+	static void release(Private * p)
+	{
+		s_textureMap.remove(p->m_name);
+		if( !p->ref.deref() ) {
+			delete p;
+		}
+	}
+	
+	// Not used by any effect.
+	bool isUnused() const { return ref == 1; }
+	
+	// Textures of the cache, least recently used first.
+	static QMap<quint64, Private *> leastRecentlyUsed()
+	{
+		QMap<quint64, Private *> textures;
+		foreach (Private * p, s_textureMap) {
+			textures.insert(p->m_lastUse, p);
+		}
+		return textures;
+	}
 
 	static QMap<QString, GLTexture::Private *> s_textureMap;
 
 private:
+	void loadDefault()
+	{
+		const QImage image = ImagePluginManager::load(":images/default.png", m_object, &m_target);
+		m_icon = image.scaled(16, 16, Qt::KeepAspectRatio, Qt::FastTransformation);
+		m_videoMemory = estimateVideoMemory(m_target);
+	}
+	
+	// Read a level that fits in the preview back from the texture.
+	QImage readImage() const
+	{
+		ContextScope scope(m_context);
+		GLState::bindTexture(m_target, m_object);
+		
+		GLint width = 0, height = 0, maxLevel = 0;
+		glGetTexLevelParameteriv(m_target, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(m_target, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTexParameteriv(m_target, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+		if( width <= 0 || height <= 0 ) {
+			return QImage();
+		}
+		
+		int level = 0;
+		while( level < maxLevel && (width > s_previewSize || height > s_previewSize) ) {
+			width = qMax(1, width / 2);
+			height = qMax(1, height / 2);
+			level++;
+		}
+		
+		QImage image(width, height, QImage::Format_ARGB32);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glGetTexImage(m_target, level, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, image.bits());
+		ReportGLErrors();
+		
+		// Textures with few stored mipmaps.
+		if( width > s_previewSize || height > s_previewSize ) {
+			image = image.scaled(s_previewSize, s_previewSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+		}
+		return image;
+	}
+	
 	QString m_name;
+	const QGLContext * m_context;
 	GLuint m_object;
 	GLuint m_target;
+	bool m_loading;
+	qint64 m_videoMemory;
+	mutable quint64 m_lastUse;
 
 	QImage m_icon;
-	QImage m_image;
+	mutable QImage m_image;
+	
+	static quint64 s_useCount;
 };
 
 //static
 QMap<QString, GLTexture::Private *> GLTexture::Private::s_textureMap;
 
+//static
+quint64 GLTexture::Private::s_useCount = 0;
+
 
 GLTexture::GLTexture() : m_data(new Private)
 {
@@ -94,6 +337,11 @@ void GLTexture::operator= (const GLTexture & t)
 }
 GLTexture::~GLTexture()
 {
+	// Once only the cache holds the texture, it counts against the budgets.
+	const Private * p = m_data.constData();
+	if( p != NULL && p->ref == 2 && Private::s_textureMap.value(p->name()) == p ) {
+		TextureCache::instance()->scheduleTrim();
+	}
 }
 
 // static
@@ -101,15 +349,17 @@ GLTexture GLTexture::open(const QString & name)
 {
 	qDebug() << "open:" << name;
 	
-	Private * p;
-	if( Private::s_textureMap.contains(name) ) {
-		p = Private::s_textureMap[name];
-	}
-	else {
+	Private * p = Private::s_textureMap.value(name);
+	if( p == NULL ) {
 		p = new GLTexture::Private(name);
-		Private::s_textureMap[name] = p;
+		Private::retain(p);
 	}
-	return GLTexture(p);
+	p->touch();
+	
+	// Hold the reference before trimming, so that the texture is not released.
+	GLTexture texture(p);
+	TextureCache::instance()->trim();
+	return texture;
 }
 
 const QString& GLTexture::name() const
@@ -139,9 +389,14 @@ QImage GLTexture::image() const
 	return m_data->image();
 }
 
+bool GLTexture::isLoading() const
+{
+	return m_data->isLoading();
+}
+
 GLint GLTexture::wrapS() const
 {
-	glBindTexture(m_data->target(), m_data->object());
+	GLState::bindTexture(m_data->target(), m_data->object());
 	GLint wrap;
 	glGetTexParameteriv(m_data->target(), GL_TEXTURE_WRAP_S, &wrap);
 	return wrap;
@@ -149,7 +404,7 @@ GLint GLTexture::wrapS() const
 
 GLint GLTexture::wrapT() const
 {
-	glBindTexture(m_data->target(), m_data->object());
+	GLState::bindTexture(m_data->target(), m_data->object());
 	GLint wrap;
 	glGetTexParameteriv(m_data->target(), GL_TEXTURE_WRAP_T, &wrap);
 	return wrap;
@@ -157,14 +412,14 @@ GLint GLTexture::wrapT() const
 
 void GLTexture::setWrapMode(GLint s, GLint t) const
 {
-	glBindTexture(m_data->target(), m_data->object());
+	GLState::bindTexture(m_data->target(), m_data->object());
  	glTexParameteri(m_data->target(), GL_TEXTURE_WRAP_S, s);
  	glTexParameteri(m_data->target(), GL_TEXTURE_WRAP_T, t);
 }
 
 GLint GLTexture::minifyingFilter() const
 {
-	glBindTexture(m_data->target(), m_data->object());
+	GLState::bindTexture(m_data->target(), m_data->object());
 	GLint mode;
 	glGetTexParameteriv(m_data->target(), GL_TEXTURE_MIN_FILTER, &mode);
 	return mode;
@@ -172,7 +427,7 @@ GLint GLTexture::minifyingFilter() const
 
 GLint GLTexture::magnificationFilter() const
 {
-	glBindTexture(m_data->target(), m_data->object());
+	GLState::bindTexture(m_data->target(), m_data->object());
 	GLint mode;
 	glGetTexParameteriv(m_data->target(), GL_TEXTURE_MAG_FILTER, &mode);
 	return mode;
@@ -180,7 +435,226 @@ GLint GLTexture::magnificationFilter() const
 
 void GLTexture::setFilteringMode(GLint min, GLint mag) const
 {
-        glBindTexture(m_data->target(), m_data->object());
+	GLState::bindTexture(m_data->target(), m_data->object());
  	glTexParameteri(m_data->target(), GL_TEXTURE_MIN_FILTER, min);
  	glTexParameteri(m_data->target(), GL_TEXTURE_MAG_FILTER, mag);
 }
+
+
+TextureLoader::TextureLoader() : m_serial(0), m_suspended(false)
+{
+}
+
+//static
+TextureLoader * TextureLoader::instance()
+{
+	static TextureLoader loader;
+	return &loader;
+}
+
+// Must be called with the context of the texture current.
+void TextureLoader::load(const QString & name)
+{
+	Request request;
+	request.serial = ++m_serial;
+	request.context = QGLContext::currentContext();
+	m_requests[name] = request;
+	
+	m_pool.start(new DecodeJob(this, name, request.serial, TextureCaps::current()));
+}
+
+void TextureLoader::cancel(const QString & name)
+{
+	m_requests.remove(name);
+}
+
+int TextureLoader::pendingCount() const
+{
+	return m_requests.count();
+}
+
+void TextureLoader::setSuspended(bool suspended)
+{
+	m_suspended = suspended;
+	
+	if( !suspended ) {
+		const QList<Decoded> deferred = m_deferred;
+		m_deferred.clear();
+		foreach (const Decoded & decoded, deferred) {
+			finishLoad(decoded.name, decoded.serial, decoded.data);
+		}
+	}
+}
+
+bool TextureLoader::isSuspended() const
+{
+	return m_suspended;
+}
+
+void TextureLoader::customEvent(QEvent * event)
+{
+	if( event->type() != QEvent::User ) {
+		return;
+	}
+	
+	const DecodedEvent * decoded = static_cast<DecodedEvent *>(event);
+	
+	if( m_suspended ) {
+		Decoded deferred = { decoded->name(), decoded->serial(), decoded->data() };
+		m_deferred.append(deferred);
+		return;
+	}
+	
+	finishLoad(decoded->name(), decoded->serial(), decoded->data());
+}
+
+void TextureLoader::finishLoad(const QString & name, int serial, const ImageData & data)
+{
+	// Drop the results of canceled and superseded requests.
+	QHash<QString, Request>::iterator it = m_requests.find(name);
+	if( it == m_requests.end() || it->serial != serial ) {
+		return;
+	}
+	const QGLContext * context = it->context;
+	m_requests.erase(it);
+	
+	GLTexture::Private * p = GLTexture::Private::s_textureMap.value(name);
+	if( p == NULL ) {
+		return;
+	}
+	
+	// Upload in the context that created the texture, and restore the current one.
+	{
+		ContextScope scope(context);
+		p->finishLoad(data);
+	}
+	
+	// The texture now takes its real size.
+	TextureCache::instance()->trim();
+	
+	emit loaded(name);
+}
+
+
+TextureCache::TextureCache() : m_hostBudget(32 * 1024 * 1024), m_videoBudget(256 * 1024 * 1024), m_trimScheduled(false)
+{
+}
+
+//static
+TextureCache * TextureCache::instance()
+{
+	static TextureCache cache;
+	return &cache;
+}
+
+QList<TextureCache::Entry> TextureCache::entries() const
+{
+	QList<Entry> list;
+	foreach (const GLTexture::Private * p, GLTexture::Private::leastRecentlyUsed()) {
+		Entry entry;
+		entry.name = p->name();
+		entry.references = int(p->ref) - 1;
+		entry.loading = p->isLoading();
+		entry.hostMemory = p->hostMemory();
+		entry.videoMemory = p->videoMemory();
+		list.prepend(entry);
+	}
+	return list;
+}
+
+qint64 TextureCache::hostMemory() const
+{
+	qint64 size = 0;
+	foreach (const GLTexture::Private * p, GLTexture::Private::s_textureMap) {
+		size += p->hostMemory();
+	}
+	return size;
+}
+
+qint64 TextureCache::videoMemory() const
+{
+	qint64 size = 0;
+	foreach (const GLTexture::Private * p, GLTexture::Private::s_textureMap) {
+		size += p->videoMemory();
+	}
+	return size;
+}
+
+qint64 TextureCache::hostBudget() const
+{
+	return m_hostBudget;
+}
+
+void TextureCache::setHostBudget(qint64 size)
+{
+	m_hostBudget = size;
+	trim();
+}
+
+qint64 TextureCache::videoBudget() const
+{
+	return m_videoBudget;
+}
+
+void TextureCache::setVideoBudget(qint64 size)
+{
+	m_videoBudget = size;
+	trim();
+}
+
+void TextureCache::trim()
+{
+	m_trimScheduled = false;
+	
+	const QMap<quint64, GLTexture::Private *> textures = GLTexture::Private::leastRecentlyUsed();
+	qint64 host = hostMemory();
+	qint64 video = videoMemory();
+	
+	// Drop the previews first, they are read back from the textures when needed.
+	foreach (GLTexture::Private * p, textures) {
+		if( host <= m_hostBudget ) {
+			break;
+		}
+		host -= p->dropImage();
+	}
+	
+	// Textures that effects still use are never released.
+	foreach (GLTexture::Private * p, textures) {
+		if( host <= m_hostBudget && video <= m_videoBudget ) {
+			break;
+		}
+		if( p->isUnused() ) {
+			host -= p->hostMemory();
+			video -= p->videoMemory();
+			GLTexture::Private::release(p);
+		}
+	}
+	
+	emit changed();
+}
+
+void TextureCache::scheduleTrim()
+{
+	if( !m_trimScheduled && QCoreApplication::instance() != NULL ) {
+		m_trimScheduled = true;
+		QCoreApplication::postEvent(this, new QEvent(QEvent::User));
+	}
+}
+
+void TextureCache::customEvent(QEvent * event)
+{
+	if( event->type() == QEvent::User && m_trimScheduled ) {
+		trim();
+	}
+}
+
+void TextureCache::releaseUnused()
+{
+	foreach (GLTexture::Private * p, GLTexture::Private::s_textureMap.values()) {
+		if( p->isUnused() ) {
+			GLTexture::Private::release(p);
+		}
+	}
+	
+	emit changed();
+}
@@ -21,13 +21,21 @@
 #ifndef TEXMANAGER_H
 #define TEXMANAGER_H
 
+#include "imageplugin.h"
+
 #include <GL/glew.h>
 
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
 #include <QtCore/QString>
 #include <QtCore/QSharedDataPointer>
 #include <QtCore/QMetaType>
+#include <QtCore/QThreadPool>
 #include <QtGui/QPixmap>
 
+class QGLContext;
+
 
 // Implicitly shared texture class.
 class GLTexture
@@ -44,7 +52,10 @@ public:
 	GLuint object() const;
 	GLuint target() const;
 	QImage icon() const;
-	QImage image() const;
+	QImage image() const;	// Downsampled preview, read back from the texture when needed.
+	
+	// The default texture is shown while the image is decoded in the background.
+	bool isLoading() const;
 
 	
 	GLint wrapS() const;
@@ -59,6 +70,8 @@ public:
 	
 private:
 	class Private;
+	friend class TextureLoader;
+	friend class TextureCache;
 	GLTexture(Private * p);
 	QSharedDataPointer<Private> m_data;
 };
@@ -66,4 +79,108 @@ private:
 Q_DECLARE_METATYPE(GLTexture)
 
 
+// Decodes the texture images on a pool of threads, and uploads them in the
+// GUI thread when they are ready.
+class TextureLoader : public QObject
+{
+	Q_OBJECT
+public:
+	static TextureLoader * instance();
+	
+	// Decode the image of the texture in the background.
+	void load(const QString & name);
+	void cancel(const QString & name);
+	
+	int pendingCount() const;
+	
+	// Keep the decoded images until resumed, so that the textures do not change meanwhile.
+	void setSuspended(bool suspended);
+	bool isSuspended() const;
+	
+signals:
+	void loaded(const QString & name);
+	
+protected:
+	virtual void customEvent(QEvent * event);
+	
+private:
+	TextureLoader();
+	
+	void finishLoad(const QString & name, int serial, const ImageData & data);
+	
+	struct Request
+	{
+		int serial;
+		const QGLContext * context;
+	};
+	QHash<QString, Request> m_requests;
+	int m_serial;
+	QThreadPool m_pool;
+	
+	struct Decoded
+	{
+		QString name;
+		int serial;
+		ImageData data;
+	};
+	bool m_suspended;
+	QList<Decoded> m_deferred;
+};
+
+
+// Keeps the textures that no effect uses anymore, so that switching between effects does not
+// load them again. The least recently used ones are released when the cache exceeds its budgets.
+class TextureCache : public QObject
+{
+	Q_OBJECT
+public:
+	static TextureCache * instance();
+	
+	struct Entry
+	{
+		QString name;
+		int references;		// Not counting the cache.
+		bool loading;
+		qint64 hostMemory;
+		qint64 videoMemory;
+	};
+	
+	// Most recently used first.
+	QList<Entry> entries() const;
+	
+	qint64 hostMemory() const;
+	qint64 videoMemory() const;
+	
+	qint64 hostBudget() const;
+	void setHostBudget(qint64 size);
+	
+	qint64 videoBudget() const;
+	void setVideoBudget(qint64 size);
+	
+public slots:
+	// Drop previews and release unused textures until the cache fits its budgets.
+	void trim();
+	
+	// Release all the unused textures.
+	void releaseUnused();
+	
+signals:
+	void changed();
+	
+protected:
+	virtual void customEvent(QEvent * event);
+	
+private:
+	TextureCache();
+	
+	// Trim once control returns to the event loop.
+	void scheduleTrim();
+	friend class GLTexture;
+	
+	qint64 m_hostBudget;
+	qint64 m_videoBudget;
+	bool m_trimScheduled;
+};
+
+
 #endif // TEXMANAGER_H
@@ -0,0 +1,118 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "texturepanel.h"
+#include "texmanager.h"
+
+#include <QtCore/QFileInfo>
+#include <QtCore/QTimer>
+#include <QtGui/QHBoxLayout>
+#include <QtGui/QHeaderView>
+#include <QtGui/QLabel>
+#include <QtGui/QPushButton>
+#include <QtGui/QTreeWidget>
+#include <QtGui/QVBoxLayout>
+
+namespace
+{
+	static QString formatSize(qint64 bytes)
+	{
+		if (bytes < 1024 * 1024) {
+			return QString("%1 KB").arg((bytes + 1023) / 1024);
+		}
+		return QString("%1 MB").arg(double(bytes) / (1024 * 1024), 0, 'f', 1);
+	}
+
+} // namespace
+
+
+TexturePanel::TexturePanel(const QString & title, QWidget * parent /*= 0*/, Qt::WFlags flags /*= 0*/) :
+	QDockWidget(title, parent, flags)
+{
+	QWidget * widget = new QWidget(this);
+
+	m_tree = new QTreeWidget(widget);
+	m_tree->setRootIsDecorated(false);
+	m_tree->setAlternatingRowColors(true);
+	m_tree->setHeaderLabels(QStringList() << tr("Texture") << tr("Users") << tr("Host memory") << tr("Video memory"));
+	m_tree->header()->setResizeMode(QHeaderView::ResizeToContents);
+
+	m_summary = new QLabel(widget);
+
+	QPushButton * releaseButton = new QPushButton(tr("Release Unused"), widget);
+	releaseButton->setToolTip(tr("Release the textures that no effect uses"));
+	connect(releaseButton, SIGNAL(clicked()), TextureCache::instance(), SLOT(releaseUnused()));
+
+	QHBoxLayout * bottomLayout = new QHBoxLayout;
+	bottomLayout->addWidget(m_summary, 1);
+	bottomLayout->addWidget(releaseButton);
+
+	QVBoxLayout * layout = new QVBoxLayout(widget);
+	layout->setMargin(0);
+	layout->addWidget(m_tree);
+	layout->addLayout(bottomLayout);
+	setWidget(widget);
+
+	connect(TextureCache::instance(), SIGNAL(changed()), this, SLOT(refresh()));
+
+	// Effects drop their textures without notifying the cache.
+	m_timer = new QTimer(this);
+	connect(m_timer, SIGNAL(timeout()), this, SLOT(refresh()));
+	m_timer->start(1000);
+}
+
+TexturePanel::~TexturePanel()
+{
+}
+
+QSize TexturePanel::sizeHint() const
+{
+	return QSize(200, 100);
+}
+
+void TexturePanel::refresh()
+{
+	if (!isVisible()) {
+		return;
+	}
+
+	m_tree->clear();
+
+	const TextureCache * cache = TextureCache::instance();
+	foreach (const TextureCache::Entry & entry, cache->entries())
+	{
+		QTreeWidgetItem * item = new QTreeWidgetItem(m_tree);
+		item->setText(0, QFileInfo(entry.name).fileName());
+		item->setToolTip(0, entry.name);
+		item->setText(1, entry.loading ? tr("loading") : QString::number(entry.references));
+		item->setText(2, formatSize(entry.hostMemory));
+		item->setText(3, formatSize(entry.videoMemory));
+
+		// Unused textures are the first to be released.
+		if (entry.references == 0) {
+			for (int i = 0; i < 4; i++) {
+				item->setForeground(i, m_tree->palette().brush(QPalette::Disabled, QPalette::Text));
+			}
+		}
+	}
+
+	m_summary->setText(tr("Host: %1 of %2, video: %3 of %4")
+		.arg(formatSize(cache->hostMemory())).arg(formatSize(cache->hostBudget()))
+		.arg(formatSize(cache->videoMemory())).arg(formatSize(cache->videoBudget())));
+}
@@ -0,0 +1,54 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef TEXTUREPANEL_H
+#define TEXTUREPANEL_H
+
+#include <QtGui/QDockWidget>
+
+class QLabel;
+class QTimer;
+class QTreeWidget;
+
+
+// Lists the textures of the cache with the memory that they use.
+class TexturePanel : public QDockWidget
+{
+	Q_OBJECT
+public:
+
+	TexturePanel(const QString & title, QWidget * parent = 0, Qt::WFlags flags = 0);
+	~TexturePanel();
+
+	virtual QSize sizeHint() const;
+
+public slots:
+
+	void refresh();
+
+private:
+
+	QTreeWidget * m_tree;
+	QLabel * m_summary;
+	QTimer * m_timer;
+
+};
+
+
+#endif // TEXTUREPANEL_H
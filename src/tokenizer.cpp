@@ -0,0 +1,180 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "tokenizer.h"
+
+#include <QtCore/QCryptographicHash>
+
+#include <ctype.h>
+#include <string.h>
+
+namespace
+{
+	static bool isIdentifierChar(char c)
+	{
+		return isalnum((unsigned char)c) || c == '_';
+	}
+
+	static bool isOperatorChar(char c)
+	{
+		return c != 0 && strchr("+-*/%=<>!&|^~?:", c) != NULL;
+	}
+
+} // namespace
+
+
+QList<Token> tokenize(const QByteArray & source)
+{
+	QList<Token> tokens;
+
+	const char * s = source.constData();
+	const int size = source.size();
+
+	// ARB programs start with a "!!" header and use '#' for comments.
+	const bool hashComments = source.startsWith("!!");
+
+	bool lineStart = true;
+	bool directive = false;
+	int line = 1;
+
+	int i = 0;
+	while (i < size) {
+		const char c = s[i];
+		const char next = (i + 1 < size) ? s[i + 1] : 0;
+
+		if (c == '\n') {
+			// Newlines terminate preprocessor directives.
+			if (directive) {
+				Token token;
+				token.text = "\n";
+				token.line = line;
+				token.offset = i;
+				token.directive = true;
+				tokens.append(token);
+				directive = false;
+			}
+			lineStart = true;
+			line++;
+			i++;
+			continue;
+		}
+
+		// Line continuation.
+		if (c == '\\' && (next == '\n' || (next == '\r' && i + 2 < size && s[i + 2] == '\n'))) {
+			i += (next == '\n') ? 2 : 3;
+			line++;
+			continue;
+		}
+
+		if (isspace((unsigned char)c)) {
+			i++;
+			continue;
+		}
+
+		// Comments.
+		if ((c == '/' && next == '/') || (c == '#' && hashComments)) {
+			while (i < size && s[i] != '\n') {
+				i++;
+			}
+			continue;
+		}
+		if (c == '/' && next == '*') {
+			i += 2;
+			while (i < size && !(s[i] == '*' && i + 1 < size && s[i + 1] == '/')) {
+				if (s[i] == '\n') {
+					line++;
+				}
+				i++;
+			}
+			i += 2;
+			continue;
+		}
+
+		if (c == '#' && lineStart) {
+			directive = true;
+		}
+		lineStart = false;
+
+		const int start = i;
+		if (isIdentifierChar(c) || (c == '.' && isdigit((unsigned char)next))) {
+			// Identifiers and numbers, including exponents.
+			const bool number = !isalpha((unsigned char)c) && c != '_';
+			i++;
+			while (i < size) {
+				if (isIdentifierChar(s[i]) || (number && s[i] == '.')) {
+					i++;
+				}
+				else if (number && (s[i] == '+' || s[i] == '-') && (s[i - 1] == 'e' || s[i - 1] == 'E')) {
+					i++;
+				}
+				else {
+					break;
+				}
+			}
+		}
+		else if (c == '"') {
+			// String literals, used by annotations and #include.
+			i++;
+			while (i < size && s[i] != '"' && s[i] != '\n') {
+				i += (s[i] == '\\' && i + 1 < size) ? 2 : 1;
+			}
+			if (i < size && s[i] == '"') {
+				i++;
+			}
+		}
+		else if (isOperatorChar(c)) {
+			// Keep runs of operators together, so that "+ +" and "++" differ.
+			i++;
+			while (i < size && isOperatorChar(s[i]) && !(s[i] == '/' && i + 1 < size && (s[i + 1] == '/' || s[i + 1] == '*'))) {
+				i++;
+			}
+		}
+		else {
+			i++;
+		}
+
+		Token token;
+		token.text = QByteArray(s + start, i - start);
+		token.line = line;
+		token.offset = start;
+		token.directive = directive;
+		tokens.append(token);
+	}
+
+	return tokens;
+}
+
+QByteArray tokenHash(const QByteArray & source)
+{
+	QCryptographicHash hash(QCryptographicHash::Md5);
+
+	foreach (const Token & token, tokenize(source)) {
+		hash.addData(token.text);
+		if (token.text != "\n") {
+			hash.addData(" ", 1);
+		}
+
+		// The value of __LINE__ depends on the layout.
+		if (token.text == "__LINE__") {
+			hash.addData(QByteArray::number(token.line));
+		}
+	}
+
+	return hash.result();
+}
@@ -0,0 +1,45 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+
+
+struct Token
+{
+	QByteArray text;
+	int line;
+	int offset;		// In the source.
+	
+	// Part of a preprocessor directive. Directives end with a "\n" token.
+	bool directive;
+};
+
+/// Tokens of a GLSL, Cg or ARB program source, without whitespace and comments.
+QList<Token> tokenize(const QByteArray & source);
+
+/// Hash of the token stream of a GLSL, Cg or ARB program source. Whitespace
+/// and comments are ignored, so the hash only changes when the code does.
+QByteArray tokenHash(const QByteArray & source);
+
+
+#endif // TOKENIZER_H
@@ -0,0 +1,225 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "transform.h"
+
+#include <GL/glew.h>
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+namespace
+{
+	static Matrix4 s_modelView;
+	static Matrix4 s_projection;
+	
+	static float toRadians(float degrees)
+	{
+		return degrees * float(M_PI / 180.0);
+	}
+	
+	static void normalize(float & x, float & y, float & z)
+	{
+		float length = sqrtf(x * x + y * y + z * z);
+		if( length > 0.0f ) {
+			x /= length;
+			y /= length;
+			z /= length;
+		}
+	}
+	
+} // namespace
+
+
+Matrix4::Matrix4()
+{
+	for(int i = 0; i < 16; i++) {
+		m_data[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+	}
+}
+
+Matrix4 Matrix4::operator*(const Matrix4 & m) const
+{
+	Matrix4 result;
+	for(int row = 0; row < 4; row++) {
+		for(int col = 0; col < 4; col++) {
+			float sum = 0.0f;
+			for(int i = 0; i < 4; i++) {
+				sum += (*this)(row, i) * m(i, col);
+			}
+			result(row, col) = sum;
+		}
+	}
+	return result;
+}
+
+void Matrix4::translate(float x, float y, float z)
+{
+	Matrix4 m;
+	m(0, 3) = x;
+	m(1, 3) = y;
+	m(2, 3) = z;
+	*this = *this * m;
+}
+
+void Matrix4::scale(float x, float y, float z)
+{
+	Matrix4 m;
+	m(0, 0) = x;
+	m(1, 1) = y;
+	m(2, 2) = z;
+	*this = *this * m;
+}
+
+void Matrix4::rotate(float degrees, float x, float y, float z)
+{
+	normalize(x, y, z);
+	
+	const float c = cosf(toRadians(degrees));
+	const float s = sinf(toRadians(degrees));
+	const float t = 1.0f - c;
+	
+	Matrix4 m;
+	m(0, 0) = x * x * t + c;
+	m(0, 1) = x * y * t - z * s;
+	m(0, 2) = x * z * t + y * s;
+	m(1, 0) = y * x * t + z * s;
+	m(1, 1) = y * y * t + c;
+	m(1, 2) = y * z * t - x * s;
+	m(2, 0) = x * z * t - y * s;
+	m(2, 1) = y * z * t + x * s;
+	m(2, 2) = z * z * t + c;
+	*this = *this * m;
+}
+
+void Matrix4::normalMatrix(float * n) const
+{
+	const Matrix4 & a = *this;
+	
+	// Cofactors of the upper 3x3 block.
+	float cof[3][3];
+	cof[0][0] = a(1, 1) * a(2, 2) - a(1, 2) * a(2, 1);
+	cof[0][1] = a(1, 2) * a(2, 0) - a(1, 0) * a(2, 2);
+	cof[0][2] = a(1, 0) * a(2, 1) - a(1, 1) * a(2, 0);
+	cof[1][0] = a(0, 2) * a(2, 1) - a(0, 1) * a(2, 2);
+	cof[1][1] = a(0, 0) * a(2, 2) - a(0, 2) * a(2, 0);
+	cof[1][2] = a(0, 1) * a(2, 0) - a(0, 0) * a(2, 1);
+	cof[2][0] = a(0, 1) * a(1, 2) - a(0, 2) * a(1, 1);
+	cof[2][1] = a(0, 2) * a(1, 0) - a(0, 0) * a(1, 2);
+	cof[2][2] = a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0);
+	
+	float det = a(0, 0) * cof[0][0] + a(0, 1) * cof[0][1] + a(0, 2) * cof[0][2];
+	if( det == 0.0f ) {
+		det = 1.0f;
+	}
+	
+	// The inverse transpose is the cofactor matrix over the determinant.
+	for(int row = 0; row < 3; row++) {
+		for(int col = 0; col < 3; col++) {
+			n[col * 3 + row] = cof[row][col] / det;
+		}
+	}
+}
+
+//static
+Matrix4 Matrix4::perspective(float fov, float aspect, float zNear, float zFar)
+{
+	float halfHeight = tanf(toRadians(fov / 2));
+	if( aspect < 1 ) {
+		halfHeight /= aspect;
+	}
+	
+	Matrix4 m;
+	m(0, 0) = 1.0f / (halfHeight * aspect);
+	m(1, 1) = 1.0f / halfHeight;
+	m(2, 2) = (zFar + zNear) / (zNear - zFar);
+	m(2, 3) = 2.0f * zFar * zNear / (zNear - zFar);
+	m(3, 2) = -1.0f;
+	m(3, 3) = 0.0f;
+	return m;
+}
+
+//static
+Matrix4 Matrix4::ortho(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+	Matrix4 m;
+	m(0, 0) = 2.0f / (right - left);
+	m(1, 1) = 2.0f / (top - bottom);
+	m(2, 2) = -2.0f / (zFar - zNear);
+	m(0, 3) = -(right + left) / (right - left);
+	m(1, 3) = -(top + bottom) / (top - bottom);
+	m(2, 3) = -(zFar + zNear) / (zFar - zNear);
+	return m;
+}
+
+//static
+Matrix4 Matrix4::lookAt(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ, float upX, float upY, float upZ)
+{
+	// Forward direction.
+	float fx = centerX - eyeX;
+	float fy = centerY - eyeY;
+	float fz = centerZ - eyeZ;
+	normalize(fx, fy, fz);
+	
+	// Side = forward x up.
+	float sx = fy * upZ - fz * upY;
+	float sy = fz * upX - fx * upZ;
+	float sz = fx * upY - fy * upX;
+	normalize(sx, sy, sz);
+	
+	// Recomputed up = side x forward.
+	const float ux = sy * fz - sz * fy;
+	const float uy = sz * fx - sx * fz;
+	const float uz = sx * fy - sy * fx;
+	
+	Matrix4 m;
+	m(0, 0) = sx;  m(0, 1) = sy;  m(0, 2) = sz;
+	m(1, 0) = ux;  m(1, 1) = uy;  m(1, 2) = uz;
+	m(2, 0) = -fx; m(2, 1) = -fy; m(2, 2) = -fz;
+	m.translate(-eyeX, -eyeY, -eyeZ);
+	return m;
+}
+
+
+void Transform::load(const Matrix4 & modelView, const Matrix4 & projection)
+{
+	s_modelView = modelView;
+	s_projection = projection;
+	
+	// Effects that use the fixed function matrices still need them.
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(projection.data());
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixf(modelView.data());
+}
+
+const Matrix4 & Transform::modelView()
+{
+	return s_modelView;
+}
+
+const Matrix4 & Transform::projection()
+{
+	return s_projection;
+}
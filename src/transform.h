@@ -0,0 +1,69 @@
+/*
+    QShaderEdit - Simple multiplatform shader editor
+    Copyright (C) 2007 Ignacio Castao <castano@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+
+// 4x4 matrix stored in column major order, like the OpenGL matrix stacks.
+class Matrix4
+{
+public:
+	// Identity matrix.
+	Matrix4();
+	
+	const float * data() const { return m_data; }
+	
+	float operator()(int row, int col) const { return m_data[col * 4 + row]; }
+	float & operator()(int row, int col) { return m_data[col * 4 + row]; }
+	
+	Matrix4 operator*(const Matrix4 & m) const;
+	
+	// Same as the glTranslate, glScale and glRotate calls.
+	void translate(float x, float y, float z);
+	void scale(float x, float y, float z);
+	void rotate(float degrees, float x, float y, float z);
+	
+	// Inverse transpose of the upper 3x3 block, in column major order.
+	void normalMatrix(float * n) const;
+	
+	// fov applies to the smaller dimension.
+	static Matrix4 perspective(float fov, float aspect, float zNear, float zFar);
+	static Matrix4 ortho(float left, float right, float bottom, float top, float zNear, float zFar);
+	static Matrix4 lookAt(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ, float upX, float upY, float upZ);
+	
+private:
+	float m_data[16];
+};
+
+
+// Matrices of the scene being rendered. Effects read them to feed
+// shaders that do not use the fixed function state.
+namespace Transform
+{
+	// Set the current matrices and load them in the fixed function stacks.
+	void load(const Matrix4 & modelView, const Matrix4 & projection);
+	
+	const Matrix4 & modelView();
+	const Matrix4 & projection();
+};
+
+
+#endif // TRANSFORM_H